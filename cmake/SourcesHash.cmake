@@ -0,0 +1,25 @@
+#
+# Writes OUTPUT, a header defining CHASM_BUILD_ID as the SHA-256 of the files listed in SOURCES_LIST.
+# Run as a build step so that any change to those files changes it, the header is only rewritten
+# when the hash changes so that its dependents are not rebuilt for nothing.
+#
+file(READ ${SOURCES_LIST} SOURCES)
+
+set(CONTENTS "")
+
+foreach (SOURCE ${SOURCES})
+    file(SHA256 ${SOURCE} SOURCE_HASH)
+    string(APPEND CONTENTS "${SOURCE_HASH}\n")
+endforeach ()
+
+string(SHA256 BUILD_ID "${CONTENTS}")
+
+set(HEADER "// generated by cmake/SourcesHash.cmake\n#define CHASM_BUILD_ID \"${BUILD_ID}\"\n")
+
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif ()
+
+if (NOT "${PREVIOUS}" STREQUAL "${HEADER}")
+    file(WRITE ${OUTPUT} "${HEADER}")
+endif ()
@@ -120,6 +120,25 @@ namespace chasm::arch
 		return std::ranges::binary_search(mnemonics, instruction);
 	}
 
+	//
+	// General purpose registers r0-rf are numbered 0x0-0xF,
+	// the special purpose registers follow them
+	//
+	enum register_id : uint8_t
+	{
+		REG_AR = 0x10,
+		REG_DT,
+		REG_ST,
+
+		register_count
+	};
+
+	constexpr std::array<std::string_view, register_id::register_count> register_names = {
+			"r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+			"r8", "r9", "ra", "rb", "rc", "rd", "re", "rf",
+			"ar", "dt", "st"
+	};
+
 	constexpr bool is_aligned(addr p)
 	{
 		return (p & 1) == 0;
@@ -134,7 +153,7 @@ namespace chasm::arch
 		fmt_imm16 = 16
 	};
 
-	enum class operand_type
+	enum class operand_type : uint8_t
 	{
 		//
 		// special registers
@@ -0,0 +1,44 @@
+#ifndef CHASM_ASSEMBLER_HPP
+#define CHASM_ASSEMBLER_HPP
+
+
+#include <string_view>
+#include <filesystem>
+#include <cstdint>
+#include <vector>
+
+#include <chasm/assembler_options.hpp>
+#include <chasm/diagnostics.hpp>
+
+
+namespace chasm
+{
+	//
+	// Entry points of libchasm. A whole source held in memory is assembled with explicit options,
+	// only the include cache of the options is kept from one call to the next. Any number of calls
+	// may run at once, the cache is safe to share between them.
+	//
+	// Files included by source are resolved relative to source_file, or to the working directory
+	// without it, and are added to dependencies. A source without any statement assembles to nothing.
+	//
+	[[nodiscard]] std::vector<uint8_t> assemble(std::string_view source,
+												const assembler_options& options = {},
+												const std::filesystem::path& source_file = {},
+												std::vector<std::filesystem::path>* dependencies = nullptr);
+
+	// reports every error and warning to sink instead of throwing the first error
+	[[nodiscard]] diagnosed<std::vector<uint8_t>> assemble(std::string_view source,
+														   diagnostics& sink,
+														   const assembler_options& options = {},
+														   const std::filesystem::path& source_file = {},
+														   std::vector<std::filesystem::path>* dependencies = nullptr);
+
+	// content of a precompiled module (.c8m) of the procedures, sprites and constants of source
+	[[nodiscard]] std::vector<uint8_t> compile_module(std::string_view source,
+													  const assembler_options& options = {},
+													  const std::filesystem::path& source_file = {},
+													  std::vector<std::filesystem::path>* dependencies = nullptr);
+}
+
+
+#endif //CHASM_ASSEMBLER_HPP
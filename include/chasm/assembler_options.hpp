@@ -0,0 +1,47 @@
+#ifndef CHASM_ASSEMBLER_OPTIONS_HPP
+#define CHASM_ASSEMBLER_OPTIONS_HPP
+
+
+#include <string>
+
+#include <chasm/arch.hpp>
+
+
+namespace chasm
+{
+	class include_cache;
+
+	//
+	// Everything an assembly depends on besides its source. Each assembly gets its own copy,
+	// so assemblies running on several threads of a process do not share any setting.
+	//
+	struct assembler_options
+	{
+		// address the binary is loaded at, every address is relocated to it
+		arch::addr relocate = 0x200;
+
+		// targets the SuperCHIP-8, its instructions are not warned about
+		bool super = false;
+
+		// odd sized sprites get a padding byte, so the sprites after them stay aligned
+		bool pad_sprites = false;
+
+		// threads used to lex large sources, 0 uses every core
+		unsigned int jobs = 1;
+
+		// runs the lexer, the parser and the code generation concurrently
+		bool pipeline = false;
+
+		// file the symbols mapping is written to once linked, none if empty
+		std::string symbols_file;
+
+		//
+		// Included files are parsed through it, so assemblies sharing it parse each of them once.
+		// Without it each assembly parses the files it includes again.
+		//
+		include_cache* includes = nullptr;
+	};
+}
+
+
+#endif //CHASM_ASSEMBLER_OPTIONS_HPP
@@ -4,7 +4,8 @@
 
 #include <vector>
 
-#include <chasm/ast_visitor.hpp>
+#include <chasm/assembler_options.hpp>
+#include <chasm/diagnostics.hpp>
 #include <chasm/statements.hpp>
 
 
@@ -13,16 +14,32 @@ namespace chasm::ast
     class abstract_tree
     {
 	public:
-        explicit abstract_tree(std::vector<ast::statement>&& branches);
+		//
+		// The tokens of the tree are views into source, which must outlive the tree
+		//
+        abstract_tree(flat_nodes&& nodes, interner&& symbols, const stream& source);
 
-		[[nodiscard]] std::vector<uint8_t> generate();
-		[[nodiscard]] const std::vector<ast::statement>& branches() const;
+		[[nodiscard]] std::vector<uint8_t> generate(const assembler_options& options = {}) const;
 
-	private:
-		void sanitize() const;
+		// reports every error and warning to sink instead of throwing the first error
+		[[nodiscard]] diagnosed<std::vector<uint8_t>> generate(diagnostics& sink, const assembler_options& options = {}) const;
+
+		// content of a precompiled module of the procedures, sprites and constants of the tree
+		[[nodiscard]] std::vector<uint8_t> compile_module(const assembler_options& options = {}) const;
+
+		[[nodiscard]] const flat_nodes& nodes() const;
+
+		// top level statements, in source order
+		[[nodiscard]] std::vector<node_id> branches() const;
+
+		[[nodiscard]] const interner& symbols() const;
+		[[nodiscard]] const stream& source() const;
+		[[nodiscard]] source_location locate(const token& token) const;
 
 	private:
-		std::vector<ast::statement> statements {};
+		flat_nodes statements;
+		interner symbol_names;
+		const stream* source_stream;
     };
 }
 
@@ -0,0 +1,94 @@
+#ifndef CHASM_BATCH_HPP
+#define CHASM_BATCH_HPP
+
+
+#include <string_view>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <span>
+
+#include <chasm/assembler_options.hpp>
+#include <chasm/chasm_exception.hpp>
+#include <chasm/diagnostics.hpp>
+
+
+namespace chasm
+{
+	class build_cache;
+
+	struct batch_entry
+	{
+		std::filesystem::path source;
+		std::filesystem::path output;
+	};
+
+	struct batch_options
+	{
+		//
+		// Every file is assembled with the same options, the symbols file is not written in a batch.
+		// Without an include cache in them, one is shared by the files of the batch.
+		//
+		assembler_options assembler;
+
+		// files assembled at once, 0 uses every core
+		unsigned int workers = 0;
+
+		// compiles precompiled modules (.c8m) instead of programs
+		bool modules = false;
+
+		// writes a depfile next to each output
+		bool depfiles = false;
+
+		// programs are restored from it when they were built before, and stored to it otherwise
+		build_cache* cache = nullptr;
+	};
+
+	struct batch_result
+	{
+		std::filesystem::path source;
+		std::filesystem::path output;
+
+		// the output was written
+		bool success = false;
+
+		// errors and warnings of the file, the reason of a failure is always one of them
+		diagnostics report;
+
+		// what was logged while the file was assembled
+		std::vector<std::string> log;
+	};
+
+	//
+	// Output of a source assembled without an explicit one: the source with the given extension
+	//
+	[[nodiscard]] std::filesystem::path default_output(const std::filesystem::path& source, std::string_view extension);
+
+	//
+	// One file per line, its path then optionally the path of its output, paths with spaces quoted.
+	// Relative paths are relative to the manifest, empty lines and lines starting with # are skipped.
+	//
+	[[nodiscard]] std::vector<batch_entry> read_manifest(const std::filesystem::path& manifest,
+														 std::string_view output_extension);
+
+	//
+	// Assembles every entry on a work stealing pool. Each file has its own generator state and its
+	// log is kept in its result, a file failing does not stop the others. Results are in entries order.
+	//
+	[[nodiscard]] std::vector<batch_result> assemble_batch(std::span<const batch_entry> entries,
+														   const batch_options& options);
+
+
+	namespace batch_exception
+	{
+		struct invalid_manifest : chasm_exception
+		{
+			invalid_manifest(const std::filesystem::path& manifest, size_t line, std::string_view reason)
+				: chasm_exception("Invalid batch manifest \"{}\" at line {}: {}.", manifest.string(), line, reason)
+			{}
+		};
+	}
+}
+
+
+#endif //CHASM_BATCH_HPP
@@ -0,0 +1,129 @@
+#ifndef CHASM_BUILD_CACHE_HPP
+#define CHASM_BUILD_CACHE_HPP
+
+
+#include <string_view>
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <span>
+
+#include <chasm/assembler_options.hpp>
+#include <chasm/sha256.hpp>
+
+
+namespace chasm
+{
+	struct cache_statistics
+	{
+		uint64_t hits {};
+		uint64_t misses {};
+		uint64_t evictions {};
+
+		// objects held and their size in bytes
+		uint64_t entries {};
+		uint64_t size {};
+	};
+
+	//
+	// Outputs of previous builds, found again without lexing or generating anything.
+	//
+	// The key of a build is the SHA-256 of the assembler identity (version, generator encoding revision
+	// and the hash of the library sources generated by the build), its kind, the options changing the output, the
+	// directory of the source (includes are resolved from it) and the source bytes. Config values are
+	// set by the source itself, so they are part of it. Included files are only known once a source
+	// was parsed: the key leads to a manifest listing them with the hash of their content, a build is
+	// only found if each of them still has the same content.
+	//
+	//   directory/manifests/<key>       object key, then "<hash> <path>" for each included file
+	//   directory/objects/<object>.c8c  binary
+	//   directory/objects/<object>.c8s  symbols mapping, if it was written
+	//   directory/objects/<object>.log  what was logged by the build
+	//   directory/stats                 hits, misses and evictions of every run
+	//
+	// Files are written to a temporary name then renamed, several processes may share a directory.
+	// Once objects exceed max_size bytes, the least recently used ones are removed.
+	//
+	class build_cache
+	{
+	public:
+		struct key
+		{
+			sha256::digest digest;
+		};
+
+		// what a build writes and logs, a source built as another kind is another build
+		enum class build_kind : uint8_t
+		{
+			program,
+			module,
+			diagnostics,
+			diagnostics_json
+		};
+
+		struct cached_build
+		{
+			std::vector<std::filesystem::path> dependencies;
+			std::vector<std::string> log;
+		};
+
+		build_cache(std::filesystem::path cache_directory, uint64_t max_size);
+
+		// adds the hits and misses of this process to the statistics of the directory
+		~build_cache();
+
+		build_cache(const build_cache&) = delete;
+		build_cache(build_cache&&) = delete;
+		build_cache& operator=(const build_cache&) = delete;
+		build_cache& operator=(build_cache&&) = delete;
+
+		[[nodiscard]] static key make_key(std::string_view source,
+										  const std::filesystem::path& source_file,
+										  const assembler_options& options,
+										  build_kind kind = build_kind::program);
+
+		//
+		// Copies the outputs of a build with this key whose included files did not change to output,
+		// and to symbols_file if it is not empty. Outputs are replaced atomically, a restore failing is a miss.
+		//
+		[[nodiscard]] std::optional<cached_build> fetch(const key& build,
+														const std::filesystem::path& output,
+														const std::filesystem::path& symbols_file);
+
+		// keeps the files written by a successful build
+		void store(const key& build,
+				   std::span<const std::filesystem::path> dependencies,
+				   const std::filesystem::path& output,
+				   const std::filesystem::path& symbols_file,
+				   std::span<const std::string> log);
+
+		// totals of every run sharing the directory, this one included
+		[[nodiscard]] cache_statistics statistics() const;
+
+	private:
+		[[nodiscard]] std::filesystem::path manifest_path(const key& build) const;
+		[[nodiscard]] std::filesystem::path object_path(const std::string& object, std::string_view extension) const;
+
+		void evict();
+
+	private:
+		std::filesystem::path directory;
+		uint64_t size_limit;
+
+		// bytes of objects, scanned once then counted as they are stored
+		std::atomic<uint64_t> objects_size;
+
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> evictions;
+
+		std::mutex eviction_guard;
+	};
+}
+
+
+#endif //CHASM_BUILD_CACHE_HPP
@@ -0,0 +1,155 @@
+#ifndef CHASM_CHASM_H
+#define CHASM_CHASM_H
+
+/*
+ * C interface of chasm, built as the chasm_c shared library.
+ *
+ * Sources are assembled and ROMs disassembled in the calling process, into buffers provided by the
+ * caller. Nothing is allocated for the caller and no state is kept between calls: each call parses
+ * the files it includes again, so any number of calls may run at once on different threads.
+ *
+ * Structures only have fixed size fields, new fields are only ever appended and CHASM_API_VERSION is
+ * incremented when they are. The library is told the size of every structure the caller was compiled
+ * with: chasm_options starts with struct_size, arrays of structures are given with the size of their
+ * elements. Only the fields both sides know of are read or written, fields the library does not know
+ * of are zeroed. Sizes smaller than the ones of version 2 are rejected.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+	#if defined(CHASM_C_EXPORTS)
+		#define CHASM_API __declspec(dllexport)
+	#else
+		#define CHASM_API __declspec(dllimport)
+	#endif
+#else
+	#define CHASM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHASM_API_VERSION 2
+
+#define CHASM_MESSAGE_SIZE 256
+#define CHASM_INSTRUCTION_TEXT_SIZE 32
+
+
+typedef enum chasm_status
+{
+	CHASM_OK = 0,
+
+	/* errors were reported in the diagnostics */
+	CHASM_ERROR = 1,
+
+	/* the output does not fit, the size it needs is written anyway */
+	CHASM_BUFFER_TOO_SMALL = 2,
+
+	CHASM_INVALID_ARGUMENT = 3
+} chasm_status;
+
+typedef enum chasm_severity
+{
+	CHASM_SEVERITY_WARNING = 0,
+	CHASM_SEVERITY_ERROR = 1
+} chasm_severity;
+
+typedef struct chasm_diagnostic
+{
+	chasm_severity severity;
+
+	/* 0 for diagnostics without a location */
+	uint32_t line;
+	uint32_t column;
+
+	/* truncated to fit, always null terminated */
+	char message[CHASM_MESSAGE_SIZE];
+} chasm_diagnostic;
+
+typedef struct chasm_options
+{
+	/* sizeof(chasm_options), set by the caller */
+	uint32_t struct_size;
+
+	/* address the binary is loaded at, 0x200 by default */
+	uint16_t relocate;
+
+	/* non zero to target the SuperCHIP-8, its instructions are not warned about */
+	uint8_t super;
+
+	/* non zero to pad odd sized sprites */
+	uint8_t pad_sprites;
+
+	/* included files are resolved relative to this file, or to the working directory if NULL */
+	const char* source_file;
+} chasm_options;
+
+typedef struct chasm_instruction
+{
+	/* address in memory, relative to the load address given to chasm_disassemble */
+	uint16_t address;
+	uint16_t opcode;
+
+	/* non zero if a code path starts at this instruction, e.g. the target of a jump */
+	uint8_t path_start;
+
+	/* non zero if a procedure starts at this instruction, i.e. the target of a call */
+	uint8_t procedure_start;
+
+	/* chasm syntax of the instruction, always null terminated */
+	char text[CHASM_INSTRUCTION_TEXT_SIZE];
+} chasm_instruction;
+
+
+CHASM_API uint32_t chasm_api_version(void);
+
+CHASM_API const char* chasm_status_string(chasm_status status);
+
+/* fills the fields of options known to the caller, its struct_size must be set */
+CHASM_API chasm_status chasm_default_options(chasm_options* options);
+
+/*
+ * Assembles the source_size bytes of source into binary. options may be NULL for the default options.
+ *
+ * binary_size receives the size of the binary, even if it exceeds binary_capacity.
+ * Up to diagnostics_capacity errors and warnings are written to diagnostics, an array of elements of
+ * diagnostic_size bytes, i.e. sizeof(chasm_diagnostic). diagnostics_count receives how many were reported.
+ * diagnostics and diagnostics_count may be NULL.
+ */
+CHASM_API chasm_status chasm_assemble(const char* source,
+									  size_t source_size,
+									  const chasm_options* options,
+									  uint8_t* binary,
+									  size_t binary_capacity,
+									  size_t* binary_size,
+									  chasm_diagnostic* diagnostics,
+									  size_t diagnostic_size,
+									  size_t diagnostics_capacity,
+									  size_t* diagnostics_count);
+
+/*
+ * Disassembles every code path reachable from the first instruction of rom, loaded at load_address.
+ * Instructions are written sorted by address to an array of elements of instruction_size bytes,
+ * i.e. sizeof(chasm_instruction). instructions_count receives how many there are even if it exceeds
+ * instructions_capacity. error may be NULL, it receives the reason of CHASM_ERROR and is diagnostic_size
+ * bytes long.
+ */
+CHASM_API chasm_status chasm_disassemble(const uint8_t* rom,
+										 size_t rom_size,
+										 uint16_t load_address,
+										 chasm_instruction* instructions,
+										 size_t instruction_size,
+										 size_t instructions_capacity,
+										 size_t* instructions_count,
+										 chasm_diagnostic* error,
+										 size_t diagnostic_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* CHASM_CHASM_H */
@@ -0,0 +1,25 @@
+#ifndef CHASM_DEPFILE_HPP
+#define CHASM_DEPFILE_HPP
+
+
+#include <filesystem>
+#include <string>
+#include <span>
+
+
+namespace chasm
+{
+	//
+	// Make rule with target depending on inputs, the assembled file first then its included files.
+	// Included files also get a rule without prerequisites, so that deleting one of them does not
+	// break the build (as with -MD -MP). Make and Ninja both read this format.
+	//
+	[[nodiscard]] std::string make_depfile(const std::filesystem::path& target,
+										   std::span<const std::filesystem::path> inputs);
+
+	// writes make_depfile(target, inputs) next to target, as target.d
+	void write_depfile(const std::filesystem::path& target, std::span<const std::filesystem::path> inputs);
+}
+
+
+#endif //CHASM_DEPFILE_HPP
@@ -0,0 +1,74 @@
+#ifndef CHASM_DIAGNOSTICS_HPP
+#define CHASM_DIAGNOSTICS_HPP
+
+
+#include <string_view>
+#include <expected>
+#include <optional>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <chasm/source_location.hpp>
+
+
+namespace chasm
+{
+	enum class severity : uint8_t
+	{
+		warning,
+		error
+	};
+
+	struct diagnostic
+	{
+		severity level;
+		std::string message;
+
+		// where the statement (or the token) the diagnostic is about starts
+		std::optional<source_location> location;
+	};
+
+	//
+	// Collects the errors and warnings of a run instead of stopping at the first error.
+	// Stages given a sink report an error and resume at the next token or statement boundary,
+	// the statement with the error is dropped.
+	//
+	class diagnostics
+	{
+	public:
+		void error(std::string message, std::optional<source_location> where = std::nullopt);
+		void warning(std::string message, std::optional<source_location> where = std::nullopt);
+
+		[[nodiscard]] bool has_errors() const;
+		[[nodiscard]] size_t error_count() const;
+		[[nodiscard]] size_t warning_count() const;
+
+		// in the order they were reported
+		[[nodiscard]] const std::vector<diagnostic>& entries() const;
+
+		//
+		// {"file": ..., "errors": n, "warnings": n, "diagnostics": [{"severity", "line", "column", "message"}]}
+		// line and column are null for diagnostics without a location
+		//
+		[[nodiscard]] std::string to_json(std::string_view file) const;
+
+	private:
+		std::vector<diagnostic> reported;
+		size_t errors {};
+	};
+
+	//
+	// Returned instead of a result when errors were reported, the errors themselves are in the sink
+	//
+	struct reported_errors
+	{
+		size_t count;
+	};
+
+	template<typename T>
+	using diagnosed = std::expected<T, reported_errors>;
+}
+
+
+#endif //CHASM_DIAGNOSTICS_HPP
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <memory>
+#include <span>
 
 #include <chasm/ds/disassembly_graph.hpp>
 #include <chasm/ds/control_flow_context.hpp>
@@ -16,7 +17,7 @@ namespace chasm::ds
 	class disassembler
 	{
 	public:
-		disassembler(std::vector<uint8_t> from_bytes, arch::addr from_addr);
+		disassembler(std::span<const uint8_t> from_bytes, arch::addr from_addr);
 		~disassembler() = default;
 
 		disassembler(disassembler&) = delete;
@@ -81,7 +82,12 @@ namespace chasm::ds
 		void ds_draw_r8_r8_imm(arch::reg reg1, arch::reg reg2, arch::imm imm);
 
 	private:
-		std::vector<uint8_t> binary;
+		// only read while disassembling in the constructor, can be a view of a mapped ROM
+		std::span<const uint8_t> binary;
+
+		// address the binary is loaded at
+		arch::addr base;
+
 		control_flow_context flow;
 		disassembly_graph ds_graph;
 	};
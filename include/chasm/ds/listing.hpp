@@ -0,0 +1,37 @@
+#ifndef CHASM_LISTING_HPP
+#define CHASM_LISTING_HPP
+
+
+#include <string>
+#include <vector>
+#include <span>
+
+#include <chasm/arch.hpp>
+
+
+namespace chasm::ds
+{
+	struct listed_instruction
+	{
+		arch::addr address {};
+		arch::opcode opcode {};
+
+		// a code path starts here, e.g. the target of a jump
+		bool path_start {};
+
+		// a procedure starts here, i.e. the target of a call
+		bool procedure_start {};
+
+		// chasm syntax of the instruction
+		std::string text;
+	};
+
+	//
+	// Every instruction reachable from the first one of rom, loaded at base, sorted by address.
+	// Code paths of procedures and of the main code may share instructions, each one is listed once.
+	//
+	[[nodiscard]] std::vector<listed_instruction> make_listing(std::span<const uint8_t> rom, arch::addr base);
+}
+
+
+#endif //CHASM_LISTING_HPP
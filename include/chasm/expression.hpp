@@ -0,0 +1,95 @@
+#ifndef CHASM_EXPRESSION_HPP
+#define CHASM_EXPRESSION_HPP
+
+
+#include <cstdint>
+
+#include <chasm/interner.hpp>
+
+
+namespace chasm
+{
+	//
+	// Operator of an operator_sign token, lexed from + - * / % << >> & | ^ ~
+	//
+	enum class expression_operator : uint8_t
+	{
+		add,
+		subtract,
+		multiply,
+		divide,
+		modulo,
+		shift_left,
+		shift_right,
+		bit_and,
+		bit_or,
+		bit_xor,
+		bit_not
+	};
+
+	//
+	// Binding strength of binary operators as in C, 0 for the unary-only operator ~
+	//
+	[[nodiscard]]
+	constexpr uint8_t binary_precedence(expression_operator op)
+	{
+		switch (op)
+		{
+			case expression_operator::bit_or:      return 1;
+			case expression_operator::bit_xor:     return 2;
+			case expression_operator::bit_and:     return 3;
+			case expression_operator::shift_left:
+			case expression_operator::shift_right: return 4;
+			case expression_operator::add:
+			case expression_operator::subtract:    return 5;
+			case expression_operator::multiply:
+			case expression_operator::divide:
+			case expression_operator::modulo:      return 6;
+
+			default:
+				return 0;
+		}
+	}
+}
+
+
+namespace chasm::ast
+{
+	//
+	// Term of an assembly-time expression. Expressions are stored in postfix order,
+	// so they are folded with a single pass over their terms and a small stack.
+	//
+	struct expression_term
+	{
+		enum class kind : uint8_t
+		{
+			number,       // 0x2A
+			constant,     // name of a define, or of a sprite for its rows count
+			label,        // @label
+			procedure,    // $procedure
+			sprite,       // #sprite
+			sprite_size,  // sizeof(#sprite)
+			negate,       // -x
+			bit_not,      // ~x
+			high_byte,    // hi(x)
+			low_byte,     // lo(x)
+			binary        // x op y
+		};
+
+		kind what;
+		expression_operator op;
+		uint16_t value;
+		symbol_id symbol;
+
+		// index of the term token in flat_nodes::tokens, for diagnostics
+		uint32_t token;
+
+		[[nodiscard]] bool is_address() const
+		{
+			return what == kind::label || what == kind::procedure || what == kind::sprite;
+		}
+	};
+}
+
+
+#endif //CHASM_EXPRESSION_HPP
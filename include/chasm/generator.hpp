@@ -1,10 +1,13 @@
 #ifndef CHASM_GENERATOR_HPP
 #define CHASM_GENERATOR_HPP
 
-#include <unordered_map>
+#include <optional>
+#include <span>
+#include <array>
 
+#include <chasm/assembler_options.hpp>
+#include <chasm/symbol_sanitizer.hpp>
 #include <chasm/chasm_exception.hpp>
-#include <chasm/ast_visitor.hpp>
 #include <chasm/config.hpp>
 #include <chasm/arch.hpp>
 #include <chasm/ast.hpp>
@@ -12,156 +15,276 @@
 
 namespace chasm
 {
-	class generator final : public ast::base_visitor
+	class generator final
 	{
 	public:
-		generator() = default;
+		//
+		// Symbols may keep being interned while generating, as long as fragments only refer to
+		// symbols interned before they were passed to generate().
+		// With a sink, errors and warnings are reported to it and the nodes with an error are dropped.
+		//
+		generator(const interner& symbols, const stream& source, const assembler_options& options, diagnostics* sink = nullptr);
 		generator(const generator&) = delete;
 		generator(generator&&) = delete;
 		generator& operator=(const generator&) = delete;
 		generator& operator=(generator&&) = delete;
 		~generator() = default;
 
-		[[nodiscard]] std::vector<uint8_t> generate(const ast::abstract_tree&);
-
-		void visit(const ast::procedure_statement&) override;
-		void visit(const ast::instruction_statement&) override;
-		void visit(const ast::define_statement&) override;
-		void visit(const ast::config_statement&) override;
-		void visit(const ast::sprite_statement&) override;
-		void visit(const ast::raw_statement&) override;
-		void visit(const ast::label_statement&) override;
+		//
+		// Checks the symbols of complete top level statements and emits their code in the same pass,
+		// fragments must be passed in source order. Top level code goes to the main section and each
+		// procedure to its own section, so they are emitted in source order without reordering nodes.
+		//
+		void generate(const ast::flat_nodes& fragment);
+
+		//
+		// Checks what needs the whole program (e.g. the entry point), lays out the main section,
+		// the procedure sections then the sprites and patches addresses
+		//
+		[[nodiscard]] std::vector<uint8_t> link();
+
+		//
+		// Instead of linking, checks the program only defines procedures, sprites and constants at
+		// its top level and returns them as a precompiled module, with the addresses left to patch
+		//
+		[[nodiscard]] std::vector<uint8_t> export_module();
+
+		//
+		// Bumped whenever the same source and options may assemble to different bytes. Part of the key
+		// of cached builds, test/build_cache.cpp pins it to the binary of a reference program.
+		//
+		static constexpr uint32_t ENCODING_REVISION = 1;
 
 	private:
+		//
+		// Address relative to the start of a section, only known once sections are laid out
+		//
+		struct code_address
+		{
+			uint32_t section;
+			uint32_t offset;
+		};
+
+		static constexpr uint32_t MAIN_SECTION = 0;
+
+		//
+		// Value of an expression, relative to the address of base unless it is NO_SYMBOL.
+		// Addresses are only known once sections are laid out, so they are patched with the value as offset.
+		//
+		struct folded_expression
+		{
+			int64_t value;
+			symbol_id base = NO_SYMBOL;
+			ast::expression_term::kind base_kind = ast::expression_term::kind::number;
+		};
+
+		//
+		// Linear pass over the nodes in [first, last), procedures excepted
+		//
+		void generate_nodes(ast::node_id first, ast::node_id last);
+		void generate_node(ast::node_id id);
+		void generate_procedure(ast::node_id procedure);
+		void generate_instruction(const ast::instruction_view& instruction);
+		void generate_config(ast::node_id config);
+		void generate_raw(ast::node_id raw);
+
+		// each procedure of the module gets its own section, its addresses are patched by link()
+		void import_module(ast::node_id module);
+
+		[[nodiscard]] source_location locate(const token& token) const;
+
+		void warn_super_instruction(const ast::instruction_view& instruction) const;
+		void warn_program_size() const;
+		void ensure_operands_count(const ast::instruction_view& inst, std::initializer_list<int> expected_counts) const;
+		void ensure_operands_count(const ast::instruction_view& inst, int expected_count) const;
+
 		void emit_byte(uint8_t b);
 		void emit_opcode(arch::opcode opcode);
 		void emit_opcodes(const std::vector<arch::opcode>& opcodes);
 
-		void register_constant(std::string&& symbol, arch::imm value);
-		void register_sprite(std::string&& symbol, const arch::sprite& sprite);
-		void register_symbol_addr(std::string symbol);
-		void register_patch_location(std::string&& symbol);
-
-		[[nodiscard]] arch::opcode encode_add(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_sub(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_suba(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_or(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_and(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_xor(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_shr(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_shl(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_rdump(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_rload(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_mov(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_draw(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_cls(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_rand(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_bcd(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_wkey(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_ske(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_skne(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_ret(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_jmp(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_call(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_se(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_sne(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_inc(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_ldf(const ast::instruction_statement&);
-
-		[[nodiscard]] arch::opcode encode_exit(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_scrd(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_scrl(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_scrr(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_high(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_low(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_ldfs(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_saverpl(const ast::instruction_statement&);
-		[[nodiscard]] arch::opcode encode_loadrpl(const ast::instruction_statement&);
-
-		[[nodiscard]] std::vector<arch::opcode> encode_swp(const ast::instruction_statement&);
-
-		void post_visit();
-
-		[[nodiscard]] arch::imm operand2imm(const token& token,
+		void register_constant(symbol_id symbol, arch::imm value);
+		void register_sprite(symbol_id symbol, const arch::sprite& sprite);
+		void register_symbol_addr(symbol_id symbol);
+		void register_label_addr(symbol_id label);
+		void register_patch_location(symbol_id symbol, int32_t offset = 0);
+		void register_label_patch_location(symbol_id label, int32_t offset = 0);
+		void register_address_patch(const folded_expression& address);
+
+		void grow_symbol_tables();
+		void resolve_local_labels();
+		void emit_sprites(size_t code_size);
+		void apply_patch(size_t location, int64_t address, source_offset statement);
+
+		// throws error, or reports it to the sink at the statement so that linking goes on
+		void reject_patch(const chasm_exception& error, source_offset statement) const;
+
+		[[nodiscard]] code_address here() const;
+		[[nodiscard]] arch::addr absolute(const code_address& address) const;
+		void generate_symbols_file(const std::string& path) const;
+
+		[[nodiscard]] arch::opcode encode_add(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_sub(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_suba(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_or(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_and(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_xor(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_shr(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_shl(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_rdump(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_rload(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_mov(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_draw(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_cls(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_rand(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_bcd(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_wkey(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_ske(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_skne(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_ret(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_jmp(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_call(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_se(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_sne(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_inc(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_ldf(const ast::instruction_view&);
+
+		[[nodiscard]] arch::opcode encode_exit(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_scrd(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_scrl(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_scrr(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_high(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_low(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_ldfs(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_saverpl(const ast::instruction_view&);
+		[[nodiscard]] arch::opcode encode_loadrpl(const ast::instruction_view&);
+
+		[[nodiscard]] std::vector<arch::opcode> encode_swp(const ast::instruction_view&);
+
+		[[nodiscard]] arch::imm operand2imm(arch::imm value,
+											symbol_id symbol,
 											arch::imm_format imm_width = arch::imm_format::fmt_imm8) const;
 
 		[[nodiscard]] arch::imm operand2imm(const ast::instruction_operand& operand,
 											arch::imm_format type = arch::imm_format::fmt_imm8) const;
 
+		// value or symbol an address operand refers to
+		[[nodiscard]] folded_expression operand2address(const ast::instruction_operand& operand) const;
+
+		//
+		// Expressions are folded once the symbols they use are defined, i.e. when emitting their statement.
+		// Constants must be non-negative and fit in imm_width bits.
+		//
+		[[nodiscard]] folded_expression fold(std::span<const ast::expression_term> terms) const;
+		[[nodiscard]] arch::imm fold_constant(std::span<const ast::expression_term> terms, arch::imm_format imm_width) const;
+		[[nodiscard]] int64_t constant_value(symbol_id symbol) const;
+
 	private:
 
 		struct address_patch
 		{
-			size_t location;
-			std::string sym;
+			code_address location;
+			symbol_id sym;
+
+			// added to the address of sym, e.g. mov ar, @table + 2
+			int32_t offset;
+
+			// where errors of the patch are reported
+			source_offset statement;
+		};
+
+		// patch whose target was resolved before sections were laid out
+		struct address_fixup
+		{
+			code_address location;
+			code_address target;
+			int32_t offset;
+			source_offset statement;
+		};
+
+		//
+		// Address of a symbol for the symbols file, scope is the procedure of local labels
+		//
+		struct symbol_address
+		{
+			symbol_id scope;
+			symbol_id sym;
+			bool label;
+			code_address addr;
 		};
 
+		const interner* names;
+		const stream* source;
+		const ast::flat_nodes* nodes {};
+
+		assembler_options options;
+
+		diagnostics* sink;
+		symbol_sanitizer sanitizer;
+		config cfg;
+
+		//
+		// sections[MAIN_SECTION] holds top level code, then each procedure has its own section,
+		// they are concatenated in that order by link() which also appends the sprites
+		//
+		std::vector<std::vector<uint8_t>> sections;
+		uint32_t current_section = MAIN_SECTION;
+
+		std::vector<size_t> section_bases;
 		std::vector<uint8_t> binary;
+
+		//
+		// All the tables below are indexed by symbol_id. Procedures, sprites and labels outside
+		// of procedures share the global scope, labels of a procedure only live until its end.
+		//
+		std::vector<std::optional<code_address>> addresses;
+		std::vector<std::optional<code_address>> local_addresses;
+		std::vector<std::optional<arch::imm>> constants;
+		std::vector<std::optional<arch::sprite>> sprites;
+
+		std::vector<symbol_id> local_labels;
+		std::vector<symbol_id> sprites_order;
+
+		// constants defined at the top level, exported by modules
+		std::vector<symbol_id> global_constants;
+		std::vector<symbol_address> symbols_map;
+
 		std::vector<address_patch> patches;
-		std::unordered_map<std::string, arch::addr> sym_addresses;
-		std::unordered_map<std::string, arch::imm> constants;
-		std::unordered_map<std::string, arch::sprite> sprites;
-		config cfg;
+		std::vector<address_patch> local_patches;
+		std::vector<address_fixup> fixups;
 
-		std::string current_proc_name;
-
-		typedef arch::opcode(generator::*encoder)(const ast::instruction_statement&);
-		typedef std::vector<arch::opcode>(generator::*pseudo_encoder)(const ast::instruction_statement&);
-
-		const std::unordered_map<arch::instruction_id, encoder> mnemonic_encoders = {
-				{ arch::instruction_id::ADD,   &generator::encode_add },
-				{ arch::instruction_id::SUB,   &generator::encode_sub },
-				{ arch::instruction_id::SUBA,  &generator::encode_suba },
-				{ arch::instruction_id::OR,    &generator::encode_or },
-				{ arch::instruction_id::AND,   &generator::encode_and },
-				{ arch::instruction_id::XOR,   &generator::encode_xor },
-				{ arch::instruction_id::SHR,   &generator::encode_shr },
-				{ arch::instruction_id::SHL,   &generator::encode_shl },
-				{ arch::instruction_id::RDUMP, &generator::encode_rdump },
-				{ arch::instruction_id::RLOAD, &generator::encode_rload },
-				{ arch::instruction_id::MOV,   &generator::encode_mov },
-				{ arch::instruction_id::DRAW,  &generator::encode_draw },
-				{ arch::instruction_id::CLS,   &generator::encode_cls },
-				{ arch::instruction_id::RAND,  &generator::encode_rand },
-				{ arch::instruction_id::BCD,   &generator::encode_bcd },
-				{ arch::instruction_id::WKEY,  &generator::encode_wkey },
-				{ arch::instruction_id::SKE,   &generator::encode_ske },
-				{ arch::instruction_id::SKNE,  &generator::encode_skne },
-				{ arch::instruction_id::RET,   &generator::encode_ret },
-				{ arch::instruction_id::JMP,   &generator::encode_jmp },
-				{ arch::instruction_id::CALL,  &generator::encode_call },
-				{ arch::instruction_id::SE,    &generator::encode_se },
-				{ arch::instruction_id::SNE,   &generator::encode_sne },
-				{ arch::instruction_id::INC,   &generator::encode_inc },
-				{ arch::instruction_id::LDF,   &generator::encode_ldf },
-		};
+		symbol_id current_proc = NO_SYMBOL;
 
-		const std::unordered_map<arch::instruction_id, encoder> super_mnemonic_encoders = {
-				{ arch::instruction_id::EXIT,    &generator::encode_exit },
-				{ arch::instruction_id::SCRD,    &generator::encode_scrd },
-				{ arch::instruction_id::SCRL,    &generator::encode_scrl },
-				{ arch::instruction_id::SCRR,    &generator::encode_scrr },
-				{ arch::instruction_id::HIGH,    &generator::encode_high },
-				{ arch::instruction_id::LOW,     &generator::encode_low },
-				{ arch::instruction_id::LDFS,    &generator::encode_ldfs },
-				{ arch::instruction_id::SAVERPL, &generator::encode_saverpl },
-				{ arch::instruction_id::LOADRPL, &generator::encode_loadrpl },
-		};
+		// first token of the statement being generated, patches registered by it are reported there
+		source_offset current_statement {};
 
+		using encode_fn        = arch::opcode (generator::*)(const ast::instruction_view&);
+		using pseudo_encode_fn = std::vector<arch::opcode> (generator::*)(const ast::instruction_view&);
 
-		const std::unordered_map<arch::instruction_id, pseudo_encoder> pseudo_mnemonic_encoders = {
-				{arch::instruction_id::SWP, &generator::encode_swp }
+		//
+		// How to encode each instruction, indexed by arch::instruction_id
+		//
+		struct encoding
+		{
+			encode_fn encode {};
+			pseudo_encode_fn encode_pseudo {};
+
+			// SuperCHIP-8 instruction
+			bool super {};
 		};
+
+		using encoding_table = std::array<encoding, arch::instruction_id::count>;
+
+		static const encoding_table encodings;
 	};
 
 	namespace generator_exception
 	{
 		struct invalid_operand_type : chasm_exception
 		{
-			explicit invalid_operand_type(const ast::instruction_statement& inst)
+			invalid_operand_type(const ast::instruction_view& inst, const source_location& where)
 				: chasm_exception("Invalid operand type for instruction \"{}\" at {}.",
 								  inst.mnemonic.to_string(),
-								  to_string(inst.mnemonic.source_location))
+								  to_string(where))
 			{}
 		};
 
@@ -183,17 +306,25 @@ namespace chasm
 
 		struct invalid_operands_count : chasm_exception
 		{
-			explicit invalid_operands_count(const ast::instruction_statement& inst,
-											std::initializer_list<int> expected_counts)
+			invalid_operands_count(const ast::instruction_view& inst,
+								   const source_location& where,
+								   std::initializer_list<int> expected_counts)
 				: chasm_exception("Invalid operands count for instruction \"{}\" at {}.\n"
 								  "Expected operands count to be among {} but {} operands were provided",
 								  inst.mnemonic.to_string(),
-								  to_string(inst.mnemonic.source_location),
+								  to_string(where),
 								  to_string(expected_counts),
 								  inst.operands.size())
 			{}
 		};
 
+		struct invalid_expression : chasm_exception
+		{
+			invalid_expression(std::string_view reason, const source_location& where)
+				: chasm_exception("Invalid expression at {}: {}.", to_string(where), reason)
+			{}
+		};
+
 		struct invalid_immediate_format : chasm_exception
 		{
 			invalid_immediate_format(arch::imm imm, arch::imm_format bit_format)
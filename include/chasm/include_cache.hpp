@@ -0,0 +1,190 @@
+#ifndef CHASM_INCLUDE_CACHE_HPP
+#define CHASM_INCLUDE_CACHE_HPP
+
+
+#include <unordered_map>
+#include <filesystem>
+#include <optional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <span>
+
+#include <chasm/precompiled_module.hpp>
+#include <chasm/chasm_exception.hpp>
+#include <chasm/statements.hpp>
+#include <chasm/interner.hpp>
+#include <chasm/stream.hpp>
+
+
+namespace chasm
+{
+	//
+	// File an included file depends on, with the hash of the content it was parsed from
+	//
+	struct include_dependency
+	{
+		std::filesystem::path path;
+		uint64_t content_hash;
+	};
+
+
+	//
+	// Top level statements of an included file, with their own symbols and token offsets.
+	// Parsed entries never change, they are shared by every tree including the file.
+	//
+	struct parsed_include
+	{
+		parsed_include(std::filesystem::path file_path, uint64_t hash, std::string&& text);
+
+		std::filesystem::path path;
+		uint64_t content_hash;
+
+		// owns the text tokens are views of, files included by this one are attached to it
+		stream source;
+
+		ast::flat_nodes nodes;
+		interner symbols;
+
+		// every file included by this one, directly or not, and precompiled modules it includes
+		std::vector<include_dependency> dependencies;
+	};
+
+
+	//
+	// Module shared by the trees including it, with the hash of the content it was loaded from
+	//
+	struct loaded_module
+	{
+		std::shared_ptr<const precompiled_module> module;
+		uint64_t content_hash;
+	};
+
+
+	//
+	// Bounds of a cache kept for long, 0 for no bound. The size of an entry is the size of the text
+	// of an included file or of the content of a module.
+	//
+	struct include_cache_limits
+	{
+		size_t max_entries = 0;
+		size_t max_bytes = 0;
+	};
+
+
+	//
+	// Parses each included file once, entries are looked up by path and are parsed again
+	// only if the content of the file or of one of its dependencies changed.
+	// Precompiled modules are shared the same way.
+	// Past its limits the least recently used entries are evicted, trees still holding them keep them.
+	// Safe to use from several threads.
+	//
+	class include_cache
+	{
+	public:
+		explicit include_cache(const include_cache_limits& cache_limits = {});
+
+		include_cache(const include_cache&) = delete;
+		include_cache(include_cache&&) = delete;
+		include_cache& operator=(const include_cache&) = delete;
+		include_cache& operator=(include_cache&&) = delete;
+
+		//
+		// including is the chain of files including path, from the assembled file to the one
+		// including path directly, an include cycle is an error
+		//
+		[[nodiscard]] std::shared_ptr<const parsed_include> parse(const std::filesystem::path& path,
+																  std::span<const std::filesystem::path> including);
+
+		//
+		// Maps and validates the module, nothing of it is parsed. A cached module is returned without
+		// reading the file while its size and modification time are the ones it was loaded with.
+		//
+		[[nodiscard]] loaded_module load_module(const std::filesystem::path& path);
+
+		[[nodiscard]] size_t size() const;
+		void clear();
+
+		// size of the entries held, and count of entries evicted so far
+		[[nodiscard]] size_t bytes() const;
+		[[nodiscard]] uint64_t evictions() const;
+
+		// 64 bits FNV-1a, only compared against the hash of a previous content of the same file
+		[[nodiscard]] static uint64_t content_hash(std::span<const uint8_t> content);
+
+	private:
+		// evicts least recently used entries until the cache is within its limits, the lock must be held
+		void evict();
+
+	private:
+		mutable std::mutex guard;
+
+		include_cache_limits limits;
+
+		struct cached_include
+		{
+			std::shared_ptr<const parsed_include> include;
+			size_t bytes;
+			uint64_t last_use;
+		};
+
+		std::unordered_map<std::string, cached_include> entries;
+
+		struct file_stamp
+		{
+			uintmax_t size;
+			std::filesystem::file_time_type modified;
+
+			bool operator==(const file_stamp&) const = default;
+		};
+
+		struct cached_module
+		{
+			uint64_t content_hash;
+			std::shared_ptr<const precompiled_module> module;
+			size_t bytes;
+			uint64_t last_use;
+
+			// stamp of the file when its content was last hashed, and when that was
+			file_stamp stamp;
+			std::filesystem::file_time_type stamped_at;
+		};
+
+		std::unordered_map<std::string, cached_module> modules;
+
+		// incremented on every use of an entry, an entry is stamped with it when used
+		uint64_t use_clock = 0;
+
+		size_t held_bytes = 0;
+		uint64_t evicted = 0;
+	};
+
+
+	namespace include_exception
+	{
+		struct file_not_found : chasm_exception
+		{
+			explicit file_not_found(const std::filesystem::path& path)
+				: chasm_exception("Included file \"{}\" could not be found.", path.string())
+			{}
+		};
+
+		struct circular_include : chasm_exception
+		{
+			explicit circular_include(const std::filesystem::path& path)
+				: chasm_exception("File \"{}\" includes itself, directly or through other included files.", path.string())
+			{}
+		};
+
+		struct error_in_file : chasm_exception
+		{
+			error_in_file(const std::filesystem::path& path, std::string_view error)
+				: chasm_exception("In included file \"{}\": {}", path.string(), error)
+			{}
+		};
+	}
+}
+
+
+#endif //CHASM_INCLUDE_CACHE_HPP
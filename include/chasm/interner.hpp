@@ -0,0 +1,53 @@
+#ifndef CHASM_INTERNER_HPP
+#define CHASM_INTERNER_HPP
+
+
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <deque>
+
+
+namespace chasm
+{
+	//
+	// Dense identifier of an interned name, the first name interned gets 0
+	//
+	using symbol_id = uint32_t;
+
+	constexpr symbol_id NO_SYMBOL = std::numeric_limits<symbol_id>::max();
+
+	//
+	// Maps every distinct name of a compilation to a symbol_id, so that later stages
+	// index flat vectors with symbol ids instead of hashing strings
+	//
+	class interner
+	{
+	public:
+		interner() = default;
+		~interner() = default;
+
+		interner(const interner&) = delete;
+		interner(interner&&) = default;
+		interner& operator=(const interner&) = delete;
+		interner& operator=(interner&&) = default;
+
+		[[nodiscard]] symbol_id intern(std::string_view name);
+		[[nodiscard]] std::optional<symbol_id> find(std::string_view name) const;
+		[[nodiscard]] std::string_view name(symbol_id id) const;
+
+		// every symbol_id of this interner is below size()
+		[[nodiscard]] size_t size() const;
+
+	private:
+		// deque elements never move, so the views used as keys stay valid
+		std::deque<std::string> names;
+		std::unordered_map<std::string_view, symbol_id> ids;
+	};
+}
+
+
+#endif //CHASM_INTERNER_HPP
@@ -0,0 +1,85 @@
+#ifndef CHASM_JSON_HPP
+#define CHASM_JSON_HPP
+
+
+#include <string_view>
+#include <variant>
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+
+#include <chasm/chasm_exception.hpp>
+
+
+namespace chasm::json
+{
+	//
+	// Just enough JSON for the requests of the assembler server: a parsed document is a tree of
+	// values, numbers are doubles and objects are sorted by key.
+	//
+	class value
+	{
+	public:
+		using array = std::vector<value>;
+		using object = std::map<std::string, value, std::less<>>;
+
+		value() = default;
+		explicit value(bool boolean);
+		explicit value(double number);
+		explicit value(std::string string);
+		explicit value(array elements);
+		explicit value(object members);
+
+		[[nodiscard]] bool is_null() const;
+		[[nodiscard]] bool is_bool() const;
+		[[nodiscard]] bool is_number() const;
+		[[nodiscard]] bool is_string() const;
+		[[nodiscard]] bool is_array() const;
+		[[nodiscard]] bool is_object() const;
+
+		// each throws json_exception::type_mismatch if the value is of another type
+		[[nodiscard]] bool as_bool() const;
+		[[nodiscard]] double as_number() const;
+		[[nodiscard]] const std::string& as_string() const;
+		[[nodiscard]] const array& as_array() const;
+		[[nodiscard]] const object& as_object() const;
+
+		// member of an object, nullptr if it has none with this key or if the value is not an object
+		[[nodiscard]] const value* find(std::string_view key) const;
+
+	private:
+		// arrays and objects are boxed, value is incomplete where they are declared
+		std::variant<std::monostate, bool, double, std::string, std::shared_ptr<const array>, std::shared_ptr<const object>> storage;
+	};
+
+	// throws json_exception::invalid_json unless text is exactly one value, surrounded by whitespace
+	[[nodiscard]] value parse(std::string_view text);
+
+	// text as a quoted and escaped JSON string
+	void append_string(std::string& json, std::string_view text);
+
+	// number as written in JSON, without a fraction if it has none
+	[[nodiscard]] std::string to_string(double number);
+
+
+	namespace json_exception
+	{
+		struct invalid_json : chasm_exception
+		{
+			invalid_json(size_t offset, std::string_view reason)
+				: chasm_exception("Invalid JSON at offset {}: {}.", offset, reason)
+			{}
+		};
+
+		struct type_mismatch : chasm_exception
+		{
+			explicit type_mismatch(std::string_view expected)
+				: chasm_exception("Expected a JSON {}.", expected)
+			{}
+		};
+	}
+}
+
+
+#endif //CHASM_JSON_HPP
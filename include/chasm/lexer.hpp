@@ -2,22 +2,28 @@
 #define CHASM_LEXER_HPP
 
 
+#include <initializer_list>
 #include <string_view>
+#include <type_traits>
 #include <exception>
-#include <variant>
+#include <utility>
 #include <memory>
 #include <vector>
 #include <format>
+#include <thread>
 
 #include <chasm/chasm_exception.hpp>
 #include <chasm/source_location.hpp>
+#include <chasm/diagnostics.hpp>
+#include <chasm/expression.hpp>
+#include <chasm/spsc_ring.hpp>
 #include <chasm/stream.hpp>
 #include <chasm/arch.hpp>
 
 
 namespace chasm
 {
-    enum class token_type
+    enum class token_type : uint8_t
     {
         eof,
 
@@ -30,6 +36,8 @@ namespace chasm
 		keyword_raw,         // raw(...)
 		keyword_proc_start,  // proc name
 		keyword_proc_end,    // endp name
+		keyword_include,     // include "file"
+		string_literal,      // "file" (quotes included)
         identifier,          // constants defined with the "define" keywords, label/proc names and config names
         instruction,         // call, ret, jmp, cls...
 		register_name,       // special and general purpose registers
@@ -43,47 +51,147 @@ namespace chasm
 		dollar_proc,
 		hash_sprite,
 		comma,
-		equal
+		equal,
+		operator_sign        // expression_operator of + - * / % << >> & | ^ ~
     };
 
+	constexpr size_t token_type_count = std::to_underlying(token_type::operator_sign) + 1;
+
+	//
+	// Set of token types as a bitmask, cheap enough to be built at compile-time and passed by value
+	//
+	class token_set
+	{
+	public:
+		constexpr token_set() = default;
+
+		constexpr token_set(token_type type)
+			: bits(bit(type))
+		{}
+
+		constexpr token_set(std::initializer_list<token_type> types)
+		{
+			for (const auto type : types)
+				bits |= bit(type);
+		}
+
+		[[nodiscard]] constexpr bool contains(token_type type) const
+		{
+			return bits & bit(type);
+		}
+
+		[[nodiscard]] constexpr bool empty() const
+		{
+			return bits == 0;
+		}
+
+		[[nodiscard]] constexpr token_set operator|(token_set other) const
+		{
+			token_set joined;
+			joined.bits = bits | other.bits;
+
+			return joined;
+		}
+
+	private:
+		[[nodiscard]] static constexpr uint32_t bit(token_type type)
+		{
+			return uint32_t(1) << std::to_underlying(type);
+		}
+
+		uint32_t bits {};
+	};
+
+	static_assert(token_type_count <= 32, "token_set bitmask is too small for token_type");
+
+	//
+	// Tokens are plain records, the lexeme is a view into the buffer owned by the lexer's stream,
+	// so that buffer must outlive every token (and every AST node) produced from it.
+	//
 	struct token
     {
         token_type type;
-		source_location source_location;
-		std::variant<uint16_t, std::string> data;
+
+		// numerical value, arch::instruction_id of instructions, arch::register_id of registers
+		// or expression_operator of operator signs
+		uint16_t value;
+
+		// resolved to a line and column through the stream (or the tree) the token was lexed from
+		source_offset offset;
+		std::string_view lexeme;
 
 		[[nodiscard]] std::string to_string() const
 		{
-			if (std::holds_alternative<uint16_t>(data))
-				return std::to_string(std::get<uint16_t>(data));
+			if (type == token_type::numerical)
+				return std::to_string(value);
 
-			return std::get<std::string>(data);
+			return std::string(lexeme);
 		}
 
 		[[nodiscard]] uint16_t to_integer() const
 		{
-			return std::get<uint16_t>(data);
+			return value;
 		}
     };
 
+	static_assert(std::is_trivially_copyable_v<token>);
+
 
     class lexer final
     {
     public:
         explicit lexer(std::string&& buff);
+        explicit lexer(const char* buff);
 
-        ~lexer() = default;
+		// Lexes a buffer owned by the caller (e.g. a mapped file) without copying it
+		explicit lexer(std::span<const char> source);
+
+		// Lexes the [range_begin, range_end) range of a buffer owned by the caller, token offsets
+		// (and so locations in errors) stay relative to the whole buffer
+		lexer(std::span<const char> source, size_t range_begin, size_t range_end);
+
+        ~lexer();
 
         lexer(const lexer&)            = delete;
         lexer(lexer&&)                 = delete;
         lexer& operator=(const lexer&) = delete;
         lexer& operator=(lexer&&)      = delete;
 
-		[[nodiscard]] std::vector<token> enumerate_tokens();
-
-    private:
+		//
+		// Lexes the rest of the source, with more than one job the source is split at newlines
+		// and the chunks are lexed concurrently, the result is the same as a sequential run
+		//
+		[[nodiscard]] std::vector<token> enumerate_tokens(unsigned jobs = 1);
+
+		//
+		// Lexes the rest of the source with enumerate_tokens(jobs), next_token() then serves
+		// the buffered tokens so the parser can still pull them one by one
+		//
+		void lex_ahead(unsigned jobs);
+
+		//
+		// Lexes the rest of the source on a background thread, next_token() then pulls the tokens
+		// by batches as they are produced. A lexing error is raised by next_token() once the tokens
+		// preceding it were served, as in a sequential run.
+		//
+		void lex_concurrently();
+
+		//
+		// Lexes the next token on demand, returns an eof token once the stream is exhausted
+		//
 		[[nodiscard]] token next_token();
 
+		//
+		// Lexing errors of next_token() are then reported to sink and the invalid lexeme is skipped.
+		// Tokens lexed ahead or concurrently still stop at the first error.
+		//
+		void report_to(diagnostics& sink);
+
+		[[nodiscard]] const chasm::stream& source() const;
+		[[nodiscard]] chasm::stream& source();
+		[[nodiscard]] source_location locate(const token& token) const;
+
+    private:
         [[nodiscard]]
         char peek_chr() const;
         char next_chr();
@@ -91,18 +199,72 @@ namespace chasm
         void skip_comment();
         void skip_wspaces();
 
-		[[nodiscard]] token make_token(token_type type, std::string lexeme = {}) const;
-		[[nodiscard]] token make_numerical_token(arch::size_type numerical_value) const;
+		[[nodiscard]] token make_token(token_type type, size_t lexeme_start, uint16_t value = 0) const;
+		[[nodiscard]] token make_numerical_token(arch::size_type numerical_value, size_t lexeme_start) const;
 
-		[[nodiscard]] arch::size_type read_numeric_lexeme();
-        [[nodiscard]] std::string     read_alpha_lexeme();
+		[[nodiscard]] source_location cursor() const;
+
+		[[nodiscard]] arch::size_type  read_numeric_lexeme(size_t lexeme_start);
+        [[nodiscard]] std::string_view read_alpha_lexeme();
+
+		[[nodiscard]] std::vector<token> enumerate_chunks(unsigned jobs);
+		[[nodiscard]] token next_concurrent_token();
+		[[nodiscard]] token lex_token();
+		void skip_invalid_lexeme();
 
     private:
         chasm::stream istream;
-        source_location cursor;
+
+		std::vector<token> lexed_ahead;
+		size_t next_lexed_ahead {};
+
+		diagnostics* sink {};
+
+		struct lexed_batch
+		{
+			std::vector<token> tokens;
+
+			// set on a last batch without tokens if lexing failed
+			std::exception_ptr error;
+		};
+
+		static constexpr size_t BATCH_SIZE = 4096;
+
+		using batch_ring = spsc_ring<lexed_batch, 16>;
+
+		// the thread is declared last so that it is joined before anything it uses is destroyed
+		std::unique_ptr<batch_ring> lexed_concurrently;
+		std::jthread lexing_thread;
     };
 
 
+	//
+	// Replacement of the [offset, offset + erased) bytes of a source by the inserted text
+	//
+	struct text_edit
+	{
+		size_t offset;
+		size_t erased;
+		std::string_view inserted;
+	};
+
+	//
+	// Tokens [first, first + count) of the updated stream were re-lexed, the others were kept
+	//
+	struct relexed_range
+	{
+		size_t first;
+		size_t count;
+	};
+
+	//
+	// Updates tokens, lexed from a source before the edit, to match source which has the edit applied.
+	// Only the lines from the edit up to the first token that lines up with an old one are re-lexed,
+	// kept tokens are shifted and rebased onto source. tokens is left untouched if lexing fails.
+	//
+	relexed_range relex(std::vector<token>& tokens, std::span<const char> source, const text_edit& edit);
+
+
     namespace lexer_exception
     {
         struct invalid_digit_for_base : chasm_exception
@@ -118,7 +280,7 @@ namespace chasm
 
 		struct numeric_constant_too_large : chasm_exception
 		{
-			numeric_constant_too_large(std::string numeric_lexeme, const source_location& source_loc)
+			numeric_constant_too_large(std::string_view numeric_lexeme, const source_location& source_loc)
 				: chasm_exception(
 						"Numeric constant \"{}\" at {} is too large for a 16-bit value.",
 						numeric_lexeme,
@@ -126,6 +288,15 @@ namespace chasm
 			{}
 		};
 
+		struct unterminated_string_literal : chasm_exception
+		{
+			explicit unterminated_string_literal(const source_location& source_loc)
+				: chasm_exception(
+						"String literal at {} is not terminated before the end of the line.",
+						chasm::to_string(source_loc))
+			{}
+		};
+
         struct undefined_character_token : chasm_exception
         {
             explicit undefined_character_token(char c, const source_location& source_loc)
@@ -176,6 +347,14 @@ namespace chasm
 				return "@";
 			case token_type::dollar_proc:
 				return "$";
+			case token_type::hash_sprite:
+				return "#";
+			case token_type::operator_sign:
+				return "operator";
+			case token_type::keyword_include:
+				return "include";
+			case token_type::string_literal:
+				return "string";
 
 			default:
 				return "undefined";
@@ -183,12 +362,17 @@ namespace chasm
 	}
 
 	[[nodiscard]]
-	inline std::string to_string(std::initializer_list<token_type> types)
+	inline std::string to_string(token_set types)
 	{
 		std::string joined;
 
-		for (const auto type : types)
+		for (size_t i = 0; i < token_type_count; ++i)
 		{
+			const auto type = static_cast<token_type>(i);
+
+			if (!types.contains(type))
+				continue;
+
 			if (!joined.empty())
 				joined += ", ";
 
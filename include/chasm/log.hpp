@@ -2,29 +2,79 @@
 #define CHASM_LOG_HPP
 
 
-#include <format>
-#include <iostream>
 #include <string_view>
+#include <iostream>
+#include <utility>
+#include <format>
+#include <string>
+#include <vector>
+#include <mutex>
 
 
 namespace chasm::log
 {
+    namespace details
+    {
+        inline std::mutex output_mutex;
+
+        // lines logged by the current thread while a capture is alive
+        inline thread_local std::vector<std::string>* captured = nullptr;
+
+        //
+        // A line is written at once, lines logged by different threads are never mixed
+        //
+        inline void write(std::ostream& os, std::string_view prefix, const std::string& message)
+        {
+            if (captured)
+            {
+                captured->push_back(std::string(prefix) + message);
+                return;
+            }
+
+            const std::scoped_lock lock(output_mutex);
+            os << prefix << message << '\n';
+        }
+    }
+
+    //
+    // Keeps what the current thread logs into lines instead of printing it, until destroyed.
+    // Used to report the log of each file of a batch together, whichever thread assembled it.
+    //
+    class capture
+    {
+    public:
+        explicit capture(std::vector<std::string>& lines)
+            : previous(std::exchange(details::captured, &lines))
+        {}
+
+        ~capture()
+        {
+            details::captured = previous;
+        }
+
+        capture(const capture&) = delete;
+        capture& operator=(const capture&) = delete;
+
+    private:
+        std::vector<std::string>* previous;
+    };
+
     template<typename ...Args>
     void info(std::string_view fmt, Args&& ... args)
     {
-        std::cout << "[INFO] " << std::vformat(fmt, std::make_format_args(args...)) << '\n';
+        details::write(std::cout, "[INFO] ", std::vformat(fmt, std::make_format_args(args...)));
     }
 
     template<typename ...Args>
     void warn(std::string_view fmt, Args&& ... args)
     {
-        std::cout << "[WARN] " << std::vformat(fmt, std::make_format_args(args...)) << '\n';
+        details::write(std::cout, "[WARN] ", std::vformat(fmt, std::make_format_args(args...)));
     }
 
     template<typename ...Args>
     void error(std::string_view fmt, Args&& ... args)
     {
-        std::cerr << "[ERROR] " << std::vformat(fmt, std::make_format_args(args...)) << '\n';
+        details::write(std::cerr, "[ERROR] ", std::vformat(fmt, std::make_format_args(args...)));
     }
 }
 
@@ -0,0 +1,50 @@
+#ifndef CHASM_MAPPED_FILE_HPP
+#define CHASM_MAPPED_FILE_HPP
+
+
+#include <filesystem>
+#include <string_view>
+#include <cstdint>
+#include <vector>
+#include <span>
+
+
+namespace chasm
+{
+	//
+	// Read-only view of a whole file. Regular files are memory mapped, anything that cannot be
+	// mapped (pipes, character devices, empty files) is read once into an internal buffer instead.
+	// Views handed out by bytes() and text() are valid as long as the mapped_file lives.
+	//
+	class mapped_file
+	{
+	public:
+		explicit mapped_file(const std::filesystem::path& path);
+		~mapped_file();
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file(mapped_file&&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		mapped_file& operator=(mapped_file&&) = delete;
+
+		[[nodiscard]] std::span<const uint8_t> bytes() const;
+		[[nodiscard]] std::span<const char> text() const;
+
+		[[nodiscard]] bool empty() const;
+		[[nodiscard]] bool is_mapped() const;
+
+	private:
+		bool map(const std::filesystem::path& path);
+		void read(const std::filesystem::path& path);
+
+	private:
+		const char* data {};
+		size_t size {};
+
+		void* mapping {};
+		std::vector<char> fallback;
+	};
+}
+
+
+#endif //CHASM_MAPPED_FILE_HPP
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <chasm/cxxopts.hpp>
 
@@ -17,14 +18,24 @@ namespace chasm
 		{
 			opts.add_options()
 					("h,help", "Show help message")
-					("in", "chasm source file to assemble", cxxopts::value<std::string>())
+					("in", "chasm source file to assemble, several files are assembled as a batch", cxxopts::value<std::vector<std::string>>())
 					("out", "The generated machine code output file path", cxxopts::value<std::string>()->default_value("out.c8c"))
 					("dis", "Disassemble the given assembled file", cxxopts::value<std::string>())
 					("pad-sprites", "Pad odd sized sprites")
 					("hex", "Hexdumps the generated machine code, argument is the amount of opcodes per line", cxxopts::value<unsigned int>()->implicit_value("4"))
 					("symbols", "Generate a file with symbols location in memory/machine code", cxxopts::value<std::string>()->implicit_value("out.c8s"))
 					("relocate", "Address in which the binary is supposed to be loaded", cxxopts::value<chasm::arch::addr>()->default_value("0x200"))
-					("super", "Specify the target ISA to be the SUPER-CHIP and removes warning when using non CHIP-8 instructions");
+					("super", "Specify the target ISA to be the SUPER-CHIP and removes warning when using non CHIP-8 instructions")
+					("j,jobs", "Amount of threads used to lex large sources, 0 uses every core", cxxopts::value<unsigned int>()->default_value("1")->implicit_value("0"))
+					("pipeline", "Run the lexer, the parser and the code generation concurrently, for large sources")
+					("diagnostics", "Report every error and warning instead of stopping at the first error, as text or json", cxxopts::value<std::string>()->implicit_value("text"))
+					("depfile", "Write a Make/Ninja depfile of the output next to it, listing the source and its included files")
+					("module", "Compile the input to a precompiled module (.c8m) of its procedures, sprites and constants, to be included by programs")
+					("batch", "Assemble every file listed in the manifest, one source and an optional output per line, on every core", cxxopts::value<std::string>())
+					("serve", "Answer newline delimited JSON requests on a Unix domain socket at the given path, or on the standard input and output", cxxopts::value<std::string>()->implicit_value("-"))
+					("cache", "Restore outputs of identical builds (source, included files, options) from this directory instead of assembling", cxxopts::value<std::string>()->implicit_value(".chasm-cache"))
+					("cache-size", "Size in MiB the cache is trimmed to, least recently used builds first", cxxopts::value<unsigned int>()->default_value("256"))
+					("cache-stats", "Show the builds held by the cache directory and its hits and misses");
 
 			parameters = opts.parse(argc, argv);
 		}
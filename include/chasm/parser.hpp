@@ -2,13 +2,15 @@
 #define CHASM_PARSER_HPP
 
 
-#include <unordered_set>
-#include <unordered_map>
 #include <string_view>
+#include <filesystem>
+#include <memory>
 #include <vector>
 #include <format>
+#include <array>
 
 #include <chasm/chasm_exception.hpp>
+#include <chasm/include_cache.hpp>
 #include <chasm/lexer.hpp>
 #include <chasm/ast.hpp>
 
@@ -19,11 +21,12 @@ namespace chasm
 	{
 		struct unmatching_procedure_names : chasm_exception
 		{
-			unmatching_procedure_names(const token& proc_name_beg, const token& proc_name_end)
+			unmatching_procedure_names(const token& proc_name_beg, const source_location& beg_loc,
+									   const token& proc_name_end, const source_location& end_loc)
 				: chasm_exception(
 					R"(Different procedure names at lines {} and {} ("{}" != "{}").)",
-					proc_name_beg.source_location.line,
-					proc_name_end.source_location.line,
+					beg_loc.line,
+					end_loc.line,
 					proc_name_beg.to_string(),
 					proc_name_end.to_string())
 			{}
@@ -31,22 +34,24 @@ namespace chasm
 
 		struct expected_others_error : chasm_exception
 		{
-			expected_others_error(const token& unexpected_, std::initializer_list<token_type> expected_types_)
+			expected_others_error(const token& unexpected_,
+								  const source_location& where,
+								  token_set expected_types_)
 				: chasm_exception(
 					"Parser got token \"{}\" but expected a token of type {} while parsing at {}.",
 					unexpected_.to_string(),
 					chasm::to_string(expected_types_),
-					chasm::to_string(unexpected_.source_location))
+					chasm::to_string(where))
 			{}
 		};
 
 		struct unexpected_error : chasm_exception
 		{
-			explicit unexpected_error(const token& unexpected_)
+			unexpected_error(const token& unexpected_, const source_location& where)
 				: chasm_exception(
 					"Unexpected token {} while parsing at {}.",
 					unexpected_.to_string(),
-					chasm::to_string(unexpected_.source_location))
+					chasm::to_string(where))
 			{}
 		};
 	}
@@ -55,71 +60,139 @@ namespace chasm
     class parser
     {
     public:
-        explicit parser(std::vector<token>&& tokens_list);
+        //
+        // Tokens are pulled from the lexer while parsing, so it must outlive the parser
+        //
+        explicit parser(lexer& token_source);
+
+		//
+		// Errors of the lexer and the parser are reported to sink, parsing resumes at the next
+		// statement and make_tree() returns the statements without errors
+		//
+		parser(lexer& token_source, diagnostics& sink);
 
         ~parser() = default;
 
         [[nodiscard]] ast::abstract_tree make_tree();
 
-    private:
-		template<typename... Args>
-		token expect(Args... types)
-		{
-			std::initializer_list<token_type> expected_types { types... };
-			const token t = advance();
-
-			for (auto expected : expected_types)
-				if (t.type == expected)
-					return t;
+		//
+		// Parses top level statements until at least min_nodes nodes were parsed or the end of
+		// the source, and hands them over with their own node ids. Returns no node at the end.
+		// Symbol ids keep referring to symbols(), which grows as fragments are parsed.
+		//
+		[[nodiscard]] ast::flat_nodes parse_fragment(size_t min_nodes);
 
-			throw parser_exception::expected_others_error(t, expected_types);
-		};
+		[[nodiscard]] const interner& symbols() const;
 
-		template<typename... Args>
-		[[nodiscard]] bool advance_if(Args... types)
-		{
-			if (no_more_tokens())
-				return false;
+		//
+		// chain is the file being parsed, preceded by the files including it. Included files are
+		// resolved relative to the directory of the file being parsed and are parsed through cache,
+		// or through a cache of this parser only if it is null.
+		// Without a chain they are resolved relative to the working directory.
+		//
+		void resolve_includes(std::vector<std::filesystem::path> chain, include_cache* cache);
 
-			std::unordered_set<token_type> expected_types { types... };
+		// every file included so far, directly or not, in the order they were first included
+		[[nodiscard]] const std::vector<std::filesystem::path>& dependencies() const;
 
-			if (expected_types.contains(token_it->type))
-			{
-				advance();
-				return true;
-			}
+		//
+		// Parses the whole source as an included file, the files it includes are attached to its stream
+		// in the order they were attached to the stream of the lexer, so their offsets are the same
+		//
+		void parse_included(parsed_include& file);
 
-			return false;
-		};
+    private:
+		token expect(token_set expected_types);
 
-		template<typename... Args>
-		[[nodiscard]] bool next_any_of(Args... types)
-		{
-			if (no_more_tokens())
-				return false;
+		[[nodiscard]] bool advance_if(token_set types);
+		[[nodiscard]] bool next_any_of(token_set types) const;
 
-			std::unordered_set<token_type> set { types... };
+		token advance();
 
-			return set.contains(token_it->type);
-		};
+		// identifiers are interned once here, later stages only deal with their symbol_id
+		[[nodiscard]] symbol_id intern(const token& identifier);
 
-		token advance();
         [[nodiscard]] bool no_more_tokens() const;
 
-        [[nodiscard]] ast::statement parse_primary_statement();
-        [[nodiscard]] ast::statement parse_raw();
-        [[nodiscard]] ast::statement parse_define();
-		[[nodiscard]] ast::statement parse_config();
-		[[nodiscard]] ast::statement parse_sprite();
-        [[nodiscard]] ast::statement parse_instruction();
-        [[nodiscard]] ast::statement parse_procedure();
-		[[nodiscard]] ast::statement parse_label();
-        [[nodiscard]] ast::instruction_operand parse_operand();
-		[[nodiscard]] std::vector<ast::instruction_operand> parse_operands();
+		//
+		// Statements allowed depend on where they appear, each context maps the lookahead
+		// token type to the rule parsing the statement it starts
+		//
+		enum parse_context : uint8_t
+		{
+			top_level,
+			procedure_body,
+			label_body,
+			context_count
+		};
+
+		using statement_rule = ast::node_id (parser::*)();
+		using grammar_table  = std::array<std::array<statement_rule, token_type_count>, context_count>;
+
+		static const grammar_table grammar;
+
+		// returns the parsed node, or NO_NODE at the end of the block
+		ast::node_id parse_statement(parse_context context);
+		void parse_block(parse_context context);
+		void parse_block_recovering(parse_context context);
+
+		// skips tokens up to the next one that can start a statement
+		void synchronize(source_offset statement_start);
+
+		ast::node_id end_block();
+		ast::node_id reject_nested_procedure();
+		ast::node_id reject_unterminated_procedure();
+
+		ast::node_id parse_raw();
+		ast::node_id parse_define();
+		ast::node_id parse_config();
+		ast::node_id parse_sprite();
+		ast::node_id parse_instruction();
+		ast::node_id parse_procedure();
+		ast::node_id parse_label();
+		ast::node_id parse_include();
+		ast::node_id parse_module_include(const token& path_token, const std::filesystem::path& path);
+		void depend_on(const std::filesystem::path& dependency, uint64_t content_hash);
+
+		// cache given to resolve_includes(), or the cache of this parser created on the first include
+		[[nodiscard]] include_cache& include_files();
+
+		[[nodiscard]] ast::instruction_operand parse_operand();
+		[[nodiscard]] ast::instruction_operand parse_value_operand();
+		void parse_operands();
+
+		//
+		// Expressions are appended to nodes.terms in postfix order, binary operators are parsed by
+		// precedence climbing: operators binding less than min_precedence are left to the caller
+		//
+		void parse_expression(uint8_t min_precedence = 1);
+		void parse_unary();
+		void parse_primary();
+		void push_term(ast::expression_term::kind what, const token& written, expression_operator op = {});
 
     private:
-        const std::vector<token> tokens;
-        std::vector<token>::const_iterator token_it;
+        lexer& lex;
+        token lookahead;
+		interner names;
+
+		// handed over to the tree by make_tree()
+		ast::flat_nodes nodes;
+
+		diagnostics* sink {};
+
+		std::vector<std::filesystem::path> include_chain;
+		include_cache* includes {};
+		std::unique_ptr<include_cache> own_includes;
+
+		// in the order they were attached to the stream of the lexer
+		std::vector<std::shared_ptr<const parsed_include>> included_files;
+		std::vector<std::filesystem::path> included_paths;
+
+		// content hash of each of included_paths when it was parsed or loaded
+		std::vector<uint64_t> included_hashes;
+
+		// errors raised once the end of file was reached after an error are caused by that error
+		bool error_at_eof {};
     };
 }
 
@@ -0,0 +1,32 @@
+#ifndef CHASM_PIPELINE_HPP
+#define CHASM_PIPELINE_HPP
+
+
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <vector>
+#include <span>
+
+#include <chasm/assembler_options.hpp>
+
+
+namespace chasm
+{
+	//
+	// Assembles source with the lexer, the parser and the code generation running on their own
+	// threads. Tokens then statements are handed from one stage to the next by batches through
+	// bounded rings, so a large source takes about as long as its slowest stage.
+	// Produces the same binary as parser(lexer(source)).make_tree().generate(options), or nothing
+	// if the source has no statement.
+	//
+	// Files included by source are resolved relative to source_file, and are added to dependencies.
+	//
+	[[nodiscard]] std::optional<std::vector<uint8_t>> assemble_pipelined(std::span<const char> source,
+																		 const assembler_options& options = {},
+																		 const std::filesystem::path& source_file = {},
+																		 std::vector<std::filesystem::path>* dependencies = nullptr);
+}
+
+
+#endif //CHASM_PIPELINE_HPP
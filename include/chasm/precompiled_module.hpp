@@ -0,0 +1,165 @@
+#ifndef CHASM_PRECOMPILED_MODULE_HPP
+#define CHASM_PRECOMPILED_MODULE_HPP
+
+
+#include <string_view>
+#include <filesystem>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <span>
+
+#include <chasm/chasm_exception.hpp>
+#include <chasm/mapped_file.hpp>
+#include <chasm/arch.hpp>
+
+
+namespace chasm
+{
+	//
+	// Precompiled module (.c8m): the encoded procedures of a library, its sprites and the procedures,
+	// sprites and constants it exports. Including one does not lex, parse or check its source again,
+	// each of its procedures becomes a section of the including program and the addresses it uses
+	// are patched once the program is laid out.
+	//
+	// The file is a header followed by tables of fixed size little-endian records, then the names
+	// of the symbols and the code of the procedures:
+	//
+	//   header      : magic, version, then the count of each table and the size of names and code
+	//   symbols     : kind, name (offset and size in names), value
+	//   sections    : code of a procedure (offset and size in code)
+	//   sprites     : rows count then MAX_SPRITE_ROWS bytes of data
+	//   relocations : location in a section, target, addend
+	//
+	// It is memory mapped and validated once when opened, records are decoded when accessed.
+	//
+	class precompiled_module
+	{
+	public:
+		static constexpr std::string_view EXTENSION = ".c8m";
+		static constexpr uint16_t VERSION = 1;
+
+		enum class symbol_kind : uint8_t
+		{
+			procedure,
+			sprite,
+			constant
+		};
+
+		struct symbol
+		{
+			symbol_kind kind;
+			std::string_view name;
+
+			// section of a procedure, index of a sprite or value of a constant
+			uint32_t value;
+		};
+
+		//
+		// Address written at offset in a section: the address of the symbol target of the module
+		// if to_symbol, else the address of the section target, plus addend
+		//
+		struct relocation
+		{
+			uint32_t section;
+			uint32_t offset;
+			uint32_t target;
+			int32_t addend;
+			bool to_symbol;
+		};
+
+		explicit precompiled_module(const std::filesystem::path& path);
+
+		precompiled_module(const precompiled_module&) = delete;
+		precompiled_module(precompiled_module&&) = delete;
+		precompiled_module& operator=(const precompiled_module&) = delete;
+		precompiled_module& operator=(precompiled_module&&) = delete;
+		~precompiled_module() = default;
+
+		[[nodiscard]] static bool is_module(const std::filesystem::path& path);
+
+		[[nodiscard]] size_t symbols_count() const;
+		[[nodiscard]] size_t sections_count() const;
+		[[nodiscard]] size_t sprites_count() const;
+		[[nodiscard]] size_t relocations_count() const;
+
+		[[nodiscard]] symbol symbol_at(size_t index) const;
+		[[nodiscard]] std::span<const uint8_t> section(size_t index) const;
+		[[nodiscard]] arch::sprite sprite(size_t index) const;
+		[[nodiscard]] relocation relocation_at(size_t index) const;
+
+		// the whole file, e.g. to hash its content
+		[[nodiscard]] std::span<const uint8_t> bytes() const;
+
+	private:
+		friend class module_writer;
+
+		// parts of the file following the header, in file order
+		enum part : uint8_t
+		{
+			symbols_table,
+			sections_table,
+			sprites_table,
+			relocations_table,
+			names_blob,
+			code_blob,
+			parts_count
+		};
+
+		void validate(const std::filesystem::path& path);
+
+		[[nodiscard]] std::span<const uint8_t> record(part table, size_t index) const;
+
+	private:
+		mapped_file file;
+
+		// records count of the tables, bytes count of the names and the code
+		std::array<uint32_t, parts_count> sizes {};
+
+		// offset of each part in the file
+		std::array<size_t, parts_count> offsets {};
+	};
+
+
+	//
+	// Builds the content of a precompiled module, tables are written in the order records are added
+	//
+	class module_writer
+	{
+	public:
+		uint32_t add_symbol(precompiled_module::symbol_kind kind, std::string_view name, uint32_t value);
+		uint32_t add_section(std::span<const uint8_t> code);
+		uint32_t add_sprite(const arch::sprite& sprite);
+		void add_relocation(const precompiled_module::relocation& relocation);
+
+		[[nodiscard]] std::vector<uint8_t> bytes() const;
+
+	private:
+		using part = precompiled_module::part;
+
+		// content of each part, records are already encoded
+		std::array<std::vector<uint8_t>, part::parts_count> parts;
+		std::array<uint32_t, part::parts_count> sizes {};
+	};
+
+
+	namespace module_exception
+	{
+		struct invalid_module : chasm_exception
+		{
+			invalid_module(const std::filesystem::path& path, std::string_view reason)
+				: chasm_exception("File \"{}\" is not a valid precompiled module: {}.", path.string(), reason)
+			{}
+		};
+
+		struct invalid_module_content : chasm_exception
+		{
+			explicit invalid_module_content(std::string_view reason)
+				: chasm_exception("Source cannot be compiled to a module: {}.", reason)
+			{}
+		};
+	}
+}
+
+
+#endif //CHASM_PRECOMPILED_MODULE_HPP
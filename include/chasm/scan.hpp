@@ -0,0 +1,43 @@
+#ifndef CHASM_SCAN_HPP
+#define CHASM_SCAN_HPP
+
+
+#include <string_view>
+#include <cstddef>
+
+
+//
+// Scanning kernels used by the lexer to skip over runs of characters.
+// They process 32 bytes at a time when built with AVX2, 16 bytes with SSE2,
+// and fall back to a scalar loop on other targets.
+//
+namespace chasm::scan
+{
+	//
+	// Length of the [ \t\n\v\f\r] run at the beginning of text
+	//
+	[[nodiscard]] size_t whitespace_run(std::string_view text);
+
+	//
+	// Length of the [A-Za-z0-9_] run at the beginning of text
+	//
+	[[nodiscard]] size_t identifier_run(std::string_view text);
+
+	//
+	// Offset of the first '\n' in text, or text.size() if there is none
+	//
+	[[nodiscard]] size_t line_end(std::string_view text);
+
+	//
+	// Number of '\n' in text
+	//
+	[[nodiscard]] size_t count_newlines(std::string_view text);
+
+	//
+	// Name of the kernels compiled in, "avx2", "sse2" or "scalar"
+	//
+	[[nodiscard]] std::string_view kernel_name();
+}
+
+
+#endif //CHASM_SCAN_HPP
@@ -0,0 +1,128 @@
+#ifndef CHASM_SERVER_HPP
+#define CHASM_SERVER_HPP
+
+
+#include <string_view>
+#include <filesystem>
+#include <iostream>
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+#include <chasm/chasm_exception.hpp>
+#include <chasm/include_cache.hpp>
+#include <chasm/json.hpp>
+
+
+namespace chasm
+{
+	//
+	// Long running assembler answering newline delimited JSON requests, one response line per request
+	// line. The process stays warm between requests: the mnemonic and encoding tables are built once
+	// and included files stay parsed in the include cache of the server until their content changes,
+	// or until they are the least recently used entries of a full cache.
+	//
+	//   {"id": 1, "method": "assemble", "source": ".main: cls", "file": "game.c8",
+	//    "options": {"relocate": 512, "super": false, "pad_sprites": false}}
+	//   -> {"id": 1, "ok": true, "assembled": true, "binary": "00E0", "report": {"file": ..., "diagnostics": [...]}, "log": []}
+	//
+	//   {"id": 2, "method": "disassemble", "bytes": "6005...", "load_address": 512}
+	//   -> {"id": 2, "ok": true, "instructions": [{"address", "opcode", "path_start", "procedure_start", "text"}]}
+	//
+	//   {"id": 3, "method": "stats"}     -> requests served so far, files and bytes held by the include cache
+	//                                       and files it evicted
+	//   {"id": 4, "method": "shutdown"}  -> answered, then the server stops
+	//
+	// Bytes are hexadecimal strings, includes are resolved relative to "file". A source with errors is
+	// answered with "assembled": false and its diagnostics in "report". A request that cannot be handled
+	// at all is answered with "ok": false and an "error" message, the server keeps running.
+	// Requests of different connections run concurrently.
+	//
+	struct server_limits
+	{
+		// longest request line of a connection, a longer one is answered with an error and the connection closed
+		size_t max_request_size = 16 * 1024 * 1024;
+
+		// connections served at once, one more is answered with an error and closed
+		size_t max_connections = 64;
+
+		// included files and modules kept parsed between requests
+		include_cache_limits cache { .max_entries = 1024, .max_bytes = 64 * 1024 * 1024 };
+	};
+
+
+	class server
+	{
+	public:
+		explicit server(const server_limits& serving_limits = {});
+		~server() = default;
+
+		server(const server&) = delete;
+		server(server&&) = delete;
+		server& operator=(const server&) = delete;
+		server& operator=(server&&) = delete;
+
+		// response to one request line, without the trailing newline
+		[[nodiscard]] std::string handle(std::string_view request);
+
+		// answers the lines of input until its end or a shutdown request
+		void serve(std::istream& input, std::ostream& output);
+
+		//
+		// Listens on a Unix domain socket created at socket_path, each connection is served on its own
+		// thread until a shutdown request. The socket file is removed once the server stops.
+		//
+		void serve_socket(const std::filesystem::path& socket_path);
+
+		[[nodiscard]] bool stopped() const;
+
+	private:
+		[[nodiscard]] std::string assemble(const json::value& request);
+		[[nodiscard]] std::string disassemble(const json::value& request);
+		[[nodiscard]] std::string stats() const;
+
+		void serve_connection(int client);
+
+	private:
+		server_limits limits;
+		include_cache includes;
+
+		std::atomic<bool> stop_requested {};
+		std::atomic<uint64_t> requests_count {};
+	};
+
+
+	namespace server_exception
+	{
+		struct invalid_request : chasm_exception
+		{
+			explicit invalid_request(std::string_view reason)
+				: chasm_exception("Invalid request: {}.", reason)
+			{}
+		};
+
+		struct request_too_large : chasm_exception
+		{
+			explicit request_too_large(size_t max_size)
+				: chasm_exception("Request line longer than {} bytes, the connection is closed.", max_size)
+			{}
+		};
+
+		struct too_many_connections : chasm_exception
+		{
+			explicit too_many_connections(size_t max_connections)
+				: chasm_exception("Already serving {} connections, try again later.", max_connections)
+			{}
+		};
+
+		struct socket_error : chasm_exception
+		{
+			socket_error(const std::filesystem::path& socket_path, std::string_view reason)
+				: chasm_exception("Socket \"{}\": {}.", socket_path.string(), reason)
+			{}
+		};
+	}
+}
+
+
+#endif //CHASM_SERVER_HPP
@@ -0,0 +1,50 @@
+#ifndef CHASM_SHA256_HPP
+#define CHASM_SHA256_HPP
+
+
+#include <string_view>
+#include <cstdint>
+#include <string>
+#include <array>
+#include <span>
+
+
+namespace chasm
+{
+	//
+	// SHA-256 (FIPS 180-4) of data given in any number of parts. The build cache keys outputs with it,
+	// unlike the FNV hash of the include cache a collision there would silently reuse a wrong ROM.
+	//
+	class sha256
+	{
+	public:
+		using digest = std::array<uint8_t, 32>;
+
+		sha256() = default;
+
+		void update(std::span<const uint8_t> data);
+		void update(std::string_view data);
+
+		// the hasher must not be updated afterwards
+		[[nodiscard]] digest finish();
+
+		[[nodiscard]] static digest hash(std::span<const uint8_t> data);
+		[[nodiscard]] static std::string to_hex(const digest& value);
+
+	private:
+		void compress(const uint8_t* block);
+
+	private:
+		std::array<uint32_t, 8> state {
+			0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+			0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+		};
+
+		std::array<uint8_t, 64> pending {};
+		size_t pending_size {};
+		uint64_t total_size {};
+	};
+}
+
+
+#endif //CHASM_SHA256_HPP
@@ -1,38 +1,34 @@
 #ifndef CHASM_SOURCE_LOCATION_HPP
 #define CHASM_SOURCE_LOCATION_HPP
 
+#include <cstdint>
 #include <string>
 #include <format>
 
 
 namespace chasm
 {
+	//
+	// Byte offset into a source buffer, this is all tokens carry. It is resolved
+	// to a line and column by chasm::stream::locate only when a location is displayed.
+	//
+	using source_offset = uint32_t;
+
 	struct source_location
 	{
 		size_t col  { 1 };
 		size_t line { 1 };
 
-		void next_line()
-		{
-			++line;
-			col = 1;
-		}
-
-		void advance()
-		{
-			++col;
-		}
-
-		void step_back(size_t steps = 1)
-		{
-			if (col >= steps)
-				col -= steps;
-		}
+		// path of the included file the location is in, empty in the assembled file itself
+		std::string file {};
 	};
 
 	[[nodiscard]]
 	inline std::string to_string(const source_location& source_loc)
 	{
+		if (!source_loc.file.empty())
+			return std::format("line {}, column {} of \"{}\"", source_loc.line, source_loc.col, source_loc.file);
+
 		return std::format("line {}, column {}", source_loc.line, source_loc.col);
 	}
 }
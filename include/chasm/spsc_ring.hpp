@@ -0,0 +1,121 @@
+#ifndef CHASM_SPSC_RING_HPP
+#define CHASM_SPSC_RING_HPP
+
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+namespace chasm
+{
+	//
+	// Bounded queue between exactly one producer thread and one consumer thread.
+	// Elements are handed over through the head and tail indexes without any lock,
+	// a side only sleeps (on an atomic wait) when the ring is full or empty.
+	//
+	template<typename T, size_t Capacity>
+	class spsc_ring
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "spsc_ring capacity must be a power of two");
+
+	public:
+		spsc_ring() = default;
+		~spsc_ring() = default;
+
+		spsc_ring(const spsc_ring&) = delete;
+		spsc_ring(spsc_ring&&) = delete;
+		spsc_ring& operator=(const spsc_ring&) = delete;
+		spsc_ring& operator=(spsc_ring&&) = delete;
+
+		//
+		// Blocks while the ring is full, returns false without pushing if the ring was closed
+		//
+		bool push(T&& value)
+		{
+			const auto tail = write_index.load(std::memory_order_relaxed);
+
+			while (!is_closed() && tail - read_index.load() == Capacity)
+				wait_event([&] { return is_closed() || tail - read_index.load() != Capacity; });
+
+			if (is_closed())
+				return false;
+
+			slots[tail & (Capacity - 1)] = std::move(value);
+			write_index.store(tail + 1);
+
+			signal();
+			return true;
+		}
+
+		//
+		// Blocks while the ring is empty, returns false once it is empty and closed
+		//
+		bool pop(T& value)
+		{
+			const auto head = read_index.load(std::memory_order_relaxed);
+
+			while (head == write_index.load() && !is_closed())
+				wait_event([&] { return head != write_index.load() || is_closed(); });
+
+			// elements pushed before the ring was closed are still handed over
+			if (head == write_index.load())
+				return false;
+
+			value = std::move(slots[head & (Capacity - 1)]);
+			read_index.store(head + 1);
+
+			signal();
+			return true;
+		}
+
+		//
+		// Wakes up both sides, either may close the ring to stop the other
+		//
+		void close()
+		{
+			closed.store(true);
+			signal();
+		}
+
+		[[nodiscard]] bool is_closed() const
+		{
+			return closed.load();
+		}
+
+	private:
+		void signal()
+		{
+			events.fetch_add(1);
+			events.notify_all();
+		}
+
+		template<typename Predicate>
+		void wait_event(Predicate ready)
+		{
+			//
+			// The event count is read before checking again, so a signal sent
+			// after that check changes the count and the wait returns right away
+			//
+			const auto seen = events.load();
+
+			if (!ready())
+				events.wait(seen);
+		}
+
+	private:
+		std::array<T, Capacity> slots {};
+
+		// producer and consumer indexes sit on their own cache lines
+		alignas(64) std::atomic<size_t> write_index {};
+		alignas(64) std::atomic<size_t> read_index {};
+
+		alignas(64) std::atomic<uint32_t> events {};
+		std::atomic<bool> closed {};
+	};
+}
+
+
+#endif //CHASM_SPSC_RING_HPP
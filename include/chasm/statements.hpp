@@ -1,266 +1,378 @@
 #ifndef CHASM_STATEMENTS_HPP
 #define CHASM_STATEMENTS_HPP
 
-#include <chasm/ast_visitor.hpp>
+#include <chasm/expression.hpp>
+#include <chasm/interner.hpp>
 #include <chasm/lexer.hpp>
+#include <initializer_list>
+#include <limits>
+#include <memory>
 #include <vector>
+#include <span>
 
 
-namespace chasm::ast
+namespace chasm
 {
-	enum class statement_priority
-	{
-		procedure = 0,
-		first
-	};
+	class precompiled_module;
+}
 
-    struct base_statement
-    {
-		base_statement() = default;
-		base_statement(const base_statement&) = delete;
-		base_statement(base_statement&&) = delete;
-		base_statement& operator=(const base_statement&) = delete;
-		base_statement& operator=(base_statement&&) = delete;
 
-		virtual ~base_statement() = default;
+namespace chasm::ast
+{
+	using node_id = uint32_t;
 
-		[[nodiscard]] virtual statement_priority priority() const { return statement_priority::first; }
+	constexpr node_id NO_NODE = std::numeric_limits<node_id>::max();
 
-		virtual void accept(base_visitor&) const = 0;
+	enum class node_kind : uint8_t
+	{
+		procedure,
+		label,
+		instruction,
+		define,
+		config,
+		sprite,
+		raw,
+		include,
+		module
 	};
 
-	using statement = std::unique_ptr<base_statement>;
-
-    struct procedure_statement : base_statement
-    {
-        procedure_statement(token name_beg_, token name_end_, std::vector<statement> inner_statements_)
-            : base_statement(),
-			  name_beg(std::move(name_beg_)),
-			  name_end(std::move(name_end_)),
-              inner_statements(std::move(inner_statements_))
-        {}
-
-		[[nodiscard]] statement_priority priority() const override { return statement_priority::procedure; }
-
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
-
-        const token name_beg;
-		const token name_end;
-
-		// raw, define, instructions and label statements
-        const std::vector<statement> inner_statements;
-    };
-
-    class instruction_operand
-    {
-		enum class type
+	//
+	// Operand resolved once by the parser, encoders only match its type against the
+	// operands mask of the instruction and read its value or its symbol
+	//
+	struct instruction_operand
+	{
+		// how the operand was written
+		enum class kind : uint8_t
 		{
 			immediate,
 			reg,
 			indirection,
 			label,
 			procedure,
-			sprite
+			sprite,
+			expression
 		};
 
-		explicit instruction_operand(token operand_, type t)
-				: operand(std::move(operand_)),
-				  type_(t)
-		{}
+		arch::operand_type type;
+		kind written_as;
+
+		// register index of registers, value of numerical operands
+		uint16_t value;
+
+		// interned name of identifier operands, NO_SYMBOL for registers, numerical operands and expressions
+		symbol_id symbol;
+
+		// index of the operand token in flat_nodes::tokens, for diagnostics
+		uint32_t token;
 
-	public:
-		static instruction_operand make_immediate(token operand_)
+		// terms of expressions in flat_nodes::terms, operands written as a single value have none
+		uint32_t first_term {};
+		uint32_t terms_count {};
+
+		[[nodiscard]] bool is_reg() const
 		{
-			return instruction_operand(std::move(operand_), type::immediate);
+			return written_as == kind::reg;
 		}
 
-		static instruction_operand make_reg(token operand_)
+		[[nodiscard]] bool has_indirection() const
 		{
-			return instruction_operand(std::move(operand_), type::reg);
+			return written_as == kind::indirection;
 		}
 
-		static instruction_operand make_label(token operand_)
+		[[nodiscard]] bool is_label() const
 		{
-			return instruction_operand(std::move(operand_), type::label);
+			return written_as == kind::label;
 		}
 
-		static instruction_operand make_proc(token operand_)
+		[[nodiscard]] bool is_procedure() const
 		{
-			return instruction_operand(std::move(operand_), type::procedure);
+			return written_as == kind::procedure;
 		}
 
-		static instruction_operand make_sprite(token operand_)
+		[[nodiscard]] bool is_sprite() const
 		{
-			return instruction_operand(std::move(operand_), type::sprite);
+			return written_as == kind::sprite;
 		}
 
-		static instruction_operand make_indirect(token operand_)
+		[[nodiscard]] bool is_expression() const
 		{
-			return instruction_operand(std::move(operand_), type::indirection);
+			return terms_count > 0;
 		}
+	};
+
+	static_assert(sizeof(instruction_operand) == 20);
 
-		instruction_operand(instruction_operand&& other) noexcept
-			: operand(std::move(other.operand)),
-			  type_(other.type_)
-		{}
+	//
+	// Instruction node as seen by the encoders, its operands are a view into the tree
+	//
+	struct instruction_view
+	{
+		token mnemonic;
+
+		// chip-8 instructions have 0 to 3 operands
+		std::span<const instruction_operand> operands;
 
-		instruction_operand& operator=(instruction_operand&& other) noexcept
+		// arch::operands_mask of the operand types, computed by the parser
+		uint16_t operands_mask;
+
+		[[nodiscard]] arch::instruction_id to_arch_id() const
 		{
-			operand = std::move(other.operand);
-			type_ = other.type_;
+			// resolved by the lexer when classifying the mnemonic
+			return static_cast<arch::instruction_id>(mnemonic.value);
+		}
+	};
+
+	//
+	// Statements of a program in struct-of-arrays layout and in source order, so passes over
+	// them stream through a few arrays instead of chasing pointers. Columns are indexed by node_id:
+	//
+	//   kinds       : what the statement is
+	//   first_token : its first token in tokens, define and config have their value token right after
+	//   first_child : with child_count, the range of its children:
+	//                   - procedures and labels: the nodes of their body, stored right after them,
+	//                     so the whole subtree (nested label bodies included) is contiguous
+	//                   - instructions: their operands in operands
+	//                   - sprites: their data in sprites
+	//                   - defines and raw statements: the terms of their value in terms
+	//                   - includes: none, the statements of the included file are spliced right after them
+	//                   - modules: the included module in modules, child_count is the count of symbols it exports
+	//   symbols     : interned name of the symbol it defines
+	//   operands_masks : arch::operands_mask of instructions, MASK_NONE for other statements
+	//
+	// A precompiled module is not made of nodes, the symbols it exports are interned
+	// like any other symbol and are listed in imports, in the order of the module.
+	//
+	struct imported_module
+	{
+		std::shared_ptr<const precompiled_module> file;
+		uint32_t first_import;
+	};
 
-			return *this;
+	struct flat_nodes
+	{
+		std::vector<node_kind> kinds;
+		std::vector<uint32_t>  first_token;
+		std::vector<uint32_t>  first_child;
+		std::vector<uint32_t>  child_count;
+		std::vector<symbol_id> symbols;
+		std::vector<uint16_t>  operands_masks;
+
+		std::vector<token> tokens;
+		std::vector<instruction_operand> operands;
+		std::vector<arch::sprite> sprites;
+		std::vector<expression_term> terms;
+		std::vector<imported_module> modules;
+		std::vector<symbol_id> imports;
+
+		[[nodiscard]] size_t size() const
+		{
+			return kinds.size();
 		}
 
-		[[nodiscard]] arch::operand_type arch_type() const
+		// appends a childless node
+		node_id append(node_kind kind, symbol_id symbol, std::initializer_list<token> node_tokens)
 		{
-			auto regname2optype = [](const auto& name) -> arch::operand_type
-			{
-				if (name == "ar") return arch::operand_type::reg_ar;
-				if (name == "st") return arch::operand_type::reg_st;
-				if (name == "dt") return arch::operand_type::reg_dt;
+			const auto id = static_cast<node_id>(kinds.size());
 
-				return arch::operand_type::reg_rx;
-			};
+			kinds.push_back(kind);
+			first_token.push_back(static_cast<uint32_t>(tokens.size()));
+			first_child.push_back(0);
+			child_count.push_back(0);
+			symbols.push_back(symbol);
+			operands_masks.push_back(arch::MASK_NONE);
 
-			if (is_reg())
-				return regname2optype(operand.to_string());
-			else if (has_indirection())
-				return arch::operand_type::address_indirect;
-			else if (is_label() || is_procedure() || is_sprite())
-				return arch::operand_type::address;
-			else
-				return arch::operand_type::immediate;
+			tokens.insert(tokens.end(), node_tokens);
+
+			return id;
 		}
 
-		[[nodiscard]] std::string reg_name() const
+		void set_children(node_id id, size_t first, size_t count)
 		{
-			return operand.to_string();
+			first_child[id] = static_cast<uint32_t>(first);
+			child_count[id] = static_cast<uint32_t>(count);
 		}
 
-		[[nodiscard]] bool is_reg() const
+		// the body of a procedure or a label is every node appended after it so far
+		void close_body(node_id id)
 		{
-			return type_ == type::reg;
+			set_children(id, id + 1, size() - id - 1);
 		}
 
-		[[nodiscard]] bool has_indirection() const
+		[[nodiscard]] const token& token_at(node_id id, size_t nth = 0) const
 		{
-			return type_ == type::indirection;
+			return tokens[first_token[id] + nth];
 		}
 
-		[[nodiscard]] bool is_label() const
+		// first node following the subtree of id
+		[[nodiscard]] node_id end_of(node_id id) const
 		{
-			return type_ == type::label;
+			if (kinds[id] == node_kind::procedure || kinds[id] == node_kind::label)
+				return first_child[id] + child_count[id];
+
+			return id + 1;
 		}
 
-		[[nodiscard]] bool is_procedure() const
+		[[nodiscard]] instruction_view instruction(node_id id) const
 		{
-			return type_ == type::procedure;
+			return {
+				.mnemonic = token_at(id),
+				.operands = std::span(operands).subspan(first_child[id], child_count[id]),
+				.operands_mask = operands_masks[id]
+			};
 		}
 
-		[[nodiscard]] bool is_sprite() const
+		[[nodiscard]] const token& token_of(const instruction_operand& operand) const
 		{
-			return type_ == type::sprite;
+			return tokens[operand.token];
 		}
 
-		token operand;
-
-	private:
-		type type_;
-    };
-
-    struct instruction_statement : base_statement
-    {
-		instruction_statement(token mnemonic_, std::vector<instruction_operand> operands_)
-			: base_statement(),
-			  mnemonic(std::move(mnemonic_)),
-			  operands(std::move(operands_))
-		{}
-
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
-
-		[[nodiscard]] arch::instruction_id to_arch_id() const
+		[[nodiscard]] const arch::sprite& sprite(node_id id) const
 		{
-			const auto m = mnemonic.to_string();
-			return arch::to_instruction_id(m);
+			return sprites[first_child[id]];
 		}
 
-    	const token mnemonic;
-
-		// chip-8 instructions have 0 to 3 operands
-		const std::vector<instruction_operand> operands;
-    };
-
-    struct define_statement : base_statement
-    {
-        define_statement(token identifier_, token value_)
-            : base_statement(),
-			  identifier(std::move(identifier_)),
-			  value(std::move(value_))
-        {}
-
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
-
-        const token identifier;
-        const token value;
-    };
+		// value of a define or a raw statement
+		[[nodiscard]] std::span<const expression_term> expression(node_id id) const
+		{
+			return std::span(terms).subspan(first_child[id], child_count[id]);
+		}
 
-	struct sprite_statement : base_statement
-	{
-		sprite_statement(token identifier_, const arch::sprite& sprite_)
-			: base_statement(),
-			  identifier(std::move(identifier_)),
-			  sprite(sprite_)
-		{}
+		[[nodiscard]] std::span<const expression_term> terms_of(const instruction_operand& operand) const
+		{
+			return std::span(terms).subspan(operand.first_term, operand.terms_count);
+		}
 
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
+		[[nodiscard]] const imported_module& module(node_id id) const
+		{
+			return modules[first_child[id]];
+		}
 
-		const token identifier;
-		const arch::sprite sprite;
-	};
+		// symbol ids of the symbols exported by a module, indexed like the symbols of the module
+		[[nodiscard]] std::span<const symbol_id> imports_of(node_id id) const
+		{
+			return std::span(imports).subspan(module(id).first_import, child_count[id]);
+		}
 
-	struct config_statement : base_statement
-	{
-		config_statement(token identifier_, token value_)
-			: base_statement(),
-			  identifier(std::move(identifier_)),
-			  value(std::move(value_))
-		{}
+		[[nodiscard]] const token& token_of(const expression_term& term) const
+		{
+			return tokens[term.token];
+		}
 
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
+		//
+		// Appends the nodes of another tree after the ones of this tree. Symbols of other are renamed
+		// through symbol_map, indexed by their symbol_id, and token offsets are moved by offset_base.
+		//
+		void splice(const flat_nodes& other, std::span<const symbol_id> symbol_map, source_offset offset_base)
+		{
+			const auto node_base    = static_cast<uint32_t>(size());
+			const auto token_base   = static_cast<uint32_t>(tokens.size());
+			const auto operand_base = static_cast<uint32_t>(operands.size());
+			const auto sprite_base  = static_cast<uint32_t>(sprites.size());
+			const auto term_base    = static_cast<uint32_t>(terms.size());
+			const auto module_base  = static_cast<uint32_t>(modules.size());
+			const auto import_base  = static_cast<uint32_t>(imports.size());
+
+			const auto rename = [&](symbol_id symbol)
+			{
+				return symbol == NO_SYMBOL ? NO_SYMBOL : symbol_map[symbol];
+			};
 
-		const token identifier;
-		const token value;
-	};
+			for (node_id id = 0; id < other.size(); ++id)
+			{
+				const auto child_base = [&]() -> uint32_t
+				{
+					switch (other.kinds[id])
+					{
+						case node_kind::procedure:
+						case node_kind::label:       return node_base;
+						case node_kind::instruction: return operand_base;
+						case node_kind::sprite:      return sprite_base;
+						case node_kind::define:
+						case node_kind::raw:         return term_base;
+						case node_kind::module:      return module_base;
+
+						default:
+							return 0;
+					}
+				}();
+
+				kinds.push_back(other.kinds[id]);
+				first_token.push_back(other.first_token[id] + token_base);
+				first_child.push_back(other.first_child[id] + child_base);
+				child_count.push_back(other.child_count[id]);
+				symbols.push_back(rename(other.symbols[id]));
+				operands_masks.push_back(other.operands_masks[id]);
+			}
+
+			for (auto token : other.tokens)
+			{
+				token.offset += offset_base;
+				tokens.push_back(token);
+			}
 
-    struct raw_statement : base_statement
-    {
-		explicit raw_statement(token opcode_)
-			: base_statement(),
-			  opcode(std::move(opcode_))
-		{}
+			for (auto operand : other.operands)
+			{
+				operand.symbol = rename(operand.symbol);
+				operand.token += token_base;
+				operand.first_term += term_base;
+				operands.push_back(operand);
+			}
 
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
+			for (auto term : other.terms)
+			{
+				term.symbol = rename(term.symbol);
+				term.token += token_base;
+				terms.push_back(term);
+			}
 
-		[[nodiscard]] size_t source_line() const {  return opcode.source_location.line; }
+			for (auto imported : other.modules)
+			{
+				imported.first_import += import_base;
+				modules.push_back(std::move(imported));
+			}
 
-        const token opcode;
-    };
+			for (const auto symbol : other.imports)
+				imports.push_back(rename(symbol));
 
-	struct label_statement : base_statement
-	{
-		explicit label_statement(token identifier_, std::vector<statement> inner_statements_)
-			: base_statement(),
-			  identifier(std::move(identifier_)),
-			  inner_statements(std::move(inner_statements_))
-		{}
+			sprites.insert(sprites.end(), other.sprites.begin(), other.sprites.end());
+		}
 
-		void accept(base_visitor& visitor) const override { return visitor.visit(*this); }
+		//
+		// Sizes of the columns and pools, rolling back to it drops every node appended since
+		//
+		struct checkpoint
+		{
+			size_t nodes;
+			size_t tokens;
+			size_t operands;
+			size_t sprites;
+			size_t terms;
+			size_t modules;
+			size_t imports;
+		};
 
-		const token identifier;
+		[[nodiscard]] checkpoint mark() const
+		{
+			return { size(), tokens.size(), operands.size(), sprites.size(), terms.size(), modules.size(), imports.size() };
+		}
 
-		// raw, define, and instructions statements
-		const std::vector<statement> inner_statements;
+		void rollback(const checkpoint& to)
+		{
+			kinds.resize(to.nodes);
+			first_token.resize(to.nodes);
+			first_child.resize(to.nodes);
+			child_count.resize(to.nodes);
+			symbols.resize(to.nodes);
+			operands_masks.resize(to.nodes);
+
+			tokens.resize(to.tokens);
+			operands.resize(to.operands);
+			sprites.resize(to.sprites);
+			terms.resize(to.terms);
+			modules.resize(to.modules);
+			imports.resize(to.imports);
+		}
 	};
 }
 
@@ -3,25 +3,88 @@
 
 
 #include <string_view>
-#include <filesystem>
-#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <span>
+
+#include <chasm/source_location.hpp>
 
 
 namespace chasm
 {
+	//
+	// Either owns its source text or reads through a view of a buffer owned by someone else
+	// (e.g. a chasm::mapped_file), in which case that buffer must outlive the stream.
+	// A stream can be restricted to the [begin, end) range of the buffer, positions
+	// and locations are still relative to the whole buffer.
+	//
+	// Streams of included files are attached after the buffer in a single offset space,
+	// so tokens spliced from an included file are located through the stream including it.
+	//
     class stream
     {
     public:
         explicit stream(std::string&& src_stream);
+		explicit stream(std::span<const char> src_view);
+		stream(std::span<const char> src_view, size_t range_begin, size_t range_end);
+
+		stream(const stream&) = delete;
+		stream(stream&&) = delete;
+		stream& operator=(const stream&) = delete;
+		stream& operator=(stream&&) = delete;
 
         [[nodiscard]] bool eof() const;
 		[[nodiscard]] char peek() const;
         char get();
         void unget();
 
+		[[nodiscard]] std::string_view pending() const;
+		void skip(size_t count);
+
+		[[nodiscard]] size_t position() const;
+		[[nodiscard]] std::string_view slice(size_t begin) const;
+		[[nodiscard]] std::string_view text() const;
+
+		//
+		// Resolves a byte offset to its line and column, the line-start index
+		// is only built the first time a location is requested
+		//
+		[[nodiscard]] source_location locate(size_t offset) const;
+
+		//
+		// Offsets of included are located from the returned base offset on, included must not be
+		// attached anything else afterwards. Thread-safe with respect to locate().
+		//
+		source_offset attach(std::shared_ptr<const stream> included, std::string path);
+
+		// size of the offset space, the buffer and the attached streams
+		[[nodiscard]] size_t extent() const;
+
+    private:
+		void index_lines() const;
+
+		struct attached_stream
+		{
+			source_offset base;
+			std::shared_ptr<const stream> included;
+			std::string path;
+		};
+
     private:
-        std::string buffer;
+        std::string owned;
+        std::string_view buffer;
         size_t read {};
+        size_t end {};
+
+		mutable std::once_flag lines_indexed;
+		mutable std::vector<source_offset> line_starts;
+
+		// offset past the eof offset of the buffer, where the next stream is attached
+		size_t attached_end {};
+		std::vector<attached_stream> attached;
+		mutable std::mutex attached_guard;
     };
 }
 
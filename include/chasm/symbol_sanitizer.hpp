@@ -2,66 +2,154 @@
 #define CHASM_SYMBOL_SANITIZER_HPP
 
 
-#include <unordered_map>
 #include <stdexcept>
+#include <limits>
 #include <format>
 #include <string>
+#include <vector>
+#include <span>
 #include <array>
 
 #include <chasm/chasm_exception.hpp>
 #include <chasm/source_location.hpp>
-#include <chasm/ast_visitor.hpp>
+#include <chasm/diagnostics.hpp>
 #include <chasm/ast.hpp>
 
 
 namespace chasm
 {
-	using symbol_set = std::unordered_map<std::string, source_location>;
+	//
+	// Symbol referenced by name in an error message
+	//
+	struct symbol_reference
+	{
+		std::string_view name;
+		source_location location;
+	};
 
 
-	class symbol_sanitizer final : public ast::base_visitor
+	//
+	// Checks nodes one by one in source order, the scope of a procedure or a label
+	// is closed once the check leaves its body. Driven by the generator, which checks
+	// each node right before emitting it so both run in the same traversal.
+	// Nodes may come by fragments of complete top level statements.
+	//
+	// Without a sink the first error is thrown. With a sink errors are reported to it and the
+	// check goes on without throwing, the definitions with an error are dropped.
+	//
+	class symbol_sanitizer final
 	{
 		using scope_id = unsigned char;
 
 	public:
-		symbol_sanitizer() = default;
+		symbol_sanitizer(const interner& symbols, const stream& source, diagnostics* sink = nullptr);
 		symbol_sanitizer(const symbol_sanitizer&) = delete;
 		symbol_sanitizer(symbol_sanitizer&&) = delete;
 		symbol_sanitizer& operator=(const symbol_sanitizer&) = delete;
 		symbol_sanitizer& operator=(symbol_sanitizer&&) = delete;
 		~symbol_sanitizer() = default;
 
-		void traverse(const ast::abstract_tree&);
+		// fragments must be entered in source order, symbols may keep being interned in between
+		void enter_fragment(const ast::flat_nodes& fragment);
+		void leave_fragment();
 
-		void visit(const ast::procedure_statement&) override;
-		void visit(const ast::instruction_statement&) override;
-		void visit(const ast::define_statement&) override;
-		void visit(const ast::sprite_statement&) override;
-		void visit(const ast::raw_statement&) override;
-		void visit(const ast::label_statement&) override;
+		// nodes of the current fragment must be checked in increasing order,
+		// returns false if the node has an error and must not be emitted
+		[[nodiscard]] bool check(ast::node_id id);
+
+		//
+		// Checks what can only be checked once every fragment was seen,
+		// a module has no entry point but must not refer to undefined symbols either
+		//
+		void finish(bool require_entry_point = true);
 
 
 	private:
-		void post_visit();
-		void push_scope();
-		void pop_scope();
-		void register_symbol(std::string&& symbol, const source_location& sym_loc);
-		bool symbol_defined(const std::string& symbol);
-		bool scope_has_symbol(scope_id scope, const std::string& symbol);
+		//
+		// Symbols referenced before their definition, indexed by symbol id
+		// with the offset of their first reference
+		//
+		class forward_references
+		{
+		public:
+			// new symbols are not referenced yet, previous references are kept
+			void resize(size_t symbols_count);
+			void add(symbol_id symbol, source_offset where);
+			void remove(symbol_id symbol);
+			void clear();
+
+			[[nodiscard]] bool empty() const;
+			[[nodiscard]] std::vector<symbol_reference> list(const interner& symbols, const stream& source) const;
+
+		private:
+			static constexpr source_offset NOT_REFERENCED = std::numeric_limits<source_offset>::max();
+
+			std::vector<source_offset> first_reference;
+			size_t count = 0;
+		};
+
+		[[nodiscard]] bool check_procedure(ast::node_id id);
+		[[nodiscard]] bool check_label(ast::node_id id);
+		[[nodiscard]] bool check_instruction(ast::node_id id);
+		[[nodiscard]] bool check_define(ast::node_id id);
+		[[nodiscard]] bool check_sprite(ast::node_id id);
+		[[nodiscard]] bool check_raw(ast::node_id id);
+		[[nodiscard]] bool check_module(ast::node_id id);
+
+		//
+		// Labels and procedures may be referenced before their definition,
+		// any other symbol must be defined before the statement using it
+		//
+		[[nodiscard]] bool check_reference(symbol_id symbol, ast::expression_term::kind what,
+										   const token& reference, const token& statement);
+		[[nodiscard]] bool check_terms(std::span<const ast::expression_term> terms, const token& statement);
+
+		// throws error, or reports it to the sink and returns false
+		template<typename Error>
+		bool reject(Error&& error, std::optional<source_location> where);
+
+		void grow_symbol_tables();
+		[[nodiscard]] source_location locate(const token& token) const;
+		// scope level of the body of the procedure being checked, 0 outside of procedures
+		[[nodiscard]] scope_id procedure_level() const;
+		[[nodiscard]] bool inside_procedure() const;
+		void push_scope(ast::node_id body_owner);
+		void pop_scopes(ast::node_id reached);
+		[[nodiscard]] bool register_symbol(symbol_id symbol, const token& sym_token);
+		[[nodiscard]] bool symbol_defined(symbol_id symbol) const;
 
 	private:
 
 		static constexpr unsigned char SCOPES_LEVEL = 3u;
-		std::array<symbol_set, SCOPES_LEVEL> scopes;
+		static constexpr scope_id UNDEFINED = std::numeric_limits<scope_id>::max();
+
+		// scope level each symbol is defined at, symbols are forgotten when their scope is popped
+		std::vector<scope_id> definition_scope;
+		std::array<std::vector<symbol_id>, SCOPES_LEVEL> scopes;
 		scope_id curr_scope_level = 0;
-		symbol_set undefined_labels;
-		symbol_set undefined_procs;
+
+		// procedure or label owning each opened scope, scopes_owners[0] is unused
+		std::array<ast::node_id, SCOPES_LEVEL> scopes_owners {};
+
+		//
+		// Labels of a procedure are local to it: a reference from its body is only resolved by a label of the
+		// same procedure, a reference from the top level only by a label outside of every procedure
+		//
+		forward_references undefined_labels;
+		forward_references undefined_global_labels;
+		forward_references undefined_procs;
+
+		const interner* names;
+		const stream* source;
+		const ast::flat_nodes* nodes {};
+
+		diagnostics* sink;
 	};
 
 
 	namespace sanitize_exception
 	{
-		inline std::string symbols_to_string(const symbol_set& symbols)
+		inline std::string symbols_to_string(const std::vector<symbol_reference>& symbols)
 		{
 			std::string joined;
 
@@ -73,14 +161,14 @@ namespace chasm
 
 		struct undefined_symbols : chasm_exception
 		{
-			explicit undefined_symbols(const std::string& symbol, const source_location& where)
+			explicit undefined_symbols(std::string_view symbol, const source_location& where)
 				: chasm_exception(
 						"Sanitizer found an undefined symbol: \"{}\" at {}.",
 						symbol,
 						chasm::to_string(where))
 			{}
 
-			explicit undefined_symbols(const symbol_set& symbols)
+			explicit undefined_symbols(const std::vector<symbol_reference>& symbols)
 				: chasm_exception(
 					"Sanitizer found the following undefined symbols:\n{}",
 					symbols_to_string(symbols))
@@ -89,7 +177,7 @@ namespace chasm
 
 		struct already_defined_symbol : chasm_exception
 		{
-			already_defined_symbol(const std::string& symbol, const source_location& where)
+			already_defined_symbol(std::string_view symbol, const source_location& where)
 				: chasm_exception(
 					"Sanitizer found an already defined symbol \"{}\" at {}.",
 					symbol,
@@ -0,0 +1,18 @@
+#ifndef CHASM_VERSION_HPP
+#define CHASM_VERSION_HPP
+
+
+#include <string_view>
+
+
+namespace chasm
+{
+	//
+	// Version of the assembler. Cached builds are keyed by it together with the encoding revision of
+	// the generator and the hash of the sources generated by the build, so it need not be bumped for them.
+	//
+	constexpr std::string_view VERSION = "0.9.0";
+}
+
+
+#endif //CHASM_VERSION_HPP
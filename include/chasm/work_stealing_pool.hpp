@@ -0,0 +1,56 @@
+#ifndef CHASM_WORK_STEALING_POOL_HPP
+#define CHASM_WORK_STEALING_POOL_HPP
+
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+
+namespace chasm
+{
+	//
+	// Runs a batch of independent tasks on a fixed number of workers. Each worker starts with its own
+	// contiguous share of the tasks and takes them from the front of its queue, a worker whose queue is
+	// empty steals from the back of the queue of another one. Tasks of very different costs (a ROM of
+	// a few bytes next to one including half a library) keep every worker busy until the end.
+	//
+	class work_stealing_pool
+	{
+	public:
+		// 0 uses every core
+		explicit work_stealing_pool(unsigned int workers = 0);
+		~work_stealing_pool() = default;
+
+		work_stealing_pool(const work_stealing_pool&) = delete;
+		work_stealing_pool(work_stealing_pool&&) = delete;
+		work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+		work_stealing_pool& operator=(work_stealing_pool&&) = delete;
+
+		[[nodiscard]] unsigned int size() const;
+
+		//
+		// Calls task(i) once for each i in [0, tasks_count) and returns once every call returned.
+		// If calls throw, the remaining tasks still run and the first exception is rethrown.
+		//
+		void run(size_t tasks_count, const std::function<void(size_t)>& task);
+
+	private:
+		struct worker_queue
+		{
+			std::mutex guard;
+			std::deque<size_t> tasks;
+		};
+
+		[[nodiscard]] bool pop(size_t worker, size_t& task);
+		[[nodiscard]] bool steal(size_t thief, size_t& task);
+
+	private:
+		std::vector<std::unique_ptr<worker_queue>> queues;
+	};
+}
+
+
+#endif //CHASM_WORK_STEALING_POOL_HPP
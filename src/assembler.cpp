@@ -0,0 +1,88 @@
+#include <thread>
+
+#include <chasm/assembler.hpp>
+#include <chasm/pipeline.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		void resolve_includes(parser& parse, const std::filesystem::path& source_file, const assembler_options& options)
+		{
+			auto chain = source_file.empty() ? std::vector<std::filesystem::path>() : std::vector { source_file };
+
+			parse.resolve_includes(std::move(chain), options.includes);
+		}
+
+		void add_dependencies(const parser& parse, std::vector<std::filesystem::path>* dependencies)
+		{
+			if (dependencies)
+				dependencies->insert(dependencies->end(), parse.dependencies().begin(), parse.dependencies().end());
+		}
+	}
+
+	std::vector<uint8_t> assemble(std::string_view source,
+								  const assembler_options& options,
+								  const std::filesystem::path& source_file,
+								  std::vector<std::filesystem::path>* dependencies)
+	{
+		const auto text = std::span(source.data(), source.size());
+
+		if (options.pipeline)
+			return assemble_pipelined(text, options, source_file, dependencies).value_or(std::vector<uint8_t>());
+
+		auto lex = lexer(text);
+
+		if (options.jobs != 1)
+			lex.lex_ahead(options.jobs == 0 ? std::thread::hardware_concurrency() : options.jobs);
+
+		auto parse = parser(lex);
+		resolve_includes(parse, source_file, options);
+
+		const auto tree = parse.make_tree();
+		add_dependencies(parse, dependencies);
+
+		if (tree.nodes().size() == 0)
+			return {};
+
+		return tree.generate(options);
+	}
+
+	diagnosed<std::vector<uint8_t>> assemble(std::string_view source,
+											 diagnostics& sink,
+											 const assembler_options& options,
+											 const std::filesystem::path& source_file,
+											 std::vector<std::filesystem::path>* dependencies)
+	{
+		auto lex = lexer(std::span(source.data(), source.size()));
+		auto parse = parser(lex, sink);
+		resolve_includes(parse, source_file, options);
+
+		const auto tree = parse.make_tree();
+		add_dependencies(parse, dependencies);
+
+		// statements with an error were dropped, the source may have none left because of them
+		if (tree.nodes().size() == 0 && !sink.has_errors())
+			return std::vector<uint8_t>();
+
+		return tree.generate(sink, options);
+	}
+
+	std::vector<uint8_t> compile_module(std::string_view source,
+										const assembler_options& options,
+										const std::filesystem::path& source_file,
+										std::vector<std::filesystem::path>* dependencies)
+	{
+		auto lex = lexer(std::span(source.data(), source.size()));
+		auto parse = parser(lex);
+		resolve_includes(parse, source_file, options);
+
+		const auto tree = parse.make_tree();
+		add_dependencies(parse, dependencies);
+
+		return tree.compile_module(options);
+	}
+}
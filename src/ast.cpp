@@ -1,38 +1,72 @@
 #include <chasm/ast.hpp>
-#include <chasm/symbol_sanitizer.hpp>
 #include <chasm/generator.hpp>
 
 
 namespace chasm::ast
 {
-	abstract_tree::abstract_tree(std::vector<ast::statement> &&branches)
-		: statements(std::move(branches))
+	abstract_tree::abstract_tree(flat_nodes&& nodes, interner&& symbols, const stream& source)
+		: statements(std::move(nodes)),
+		  symbol_names(std::move(symbols)),
+		  source_stream(&source)
 	{}
 
-	std::vector<uint8_t> abstract_tree::generate()
+	std::vector<uint8_t> abstract_tree::generate(const assembler_options& options) const
 	{
-		sanitize();
+		generator generator(symbol_names, *source_stream, options);
+		generator.generate(statements);
 
-		std::ranges::stable_sort(statements, [](const ast::statement& a,
-												const ast::statement& b)
-		{
-			return a->priority() > b->priority();
-		});
+		return generator.link();
+	}
+
+	diagnosed<std::vector<uint8_t>> abstract_tree::generate(diagnostics& sink, const assembler_options& options) const
+	{
+		generator generator(symbol_names, *source_stream, options, &sink);
+		generator.generate(statements);
 
-		generator generator;
+		auto binary = generator.link();
 
-		return generator.generate(*this);
+		// errors of the parsing stage count too
+		if (sink.has_errors())
+			return std::unexpected(reported_errors { sink.error_count() });
+
+		return binary;
 	}
 
-	void abstract_tree::sanitize() const
+	std::vector<uint8_t> abstract_tree::compile_module(const assembler_options& options) const
 	{
-		symbol_sanitizer sanitizer;
+		generator generator(symbol_names, *source_stream, options);
+		generator.generate(statements);
 
-		sanitizer.traverse(*this);
+		return generator.export_module();
 	}
 
-	const std::vector<ast::statement>& abstract_tree::branches() const
+	const flat_nodes& abstract_tree::nodes() const
 	{
 		return statements;
 	}
+
+	std::vector<node_id> abstract_tree::branches() const
+	{
+		std::vector<node_id> top_level;
+
+		for (node_id id = 0; id < statements.size(); id = statements.end_of(id))
+			top_level.push_back(id);
+
+		return top_level;
+	}
+
+	const interner& abstract_tree::symbols() const
+	{
+		return symbol_names;
+	}
+
+	const stream& abstract_tree::source() const
+	{
+		return *source_stream;
+	}
+
+	source_location abstract_tree::locate(const token& token) const
+	{
+		return source_stream->locate(token.offset);
+	}
 }
@@ -0,0 +1,194 @@
+#include <exception>
+#include <optional>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <chasm/work_stealing_pool.hpp>
+#include <chasm/include_cache.hpp>
+#include <chasm/build_cache.hpp>
+#include <chasm/mapped_file.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/depfile.hpp>
+#include <chasm/batch.hpp>
+#include <chasm/log.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		void write_bytes(const std::filesystem::path& file, const std::vector<uint8_t>& bytes)
+		{
+			std::ofstream os(file, std::ios::binary);
+
+			if (!os)
+				throw chasm_exception("Could not open file \"{}\" for writing.", file.string());
+
+			os.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		}
+
+		//
+		// Binary of a program, nothing if it has errors or no statement
+		//
+		std::optional<std::vector<uint8_t>> assemble_program(std::string_view source,
+															 const batch_entry& entry,
+															 const batch_options& options,
+															 batch_result& result,
+															 std::vector<std::filesystem::path>& dependencies)
+		{
+			auto binary = assemble(source, result.report, options.assembler, entry.source, &dependencies);
+
+			if (!binary)
+				return std::nullopt;
+
+			if (binary->empty())
+			{
+				result.report.warning("No input to be read, nothing was written.");
+				return std::nullopt;
+			}
+
+			return std::move(*binary);
+		}
+
+		//
+		// A build restored from the cache has no diagnostics, its warnings are kept with its log instead
+		//
+		std::vector<std::string> cached_log(const batch_result& result)
+		{
+			auto lines = result.log;
+
+			for (const auto& [level, message, location] : result.report.entries())
+				lines.push_back("[WARN] " + message);
+
+			return lines;
+		}
+
+		//
+		// Fills result, nothing thrown while assembling the file escapes it
+		//
+		void assemble_entry(const batch_entry& entry, const batch_options& options, batch_result& result)
+		{
+			const log::capture capture(result.log);
+
+			try
+			{
+				const auto file = mapped_file(entry.source);
+				const auto source = std::string_view(file.text().data(), file.text().size());
+
+				std::vector<std::filesystem::path> dependencies;
+
+				if (options.modules)
+					write_bytes(entry.output, compile_module(source, options.assembler, entry.source, &dependencies));
+				else
+				{
+					const auto key = options.cache ? std::optional(build_cache::make_key(source, entry.source, options.assembler)) : std::nullopt;
+					auto cached = key ? options.cache->fetch(*key, entry.output, {}) : std::nullopt;
+
+					if (cached)
+					{
+						result.log = std::move(cached->log);
+						dependencies = std::move(cached->dependencies);
+					}
+					else
+					{
+						const auto binary = assemble_program(source, entry, options, result, dependencies);
+
+						if (!binary)
+							return;
+
+						write_bytes(entry.output, *binary);
+
+						if (key)
+							options.cache->store(*key, dependencies, entry.output, {}, cached_log(result));
+					}
+				}
+
+				if (options.depfiles)
+				{
+					std::vector<std::filesystem::path> inputs { entry.source };
+					inputs.insert(inputs.end(), dependencies.begin(), dependencies.end());
+
+					write_depfile(entry.output, inputs);
+				}
+
+				result.success = true;
+			}
+			catch (const std::exception& error)
+			{
+				result.report.error(error.what());
+			}
+		}
+	}
+
+	std::filesystem::path default_output(const std::filesystem::path& source, std::string_view extension)
+	{
+		return std::filesystem::path(source).replace_extension(extension);
+	}
+
+	std::vector<batch_entry> read_manifest(const std::filesystem::path& manifest, std::string_view output_extension)
+	{
+		std::ifstream is(manifest);
+
+		if (!is)
+			throw chasm_exception("Could not open batch manifest \"{}\".", manifest.string());
+
+		const auto directory = manifest.parent_path();
+
+		std::vector<batch_entry> entries;
+		std::string line;
+
+		for (size_t number = 1; std::getline(is, line); ++number)
+		{
+			std::istringstream fields(line);
+			std::string source;
+			std::string output;
+
+			if (!(fields >> std::quoted(source)) || source.starts_with('#'))
+				continue;
+
+			if (std::string extra; fields >> std::quoted(output) >> extra)
+				throw batch_exception::invalid_manifest(manifest, number, "expected a source then an optional output");
+
+			const auto source_path = directory / source;
+
+			entries.push_back({
+				.source = source_path,
+				.output = output.empty() ? default_output(source_path, output_extension) : directory / output
+			});
+		}
+
+		return entries;
+	}
+
+	std::vector<batch_result> assemble_batch(std::span<const batch_entry> entries, const batch_options& options)
+	{
+		std::vector<batch_result> results(entries.size());
+
+		//
+		// Files are the unit of work, lexing a single file on several threads would only compete with the pool
+		//
+		batch_options file_options = options;
+		file_options.assembler.jobs = 1;
+		file_options.assembler.pipeline = false;
+		file_options.assembler.symbols_file.clear();
+
+		// files included by several entries are parsed once for the whole batch
+		include_cache batch_includes;
+
+		if (!file_options.assembler.includes)
+			file_options.assembler.includes = &batch_includes;
+
+		auto pool = work_stealing_pool(options.workers);
+
+		pool.run(entries.size(), [&](size_t i)
+		{
+			results[i].source = entries[i].source;
+			results[i].output = entries[i].output;
+
+			assemble_entry(entries[i], file_options, results[i]);
+		});
+
+		return results;
+	}
+}
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <random>
+#include <format>
+#include <map>
+
+#include <chasm/build_cache.hpp>
+#include <chasm/mapped_file.hpp>
+#include <chasm/generator.hpp>
+#include <chasm/version.hpp>
+
+//
+// Hash of the library sources generated by the CMake build, see cmake/SourcesHash.cmake.
+// Builds without it only tell assemblers apart by their version and encoding revision.
+//
+#if __has_include(<chasm/build_id.hpp>)
+	#include <chasm/build_id.hpp>
+#else
+	#define CHASM_BUILD_ID ""
+#endif
+
+
+namespace chasm
+{
+	namespace
+	{
+		// objects are removed until they take this much of the size limit, so that not every store evicts
+		constexpr uint64_t EVICTION_TARGET_PERCENT = 90;
+
+		[[nodiscard]]
+		std::optional<sha256::digest> hash_file(const std::filesystem::path& path)
+		{
+			if (!std::filesystem::is_regular_file(path))
+				return std::nullopt;
+
+			const auto file = mapped_file(path);
+
+			return sha256::hash(file.bytes());
+		}
+
+		[[nodiscard]]
+		std::filesystem::path temporary_path(const std::filesystem::path& path)
+		{
+			//
+			// Unique among the threads and the processes writing to the same directory
+			//
+			static const auto process_tag = std::random_device()();
+			static std::atomic<uint64_t> counter = 0;
+
+			return std::filesystem::path(path).concat(std::format(".{:08x}.{}.tmp", process_tag, counter++));
+		}
+
+		void write_atomically(const std::filesystem::path& path, std::string_view content)
+		{
+			const auto temporary = temporary_path(path);
+
+			{
+				std::ofstream os(temporary, std::ios::binary);
+				os.write(content.data(), static_cast<std::streamsize>(content.size()));
+			}
+
+			std::filesystem::rename(temporary, path);
+		}
+
+		void copy_atomically(const std::filesystem::path& from, const std::filesystem::path& to)
+		{
+			const auto temporary = temporary_path(to);
+
+			try
+			{
+				std::filesystem::copy_file(from, temporary, std::filesystem::copy_options::overwrite_existing);
+				std::filesystem::rename(temporary, to);
+			}
+			catch (const std::filesystem::filesystem_error&)
+			{
+				std::error_code ignored;
+				std::filesystem::remove(temporary, ignored);
+
+				throw;
+			}
+		}
+
+		[[nodiscard]]
+		std::vector<std::string> read_lines(const std::filesystem::path& path)
+		{
+			std::ifstream is(path);
+			std::vector<std::string> lines;
+
+			for (std::string line; std::getline(is, line);)
+				lines.push_back(std::move(line));
+
+			return lines;
+		}
+
+		[[nodiscard]]
+		std::string join_lines(std::span<const std::string> lines)
+		{
+			std::string joined;
+
+			for (const auto& line : lines)
+				joined += line + '\n';
+
+			return joined;
+		}
+
+		//
+		// Each field is prefixed by its size, the fields of two different builds cannot be confused
+		//
+		void update_field(sha256& hasher, std::string_view field)
+		{
+			hasher.update(std::format("{}:", field.size()));
+			hasher.update(field);
+		}
+
+		struct cached_object
+		{
+			uint64_t size {};
+			std::filesystem::file_time_type last_use = std::filesystem::file_time_type::min();
+			std::vector<std::filesystem::path> files;
+			bool has_binary = false;
+		};
+
+		//
+		// Files of each build by object id with the time it was last used, a manifest belongs to the
+		// object it points to so that a build is always removed as a whole
+		//
+		[[nodiscard]]
+		std::map<std::string, cached_object> scan(const std::filesystem::path& directory)
+		{
+			std::map<std::string, cached_object> found;
+			std::error_code error;
+
+			for (const auto subdirectory : { "objects", "manifests" })
+			{
+				for (const auto& entry : std::filesystem::directory_iterator(directory / subdirectory, error))
+				{
+					if (!entry.is_regular_file(error) || entry.path().extension() == ".tmp")
+						continue;
+
+					auto id = entry.path().stem().string();
+
+					if (subdirectory == std::string_view("manifests"))
+					{
+						std::ifstream manifest(entry.path());
+						std::getline(manifest, id);
+					}
+
+					auto& object = found[id];
+
+					object.size += entry.file_size(error);
+					object.last_use = std::max(object.last_use, entry.last_write_time(error));
+					object.files.push_back(entry.path());
+					object.has_binary |= entry.path().extension() == ".c8c";
+				}
+			}
+
+			return found;
+		}
+
+		[[nodiscard]]
+		cache_statistics read_statistics(const std::filesystem::path& path)
+		{
+			cache_statistics statistics;
+
+			for (const auto& line : read_lines(path))
+			{
+				std::istringstream fields(line);
+				std::string name;
+				uint64_t value {};
+
+				if (!(fields >> name >> value))
+					continue;
+
+				if (name == "hits")
+					statistics.hits = value;
+				else if (name == "misses")
+					statistics.misses = value;
+				else if (name == "evictions")
+					statistics.evictions = value;
+			}
+
+			return statistics;
+		}
+	}
+
+	build_cache::build_cache(std::filesystem::path cache_directory, uint64_t max_size)
+		: directory(std::move(cache_directory)),
+		  size_limit(max_size),
+		  objects_size(0),
+		  hits(0),
+		  misses(0),
+		  evictions(0)
+	{
+		std::filesystem::create_directories(directory / "objects");
+		std::filesystem::create_directories(directory / "manifests");
+
+		for (const auto& [id, object] : scan(directory))
+			objects_size += object.size;
+	}
+
+	build_cache::~build_cache()
+	{
+		if (hits == 0 && misses == 0 && evictions == 0)
+			return;
+
+		try
+		{
+			//
+			// Runs sharing the directory at the same time may lose a few counts, never the cached builds
+			//
+			auto totals = read_statistics(directory / "stats");
+
+			totals.hits += hits;
+			totals.misses += misses;
+			totals.evictions += evictions;
+
+			write_atomically(directory / "stats", std::format("hits {}\nmisses {}\nevictions {}\n", totals.hits, totals.misses, totals.evictions));
+		}
+		catch (const std::exception&)
+		{
+			// statistics are not worth failing a build for
+		}
+	}
+
+	build_cache::key build_cache::make_key(std::string_view source,
+										   const std::filesystem::path& source_file,
+										   const assembler_options& options,
+										   build_kind kind)
+	{
+		sha256 hasher;
+
+		update_field(hasher, "chasm build cache");
+		update_field(hasher, VERSION);
+		update_field(hasher, std::format("encoding={} build={}", generator::ENCODING_REVISION, CHASM_BUILD_ID));
+		update_field(hasher, std::format("kind={}", std::to_underlying(kind)));
+		update_field(hasher, std::format("relocate={} super={} pad_sprites={}", options.relocate, options.super, options.pad_sprites));
+		update_field(hasher, source_file.empty() ? std::string() : std::filesystem::weakly_canonical(std::filesystem::absolute(source_file)).parent_path().string());
+		update_field(hasher, source);
+
+		return { hasher.finish() };
+	}
+
+	std::optional<build_cache::cached_build> build_cache::fetch(const key& build,
+																const std::filesystem::path& output,
+																const std::filesystem::path& symbols_file)
+	{
+		try
+		{
+			const auto manifest = read_lines(manifest_path(build));
+
+			if (manifest.empty())
+			{
+				++misses;
+				return std::nullopt;
+			}
+
+			cached_build found;
+
+			for (const auto& dependency : std::span(manifest).subspan(1))
+			{
+				const auto separator = dependency.find(' ');
+				const auto path = std::filesystem::path(dependency.substr(separator + 1));
+				const auto current = hash_file(path);
+
+				if (separator == std::string::npos || !current || sha256::to_hex(*current) != dependency.substr(0, separator))
+				{
+					++misses;
+					return std::nullopt;
+				}
+
+				found.dependencies.push_back(path);
+			}
+
+			const auto binary = object_path(manifest[0], ".c8c");
+			const auto symbols = object_path(manifest[0], ".c8s");
+
+			if (!std::filesystem::exists(binary) || (!symbols_file.empty() && !std::filesystem::exists(symbols)))
+			{
+				++misses;
+				return std::nullopt;
+			}
+
+			// an interrupted restore never leaves a truncated output that looks up to date
+			copy_atomically(binary, output);
+
+			if (!symbols_file.empty())
+				copy_atomically(symbols, symbols_file);
+
+			found.log = read_lines(object_path(manifest[0], ".log"));
+
+			// marks the build as recently used
+			std::error_code ignored;
+			std::filesystem::last_write_time(binary, std::filesystem::file_time_type::clock::now(), ignored);
+			std::filesystem::last_write_time(manifest_path(build), std::filesystem::file_time_type::clock::now(), ignored);
+
+			++hits;
+			return found;
+		}
+		catch (const std::exception&)
+		{
+			// evicted by another process while it was read, or the outputs could not be written
+			++misses;
+			return std::nullopt;
+		}
+	}
+
+	void build_cache::store(const key& build,
+							std::span<const std::filesystem::path> dependencies,
+							const std::filesystem::path& output,
+							const std::filesystem::path& symbols_file,
+							std::span<const std::string> log)
+	{
+		std::vector<std::string> manifest(1);
+		sha256 object_hasher;
+
+		object_hasher.update(std::span(build.digest));
+
+		for (const auto& dependency : dependencies)
+		{
+			const auto hash = hash_file(dependency);
+
+			// a dependency removed while the source was assembled, the build cannot be checked later
+			if (!hash)
+				return;
+
+			manifest.push_back(sha256::to_hex(*hash) + ' ' + dependency.string());
+			update_field(object_hasher, manifest.back());
+		}
+
+		manifest[0] = sha256::to_hex(object_hasher.finish());
+
+		const auto binary = object_path(manifest[0], ".c8c");
+		const auto symbols = object_path(manifest[0], ".c8s");
+		const auto log_file = object_path(manifest[0], ".log");
+		const auto log_text = join_lines(log);
+
+		copy_atomically(output, binary);
+		uint64_t stored = std::filesystem::file_size(binary) + log_text.size();
+
+		if (!symbols_file.empty() && std::filesystem::exists(symbols_file))
+		{
+			copy_atomically(symbols_file, symbols);
+			stored += std::filesystem::file_size(symbols);
+		}
+
+		write_atomically(log_file, log_text);
+
+		// written last, a manifest only ever points to complete objects
+		const auto manifest_text = join_lines(manifest);
+		write_atomically(manifest_path(build), manifest_text);
+
+		if ((objects_size += stored + manifest_text.size()) > size_limit)
+			evict();
+	}
+
+	cache_statistics build_cache::statistics() const
+	{
+		auto totals = read_statistics(directory / "stats");
+
+		totals.hits += hits;
+		totals.misses += misses;
+		totals.evictions += evictions;
+
+		for (const auto& [id, object] : scan(directory))
+		{
+			totals.size += object.size;
+			totals.entries += object.has_binary;
+		}
+
+		return totals;
+	}
+
+	std::filesystem::path build_cache::manifest_path(const key& build) const
+	{
+		return directory / "manifests" / sha256::to_hex(build.digest);
+	}
+
+	std::filesystem::path build_cache::object_path(const std::string& object, std::string_view extension) const
+	{
+		return directory / "objects" / (object + std::string(extension));
+	}
+
+	void build_cache::evict()
+	{
+		const std::scoped_lock lock(eviction_guard);
+
+		auto objects = scan(directory);
+		uint64_t total = 0;
+
+		for (const auto& [id, object] : objects)
+			total += object.size;
+
+		std::vector<decltype(objects)::const_iterator> least_recent;
+
+		for (auto object = objects.cbegin(); object != objects.cend(); ++object)
+			least_recent.push_back(object);
+
+		std::ranges::sort(least_recent, {}, [](const auto& object) { return object->second.last_use; });
+
+		const auto target = size_limit / 100 * EVICTION_TARGET_PERCENT;
+
+		for (const auto& object : least_recent)
+		{
+			if (total <= target)
+				break;
+
+			std::error_code ignored;
+
+			for (const auto& file : object->second.files)
+				std::filesystem::remove(file, ignored);
+
+			total -= object->second.size;
+			evictions += object->second.has_binary;
+		}
+
+		objects_size = total;
+	}
+}
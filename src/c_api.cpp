@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <exception>
+#include <cstring>
+
+#include <chasm/include_cache.hpp>
+#include <chasm/ds/listing.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/chasm.h>
+
+
+namespace
+{
+	//
+	// Sizes of the structures of version 2, the first version told the size of the caller's structures.
+	// Later versions only append fields, so these stay the smallest sizes accepted.
+	//
+	constexpr size_t OPTIONS_MIN_SIZE     = sizeof(chasm_options);
+	constexpr size_t DIAGNOSTIC_MIN_SIZE  = sizeof(chasm_diagnostic);
+	constexpr size_t INSTRUCTION_MIN_SIZE = sizeof(chasm_instruction);
+
+	//
+	// Writes the fields of value the caller knows of to the element at index of an array of element_size
+	// bytes elements, the fields of a newer caller this library does not know of are zeroed
+	//
+	template<typename Struct>
+	void write_struct(void* array, size_t element_size, size_t index, const Struct& value)
+	{
+		auto* const element = static_cast<uint8_t*>(array) + index * element_size;
+		const auto known = std::min(element_size, sizeof(Struct));
+
+		std::memcpy(element, &value, known);
+		std::memset(element + known, 0, element_size - known);
+	}
+
+	//
+	// Copies what fits of text into a fixed size field, the field is always null terminated
+	//
+	template<size_t N>
+	void copy_text(char (&field)[N], std::string_view text)
+	{
+		const auto size = std::min(text.size(), N - 1);
+
+		std::ranges::copy(text.substr(0, size), field);
+		field[size] = '\0';
+	}
+
+	chasm_diagnostic to_c(const chasm::diagnostic& entry)
+	{
+		chasm_diagnostic diagnostic {};
+
+		diagnostic.severity = entry.level == chasm::severity::error ? CHASM_SEVERITY_ERROR : CHASM_SEVERITY_WARNING;
+
+		if (entry.location)
+		{
+			diagnostic.line = static_cast<uint32_t>(entry.location->line);
+			diagnostic.column = static_cast<uint32_t>(entry.location->col);
+		}
+
+		copy_text(diagnostic.message, entry.message);
+
+		return diagnostic;
+	}
+
+	chasm_options default_options()
+	{
+		const chasm::assembler_options defaults;
+
+		return {
+			.struct_size = sizeof(chasm_options),
+			.relocate    = defaults.relocate,
+			.super       = defaults.super,
+			.pad_sprites = defaults.pad_sprites,
+			.source_file = nullptr
+		};
+	}
+
+	// fields of the options the caller does not know of keep their default
+	chasm_options read_options(const chasm_options* options)
+	{
+		auto read = default_options();
+
+		if (options)
+			std::memcpy(&read, options, std::min<size_t>(options->struct_size, sizeof(chasm_options)));
+
+		return read;
+	}
+
+	chasm::assembler_options to_cpp(const chasm_options& options)
+	{
+		chasm::assembler_options converted;
+
+		converted.relocate = options.relocate;
+		converted.super = options.super != 0;
+		converted.pad_sprites = options.pad_sprites != 0;
+
+		return converted;
+	}
+}
+
+extern "C"
+{
+	uint32_t chasm_api_version(void)
+	{
+		return CHASM_API_VERSION;
+	}
+
+	const char* chasm_status_string(chasm_status status)
+	{
+		switch (status)
+		{
+			case CHASM_OK:               return "success";
+			case CHASM_ERROR:            return "errors were reported";
+			case CHASM_BUFFER_TOO_SMALL: return "output buffer too small";
+			case CHASM_INVALID_ARGUMENT: return "invalid argument";
+		}
+
+		return "unknown status";
+	}
+
+	chasm_status chasm_default_options(chasm_options* options)
+	{
+		if (!options || options->struct_size < OPTIONS_MIN_SIZE)
+			return CHASM_INVALID_ARGUMENT;
+
+		auto defaults = default_options();
+		defaults.struct_size = options->struct_size;
+
+		write_struct(options, options->struct_size, 0, defaults);
+
+		return CHASM_OK;
+	}
+
+	chasm_status chasm_assemble(const char* source,
+								size_t source_size,
+								const chasm_options* options,
+								uint8_t* binary,
+								size_t binary_capacity,
+								size_t* binary_size,
+								chasm_diagnostic* diagnostics,
+								size_t diagnostic_size,
+								size_t diagnostics_capacity,
+								size_t* diagnostics_count)
+	{
+		if ((!source && source_size) || (!binary && binary_capacity) || !binary_size ||
+			(!diagnostics && diagnostics_capacity) || (diagnostics && diagnostic_size < DIAGNOSTIC_MIN_SIZE) ||
+			(options && options->struct_size < OPTIONS_MIN_SIZE))
+			return CHASM_INVALID_ARGUMENT;
+
+		const auto c_options = read_options(options);
+		const auto source_file = c_options.source_file ? std::filesystem::path(c_options.source_file) : std::filesystem::path();
+
+		// included files are parsed for this call only, nothing is kept once it returns
+		chasm::include_cache includes;
+
+		auto cpp_options = to_cpp(c_options);
+		cpp_options.includes = &includes;
+
+		//
+		// Nothing may be thrown across the C boundary, errors the sink does not collect are added to it
+		//
+		chasm::diagnostics sink;
+		chasm::diagnosed<std::vector<uint8_t>> assembled = std::unexpected(chasm::reported_errors { 1 });
+
+		try
+		{
+			assembled = chasm::assemble(std::string_view(source, source_size), sink, cpp_options, source_file);
+		}
+		catch (const std::exception& error)
+		{
+			sink.error(error.what());
+		}
+		catch (...)
+		{
+			sink.error("Unknown error while assembling.");
+		}
+
+		const auto& entries = sink.entries();
+
+		for (size_t i = 0; i < std::min(entries.size(), diagnostics_capacity); ++i)
+			write_struct(diagnostics, diagnostic_size, i, to_c(entries[i]));
+
+		if (diagnostics_count)
+			*diagnostics_count = entries.size();
+
+		*binary_size = 0;
+
+		if (!assembled || sink.has_errors())
+			return CHASM_ERROR;
+
+		*binary_size = assembled->size();
+
+		if (assembled->size() > binary_capacity)
+			return CHASM_BUFFER_TOO_SMALL;
+
+		std::ranges::copy(*assembled, binary);
+
+		return CHASM_OK;
+	}
+
+	chasm_status chasm_disassemble(const uint8_t* rom,
+								   size_t rom_size,
+								   uint16_t load_address,
+								   chasm_instruction* instructions,
+								   size_t instruction_size,
+								   size_t instructions_capacity,
+								   size_t* instructions_count,
+								   chasm_diagnostic* error,
+								   size_t diagnostic_size)
+	{
+		if ((!rom && rom_size) || (!instructions && instructions_capacity) || !instructions_count ||
+			(instructions && instruction_size < INSTRUCTION_MIN_SIZE) || (error && diagnostic_size < DIAGNOSTIC_MIN_SIZE))
+			return CHASM_INVALID_ARGUMENT;
+
+		*instructions_count = 0;
+
+		const auto report = [error, diagnostic_size](std::string_view message)
+		{
+			if (error)
+				write_struct(error, diagnostic_size, 0, to_c({ .level = chasm::severity::error, .message = std::string(message), .location = std::nullopt }));
+
+			return CHASM_ERROR;
+		};
+
+		std::vector<chasm::ds::listed_instruction> listing;
+
+		try
+		{
+			listing = chasm::ds::make_listing(std::span(rom, rom_size), load_address);
+		}
+		catch (const std::exception& exception)
+		{
+			return report(exception.what());
+		}
+		catch (...)
+		{
+			return report("Unknown error while disassembling.");
+		}
+
+		*instructions_count = listing.size();
+
+		if (listing.size() > instructions_capacity)
+			return CHASM_BUFFER_TOO_SMALL;
+
+		for (size_t i = 0; i < listing.size(); ++i)
+		{
+			chasm_instruction instruction {
+				.address         = listing[i].address,
+				.opcode          = listing[i].opcode,
+				.path_start      = listing[i].path_start,
+				.procedure_start = listing[i].procedure_start,
+				.text            = {}
+			};
+
+			copy_text(instruction.text, listing[i].text);
+			write_struct(instructions, instruction_size, i, instruction);
+		}
+
+		return CHASM_OK;
+	}
+}
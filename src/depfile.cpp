@@ -0,0 +1,63 @@
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+
+#include <chasm/depfile.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		[[nodiscard]]
+		std::string escape(const std::filesystem::path& path)
+		{
+			std::string escaped;
+
+			for (const char c : path.generic_string())
+			{
+				switch (c)
+				{
+					case ' ':
+					case '#':  escaped += '\\'; break;
+					case '$':  escaped += '$';  break;
+
+					default:
+						break;
+				}
+
+				escaped += c;
+			}
+
+			return escaped;
+		}
+	}
+
+	std::string make_depfile(const std::filesystem::path& target, std::span<const std::filesystem::path> inputs)
+	{
+		std::string depfile = escape(target) + ':';
+
+		for (const auto& input : inputs)
+			depfile += " \\\n  " + escape(input);
+
+		depfile += '\n';
+
+		for (const auto& included : inputs.subspan(std::min<size_t>(inputs.size(), 1)))
+			depfile += '\n' + escape(included) + ":\n";
+
+		return depfile;
+	}
+
+	void write_depfile(const std::filesystem::path& target, std::span<const std::filesystem::path> inputs)
+	{
+		auto path = target;
+		path += ".d";
+
+		std::ofstream os(path);
+
+		if (!os)
+			throw std::runtime_error("Could not open file " + path.string() + " for writing");
+
+		os << make_depfile(target, inputs);
+	}
+}
@@ -0,0 +1,85 @@
+#include <chasm/diagnostics.hpp>
+#include <chasm/json.hpp>
+#include <format>
+
+
+namespace chasm
+{
+	namespace
+	{
+		[[nodiscard]]
+		std::string_view to_string(severity level)
+		{
+			return level == severity::error ? "error" : "warning";
+		}
+	}
+
+	void diagnostics::error(std::string message, std::optional<source_location> where)
+	{
+		reported.push_back({ severity::error, std::move(message), where });
+		++errors;
+	}
+
+	void diagnostics::warning(std::string message, std::optional<source_location> where)
+	{
+		reported.push_back({ severity::warning, std::move(message), where });
+	}
+
+	bool diagnostics::has_errors() const
+	{
+		return errors > 0;
+	}
+
+	size_t diagnostics::error_count() const
+	{
+		return errors;
+	}
+
+	size_t diagnostics::warning_count() const
+	{
+		return reported.size() - errors;
+	}
+
+	const std::vector<diagnostic>& diagnostics::entries() const
+	{
+		return reported;
+	}
+
+	std::string diagnostics::to_json(std::string_view file) const
+	{
+		std::string json = "{\"file\": ";
+
+		json::append_string(json, file);
+		json += std::format(", \"errors\": {}, \"warnings\": {}, \"diagnostics\": [", error_count(), warning_count());
+
+		for (size_t i = 0; i < reported.size(); ++i)
+		{
+			const auto& [level, message, location] = reported[i];
+
+			if (i > 0)
+				json += ", ";
+
+			json += std::format("{{\"severity\": \"{}\", ", to_string(level));
+
+			if (location && !location->file.empty())
+			{
+				json += "\"included\": ";
+				json::append_string(json, location->file);
+				json += ", ";
+			}
+
+			if (location)
+				json += std::format("\"line\": {}, \"column\": {}, ", location->line, location->col);
+			else
+				json += "\"line\": null, \"column\": null, ";
+
+			json += "\"message\": ";
+			json::append_string(json, message);
+			json += '}';
+		}
+
+		json += "]}";
+
+		return json;
+	}
+}
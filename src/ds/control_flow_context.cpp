@@ -17,8 +17,8 @@ namespace chasm::ds
 		return ended_;
 	}
 
-	analysis_procedure::analysis_procedure(arch::addr ep)
-			: procedure(ep)
+	analysis_procedure::analysis_procedure(arch::addr entry_point)
+			: procedure(entry_point)
 	{}
 
 	analysis_path& analysis_procedure::current_path()
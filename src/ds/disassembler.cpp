@@ -1,13 +1,13 @@
 #include <chasm/ds/disassembler.hpp>
 #include <chasm/ds/paths.hpp>
-#include <chasm/options.hpp>
 #include <chasm/arch.hpp>
 
 
 namespace chasm::ds
 {
-	disassembler::disassembler(std::vector<uint8_t> from_bytes, arch::addr from_addr)
-		: binary(std::move(from_bytes))
+	disassembler::disassembler(std::span<const uint8_t> from_bytes, arch::addr from_addr)
+		: binary(from_bytes),
+		  base(from_addr)
 	{
 		flow.path_push(from_addr);
 		ds_path();
@@ -37,9 +37,9 @@ namespace chasm::ds
 		/// The paths manager only manipulates "in-memory" addresses, most of the time offset=0x200
 		/// whereas the disassembler works with "disk" addresses, so offset 0x200 maps to address (file offset) 0 on disk
 		///
-		const arch::addr ip = current_path().addr_end() - options::arg<arch::addr>("relocate");
+		const auto ip = static_cast<arch::addr>(current_path().addr_end() - base);
 
-		if (ip + 1 >= binary.size() || ip >= binary.size())
+		if (size_t(ip) + 1 >= binary.size())
 			throw chasm_exception("Unexpected end of bytes while decoding instruction during disassembly at address 0x{:04X}", ip);
 
 		const auto opcode = static_cast<arch::opcode>(binary[ip] << 8 | binary[ip + 1]);
@@ -123,6 +123,8 @@ namespace chasm::ds
 					return;
 				}
 
+				break;
+
 			case 0xE:
 				if (imm8 == 0x9E)
 				{
@@ -135,6 +137,8 @@ namespace chasm::ds
 					return;
 				}
 
+				break;
+
 			case 0xF:
 				switch (imm8)
 				{
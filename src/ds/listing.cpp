@@ -0,0 +1,45 @@
+#include <ranges>
+#include <map>
+
+#include <chasm/ds/disassembler.hpp>
+#include <chasm/ds/listing.hpp>
+
+
+namespace chasm::ds
+{
+	std::vector<listed_instruction> make_listing(std::span<const uint8_t> rom, arch::addr base)
+	{
+		std::map<arch::addr, listed_instruction> listing;
+
+		auto disassembler = ds::disassembler(rom, base);
+		const auto graph = disassembler.get_graph();
+
+		const auto list_path = [&](const path& path, bool procedure_entry)
+		{
+			for (size_t i = 0; i < path.instructions_count(); ++i)
+			{
+				const auto address = static_cast<arch::addr>(path.addr_start() + i * sizeof(arch::opcode));
+				const auto offset = static_cast<size_t>(address - base);
+
+				auto& instruction = listing[address];
+
+				instruction.address = address;
+				instruction.opcode = static_cast<arch::opcode>(rom[offset] << 8 | rom[offset + 1]);
+				instruction.path_start |= i == 0;
+				instruction.procedure_start |= i == 0 && procedure_entry;
+				instruction.text = path.symbolic(i);
+			}
+		};
+
+		for (const auto& path : graph.get_paths())
+			list_path(path, false);
+
+		for (const auto& procedure : graph.get_procedures())
+			for (const auto& path : procedure.get_paths())
+				list_path(path, path.addr_start() == procedure.entrypoint());
+
+		auto values = listing | std::views::values;
+
+		return { values.begin(), values.end() };
+	}
+}
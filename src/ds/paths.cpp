@@ -14,7 +14,7 @@ namespace chasm::ds
 
 	arch::addr path::addr_end() const
 	{
-		return start_addr + instructions_count() * sizeof(arch::opcode);
+		return static_cast<arch::addr>(start_addr + instructions_count() * sizeof(arch::opcode));
 	}
 
 	size_t path::instructions_count() const
@@ -42,8 +42,8 @@ namespace chasm::ds
 		ordered_paths.insert(std::move(p));
 	}
 
-	procedure::procedure(arch::addr ep)
-		: ep(ep)
+	procedure::procedure(arch::addr entry_point)
+		: ep(entry_point)
 	{}
 
 	arch::addr procedure::entrypoint() const
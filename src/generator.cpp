@@ -1,162 +1,418 @@
+#include <filesystem>
 #include <span>
 #include <fstream>
 #include <algorithm>
 
+#include <chasm/precompiled_module.hpp>
 #include <chasm/generator.hpp>
-#include <chasm/options.hpp>
 #include <chasm/arch.hpp>
 #include <chasm/log.hpp>
 
 
 namespace chasm
 {
-	void generate_symbols_file(const std::filesystem::path& path,
-							   const std::unordered_map<std::string, arch::addr>& mapping)
+	[[nodiscard]]
+	arch::reg operand2reg(const ast::instruction_operand& operand)
 	{
-		std::ofstream os(path);
+		// general purpose registers were already numbered by the lexer
+		return static_cast<arch::reg>(operand.value);
+	}
 
-		if (!os)
-		{
-			log::error("Could not open file \"{}\" to write symbols mapping.", path.string());
-			return;
-		}
+	constinit const generator::encoding_table generator::encodings = []
+	{
+		encoding_table table {};
 
-		auto sort_pred = [](const std::pair<std::string, arch::addr>& a,
-				            const std::pair<std::string, arch::addr>& b)
+		auto encoder = [&](arch::instruction_id id, encode_fn encode, bool super = false)
 		{
-			return a.second < b.second;
+			table[id] = { .encode = encode, .super = super };
 		};
 
-		//
-		// Sort from lowest to highest address
-		//
-		std::vector<std::pair<std::string, arch::addr>> elems(mapping.begin(), mapping.end());
-		std::sort(elems.begin(), elems.end(), sort_pred);
+		encoder(arch::instruction_id::ADD,   &generator::encode_add);
+		encoder(arch::instruction_id::SUB,   &generator::encode_sub);
+		encoder(arch::instruction_id::SUBA,  &generator::encode_suba);
+		encoder(arch::instruction_id::OR,    &generator::encode_or);
+		encoder(arch::instruction_id::AND,   &generator::encode_and);
+		encoder(arch::instruction_id::XOR,   &generator::encode_xor);
+		encoder(arch::instruction_id::SHR,   &generator::encode_shr);
+		encoder(arch::instruction_id::SHL,   &generator::encode_shl);
+		encoder(arch::instruction_id::RDUMP, &generator::encode_rdump);
+		encoder(arch::instruction_id::RLOAD, &generator::encode_rload);
+		encoder(arch::instruction_id::MOV,   &generator::encode_mov);
+		encoder(arch::instruction_id::DRAW,  &generator::encode_draw);
+		encoder(arch::instruction_id::CLS,   &generator::encode_cls);
+		encoder(arch::instruction_id::RAND,  &generator::encode_rand);
+		encoder(arch::instruction_id::BCD,   &generator::encode_bcd);
+		encoder(arch::instruction_id::WKEY,  &generator::encode_wkey);
+		encoder(arch::instruction_id::SKE,   &generator::encode_ske);
+		encoder(arch::instruction_id::SKNE,  &generator::encode_skne);
+		encoder(arch::instruction_id::RET,   &generator::encode_ret);
+		encoder(arch::instruction_id::JMP,   &generator::encode_jmp);
+		encoder(arch::instruction_id::CALL,  &generator::encode_call);
+		encoder(arch::instruction_id::SE,    &generator::encode_se);
+		encoder(arch::instruction_id::SNE,   &generator::encode_sne);
+		encoder(arch::instruction_id::INC,   &generator::encode_inc);
+		encoder(arch::instruction_id::LDF,   &generator::encode_ldf);
+
+		encoder(arch::instruction_id::EXIT,    &generator::encode_exit,    true);
+		encoder(arch::instruction_id::SCRD,    &generator::encode_scrd,    true);
+		encoder(arch::instruction_id::SCRL,    &generator::encode_scrl,    true);
+		encoder(arch::instruction_id::SCRR,    &generator::encode_scrr,    true);
+		encoder(arch::instruction_id::HIGH,    &generator::encode_high,    true);
+		encoder(arch::instruction_id::LOW,     &generator::encode_low,     true);
+		encoder(arch::instruction_id::LDFS,    &generator::encode_ldfs,    true);
+		encoder(arch::instruction_id::SAVERPL, &generator::encode_saverpl, true);
+		encoder(arch::instruction_id::LOADRPL, &generator::encode_loadrpl, true);
+
+		table[arch::instruction_id::SWP] = { .encode_pseudo = &generator::encode_swp };
+
+		return table;
+	}();
+
+	generator::generator(const interner& symbols,
+						 const stream& source_stream,
+						 const assembler_options& assembly_options,
+						 diagnostics* diagnostics_sink)
+		: names(&symbols),
+		  source(&source_stream),
+		  options(assembly_options),
+		  sink(diagnostics_sink),
+		  sanitizer(symbols, source_stream, diagnostics_sink),
+		  sections(1)
+	{}
+
+	void generator::generate(const ast::flat_nodes& fragment)
+	{
+		nodes = &fragment;
 
-		const auto mapped_base = options::arg<arch::addr>("relocate");
+		grow_symbol_tables();
+		sanitizer.enter_fragment(fragment);
 
-		for (const auto& [symbol, addr] : elems)
+		for (ast::node_id id = 0; id < nodes->size(); id = nodes->end_of(id))
 		{
-			const arch::addr addr_file = addr;
-			const arch::addr addr_mem  = addr + mapped_base;
-
-			os << std::format("{:#06x} {:#06x} --> {}", addr_file, addr_mem, symbol) << std::endl;
+			if (nodes->kinds[id] == ast::node_kind::procedure)
+				generate_procedure(id);
+			else
+				generate_nodes(id, nodes->end_of(id));
 		}
 
-		log::info("{} symbols mapping written to \"{}\".", mapping.size(), path.string());
+		sanitizer.leave_fragment();
+		nodes = nullptr;
 	}
 
-	void warn_super_instruction(const ast::instruction_statement& instruction)
+	std::vector<uint8_t> generator::link()
 	{
-		log::warn("Instruction {} at {} is a SuperCHIP-8 instruction but flag \"super\" was not provided.",
-				  instruction.mnemonic.to_string(),
-				  to_string(instruction.mnemonic.source_location));
+		sanitizer.finish();
+
+		size_t code_size = 0;
+
+		for (const auto& section : sections)
+			code_size += section.size();
+
+		emit_sprites(code_size);
+
+		section_bases.clear();
+		binary.clear();
+		binary.reserve(code_size + sections.back().size());
+
+		for (const auto& section : sections)
+		{
+			section_bases.push_back(binary.size());
+			binary.append_range(section);
+		}
+
+		//
+		// Apply jmp/call patches that could not be encoded directly
+		//
+		for (const auto& [location, sym, offset, statement] : patches)
+		{
+			//
+			// The sanitizer rejects references to undefined symbols, an address can only be
+			// missing once it reported them. Anything else is a bug, never a jump to 0.
+			//
+			if (!addresses[sym])
+			{
+				if (!(sink && sink->has_errors()))
+					reject_patch(chasm_exception("Address of \"{}\" is unknown when linking.", names->name(sym)), statement);
+
+				continue;
+			}
+
+			apply_patch(absolute(location), absolute(*addresses[sym]) + int64_t(offset), statement);
+		}
+
+		for (const auto& [location, target, offset, statement] : fixups)
+			apply_patch(absolute(location), absolute(target) + int64_t(offset), statement);
+
+		if (!options.symbols_file.empty() && !(sink && sink->has_errors()))
+			generate_symbols_file(options.symbols_file);
+
+		if (binary.size() > arch::MAX_PROGRAM_SIZE)
+			warn_program_size();
+
+		return std::move(binary);
 	}
 
-	[[nodiscard]]
-	arch::reg operand2reg(const ast::instruction_operand& operand)
+	std::vector<uint8_t> generator::export_module()
 	{
-		const char id = operand.reg_name()[1];
+		using symbol_kind = precompiled_module::symbol_kind;
+
+		sanitizer.finish(false);
+
+		if (!sections[MAIN_SECTION].empty())
+			throw module_exception::invalid_module_content("code is only allowed inside procedures");
+
+		for (const auto& [scope, symbol, label, addr] : symbols_map)
+			if (label && scope == NO_SYMBOL)
+				throw module_exception::invalid_module_content(std::format("label \"{}\" is outside of a procedure", names->name(symbol)));
+
+		//
+		// Sections of procedures follow the main section, so they move down by one in the module
+		//
+		module_writer module;
+		std::vector<uint32_t> exported(names->size(), std::numeric_limits<uint32_t>::max());
 
-		if (std::isdigit(id))
-			return id - '0';
+		for (uint32_t section = MAIN_SECTION + 1; section < sections.size(); ++section)
+			static_cast<void>(module.add_section(sections[section]));
 
-		return 0xA + (id - 'a');
+		for (const auto& [scope, symbol, label, addr] : symbols_map)
+			if (!label)
+				exported[symbol] = module.add_symbol(symbol_kind::procedure, names->name(symbol), addr.section - 1);
+
+		for (const auto symbol : sprites_order)
+			exported[symbol] = module.add_symbol(symbol_kind::sprite, names->name(symbol), module.add_sprite(*sprites[symbol]));
+
+		for (const auto symbol : global_constants)
+			exported[symbol] = module.add_symbol(symbol_kind::constant, names->name(symbol), *constants[symbol]);
+
+		for (const auto& [location, symbol, offset, statement] : patches)
+		{
+			if (symbol == NO_SYMBOL || exported[symbol] == std::numeric_limits<uint32_t>::max())
+				throw module_exception::invalid_module_content("an address does not refer to a procedure or a sprite of the module");
+
+			module.add_relocation({ location.section - 1, location.offset, exported[symbol], offset, true });
+		}
+
+		for (const auto& [location, target, offset, statement] : fixups)
+			module.add_relocation({ location.section - 1, location.offset, target.section - 1, int32_t(target.offset) + offset, false });
+
+		return module.bytes();
 	}
 
-	[[nodiscard]]
-	uint16_t make_operands_mask(const ast::instruction_statement& instruction)
+	void generator::import_module(ast::node_id id)
 	{
-		if (instruction.operands.size() > arch::MAX_OPERANDS)
-			throw chasm_exception("Instruction \"{}\" at {} has {} operands "
-								  "but CHIP-8 instructions can have up to {} operands.",
-								  instruction.operands.size(),
-								  arch::MAX_OPERANDS);
+		using symbol_kind = precompiled_module::symbol_kind;
+
+		const auto& module = *nodes->module(id).file;
+		const auto imports = nodes->imports_of(id);
+
+		// procedures start their section, they are registered before their code is copied
+		const auto section_base = static_cast<uint32_t>(sections.size());
+		sections.resize(section_base + module.sections_count());
+
+		for (size_t i = 0; i < imports.size(); ++i)
+		{
+			const auto [kind, name, value] = module.symbol_at(i);
+
+			switch (kind)
+			{
+				case symbol_kind::procedure:
+					current_section = section_base + value;
+					register_symbol_addr(imports[i]);
+					break;
+
+				case symbol_kind::sprite:
+					register_sprite(imports[i], module.sprite(value));
+					break;
+
+				case symbol_kind::constant:
+					register_constant(imports[i], static_cast<arch::imm>(value));
+					break;
+			}
+		}
 
-		uint16_t mask = 0;
-		uint16_t shift = 0;
+		current_section = MAIN_SECTION;
 
-		for (const auto& operand : instruction.operands)
+		for (size_t section = 0; section < module.sections_count(); ++section)
 		{
-			mask |= (static_cast<uint8_t>(operand.arch_type()) << shift);
-			shift += arch::BITSHIFT_OP_MASK;
+			const auto code = module.section(section);
+			sections[section_base + section].assign(code.begin(), code.end());
 		}
 
-		return mask;
+		for (size_t i = 0; i < module.relocations_count(); ++i)
+		{
+			const auto [section, offset, target, addend, to_symbol] = module.relocation_at(i);
+			const auto location = code_address { section_base + section, offset };
+
+			if (to_symbol)
+				patches.push_back({ location, imports[target], addend, current_statement });
+			else
+				fixups.push_back({ location, { section_base + target, 0 }, addend, current_statement });
+		}
 	}
 
-	void ensure_operands_count(const ast::instruction_statement& inst, std::initializer_list<int> expected_counts)
+	void generator::emit_sprites(size_t code_size)
 	{
-		if (!std::ranges::contains(expected_counts, inst.operands.size()))
-			throw generator_exception::invalid_operands_count(inst, expected_counts);
+		//
+		// Sprites go to the end of the code, in their own section
+		//
+		current_section = static_cast<uint32_t>(sections.size());
+		sections.emplace_back();
+
+		for (const auto symbol : sprites_order)
+		{
+			const auto& sprite = *sprites[symbol];
+
+			register_symbol_addr(symbol);
+
+			for (uint8_t row = 0; row < sprite.row_count; ++row)
+				emit_byte(sprite.data[row]);
+
+			const bool misaligned = (code_size + sections[current_section].size()) % sizeof(arch::opcode) != 0;
+
+			if (misaligned && options.pad_sprites)
+				emit_byte(0x00);
+		}
+
+		current_section = MAIN_SECTION;
 	}
 
-	void ensure_operands_count(const ast::instruction_statement& inst, int expected_count)
+	void generator::grow_symbol_tables()
 	{
-		if (inst.operands.size() != expected_count)
-			throw generator_exception::invalid_operands_count(inst, { expected_count });
+		const auto symbols_count = names->size();
+
+		if (symbols_count <= addresses.size())
+			return;
+
+		addresses.resize(symbols_count);
+		local_addresses.resize(symbols_count);
+		constants.resize(symbols_count);
+		sprites.resize(symbols_count);
 	}
 
-	std::vector<uint8_t> generator::generate(const ast::abstract_tree& ast)
+	generator::code_address generator::here() const
 	{
-		for (const auto& branch : ast.branches())
-			branch->accept(*this);
+		return {
+			.section = current_section,
+			.offset  = static_cast<uint32_t>(sections[current_section].size())
+		};
+	}
 
-		post_visit();
+	arch::addr generator::absolute(const code_address& address) const
+	{
+		return static_cast<arch::addr>(section_bases[address.section] + address.offset);
+	}
 
-		return binary;
+	void generator::apply_patch(size_t location, int64_t address, source_offset statement)
+	{
+		const int64_t relocated = options.relocate + address;
+
+		if (address < 0)
+			return reject_patch(chasm_exception("Address expression patched at {:x} resolves to the negative offset {}.",
+												location,
+												address),
+								statement);
+
+		if (relocated > std::numeric_limits<arch::addr>::max())
+			return reject_patch(chasm_exception("Address {:x} is out of the chip8's memory range once relocated to {:x}.\n"
+												"Assembler cannot generate address patch at {:x}",
+												address,
+												relocated,
+												location),
+								statement);
+
+		binary[location + 0] |= static_cast<uint8_t>((static_cast<arch::addr>(relocated) & 0x0F00) >> 8);
+		binary[location + 1] |= static_cast<uint8_t>((static_cast<arch::addr>(relocated) & 0x00FF));
 	}
 
-	void generator::post_visit()
+	void generator::reject_patch(const chasm_exception& error, source_offset statement) const
 	{
-		//
-		// Add sprites to the end of the code
-		//
-		for (const auto& [name, sprite] : sprites)
-		{
-			register_symbol_addr(name);
+		if (!sink)
+			throw error;
 
-			binary.append_range(std::span(sprite.data.begin(), sprite.row_count));
+		sink->error(error.what(), source->locate(statement));
+	}
 
-			const bool misaligned = binary.size() % sizeof(arch::opcode) != 0;
+	void generator::generate_symbols_file(const std::string& path) const
+	{
+		std::ofstream os(path);
 
-			if (misaligned && options::has_flag("pad-sprites"))
-				binary.push_back(0x00);
+		if (!os)
+		{
+			log::error("Could not open file \"{}\" to write symbols mapping.", path);
+			return;
 		}
 
-		const auto base_addr = options::arg<arch::addr>("relocate");
-
 		//
-		// Apply jmp/call patches that could not be encoded directly
+		// Sort from lowest to highest address, names are only rebuilt here
 		//
-		for (const auto& [location, sym] : patches)
+		auto elems = symbols_map;
+		std::ranges::stable_sort(elems, {}, [this](const symbol_address& elem) { return absolute(elem.addr); });
+
+		const auto mapped_base = options.relocate;
+
+		for (const auto& [scope, sym, label, addr] : elems)
 		{
-			const uintptr_t relocated = base_addr + sym_addresses[sym];
+			const arch::addr addr_file = absolute(addr);
+			const arch::addr addr_mem  = addr_file + mapped_base;
 
-			if (relocated > std::numeric_limits<arch::addr>::max())
-				throw chasm_exception("Symbol \"{}\" relocated to address {:x} which is out of the chip8's memory range.\n"
-									  "Assembler cannot generate address patch at {:x}",
-									  sym,
-									  relocated,
-									  location * sizeof(arch::opcode));
+			const auto name = label
+				? std::format("{}.{}", scope == NO_SYMBOL ? "" : names->name(scope), names->name(sym))
+				: std::string(names->name(sym));
 
-			binary[location + 0] |= ((static_cast<arch::addr>(relocated) & 0x0F00) >> 8);
-			binary[location + 1] |= ((static_cast<arch::addr>(relocated) & 0x00FF));
+			os << std::format("{:#06x} {:#06x} --> {}", addr_file, addr_mem, name) << std::endl;
 		}
 
-		if (options::has_flag("symbols"))
-			generate_symbols_file(options::arg<std::string>("symbols"), sym_addresses);
+		log::info("{} symbols mapping written to \"{}\".", elems.size(), path);
+	}
+
+	source_location generator::locate(const token& token) const
+	{
+		return source->locate(token.offset);
+	}
+
+	void generator::warn_super_instruction(const ast::instruction_view& instruction) const
+	{
+		constexpr std::string_view message = "Instruction {} at {} is a SuperCHIP-8 instruction but flag \"super\" was not provided.";
+
+		const auto where = locate(instruction.mnemonic);
+
+		if (sink)
+			sink->warning(std::format(message, instruction.mnemonic.to_string(), to_string(where)), where);
+		else
+			log::warn(message, instruction.mnemonic.to_string(), to_string(where));
+	}
+
+	void generator::warn_program_size() const
+	{
+		constexpr std::string_view message = "CHIP-8 programs are generally up to {} bytes but the program assembled to {} bytes.";
+
+		if (sink)
+			sink->warning(std::format(message, arch::MAX_PROGRAM_SIZE, binary.size()));
+		else
+			log::warn(message, arch::MAX_PROGRAM_SIZE, binary.size());
+	}
+
+	void generator::ensure_operands_count(const ast::instruction_view& inst, std::initializer_list<int> expected_counts) const
+	{
+		if (!std::ranges::contains(expected_counts, inst.operands.size()))
+			throw generator_exception::invalid_operands_count(inst, locate(inst.mnemonic), expected_counts);
+	}
+
+	void generator::ensure_operands_count(const ast::instruction_view& inst, int expected_count) const
+	{
+		if (inst.operands.size() != size_t(expected_count))
+			throw generator_exception::invalid_operands_count(inst, locate(inst.mnemonic), { expected_count });
 	}
 
 	void generator::emit_byte(uint8_t b)
 	{
-		binary.push_back(b);
+		sections[current_section].push_back(b);
 	}
 
 	void generator::emit_opcode(arch::opcode opcode)
 	{
-		emit_byte((opcode & 0xFF00) >> 8);
-		emit_byte((opcode & 0x00FF));
+		emit_byte(static_cast<uint8_t>((opcode & 0xFF00) >> 8));
+		emit_byte(static_cast<uint8_t>((opcode & 0x00FF)));
 	}
 
 	void generator::emit_opcodes(const std::vector<arch::opcode>& opcodes)
@@ -165,129 +421,246 @@ namespace chasm
 			emit_opcode(opcode);
 	}
 
-	void generator::visit(const ast::procedure_statement& procedure)
+	void generator::generate_nodes(ast::node_id first, ast::node_id last)
 	{
-		register_symbol_addr(procedure.name_beg.to_string());
-
-		current_proc_name = procedure.name_beg.to_string();
+		for (ast::node_id id = first; id < last; ++id)
+		{
+			if (!sanitizer.check(id))
+				continue;
 
-		for (const auto& inner : procedure.inner_statements)
-			inner->accept(*this);
+			if (!sink)
+			{
+				generate_node(id);
+				continue;
+			}
 
-		current_proc_name = "";
+			//
+			// Recovery point: the node is dropped, nothing was emitted for it before the error
+			//
+			try
+			{
+				generate_node(id);
+			}
+			catch (const chasm_exception& error)
+			{
+				sink->error(error.what(), locate(nodes->token_at(id)));
+			}
+		}
 	}
 
-	void generator::visit(const ast::instruction_statement& instruction)
+	void generator::generate_node(ast::node_id id)
 	{
-		const auto inst_id = instruction.to_arch_id();
+		const auto symbol = nodes->symbols[id];
+		current_statement = nodes->token_at(id).offset;
 
-		if (mnemonic_encoders.contains(inst_id))
+		switch (nodes->kinds[id])
 		{
-			auto encoder = mnemonic_encoders.at(inst_id);
-			emit_opcode((this->*encoder)(instruction));
-		}
-		else if (pseudo_mnemonic_encoders.contains(inst_id))
-		{
-			auto encoder = pseudo_mnemonic_encoders.at(inst_id);
-			emit_opcodes((this->*encoder)(instruction));
-		}
-		else if (super_mnemonic_encoders.contains(inst_id))
-		{
-			if (!options::has_flag("super"))
-				warn_super_instruction(instruction);
+			case ast::node_kind::label:
+				register_label_addr(symbol);
+				break;
+
+			case ast::node_kind::instruction:
+				generate_instruction(nodes->instruction(id));
+				break;
+
+			case ast::node_kind::define:
+				register_constant(symbol, fold_constant(nodes->expression(id), arch::fmt_imm16));
+				break;
+
+			case ast::node_kind::config:
+				generate_config(id);
+				break;
+
+			case ast::node_kind::sprite:
+				register_sprite(symbol, nodes->sprite(id));
+				break;
+
+			case ast::node_kind::raw:
+				generate_raw(id);
+				break;
+
+			case ast::node_kind::include:
+				// the included statements follow the include node
+				break;
 
-			auto encoder = super_mnemonic_encoders.at(inst_id);
-			emit_opcode((this->*encoder)(instruction));
+			case ast::node_kind::module:
+				import_module(id);
+				break;
+
+			case ast::node_kind::procedure:
+				throw chasm_exception("Generator found a nested procedure, this should have been caught by the parser.");
 		}
 	}
 
-	void generator::visit(const ast::define_statement& define)
+	void generator::generate_procedure(ast::node_id procedure)
 	{
-		register_constant(define.identifier.to_string(), define.value.to_integer());
-	}
+		// a procedure with a rejected name still has its body checked
+		const bool defined = sanitizer.check(procedure);
 
-	void generator::visit(const ast::config_statement& statement)
-	{
-		const auto id = statement.identifier.to_string();
+		current_section = static_cast<uint32_t>(sections.size());
+		sections.emplace_back();
 
-		if (statement.value.type == token_type::keyword_default)
-			cfg.reset(id);
-		else
-			cfg.set(id, statement.value.to_integer());
+		if (defined)
+			register_symbol_addr(nodes->symbols[procedure]);
+
+		current_proc = nodes->symbols[procedure];
+
+		generate_nodes(procedure + 1, nodes->end_of(procedure));
+
+		resolve_local_labels();
+
+		current_proc = NO_SYMBOL;
+		current_section = MAIN_SECTION;
 	}
 
-	void generator::visit(const ast::sprite_statement& sprite_statement)
+	void generator::generate_instruction(const ast::instruction_view& instruction)
 	{
-		register_sprite(sprite_statement.identifier.to_string(), sprite_statement.sprite);
+		const auto& instruction_encoding = encodings[instruction.to_arch_id()];
+
+		if (instruction_encoding.super && !options.super)
+			warn_super_instruction(instruction);
+
+		if (instruction_encoding.encode)
+			emit_opcode((this->*instruction_encoding.encode)(instruction));
+		else if (instruction_encoding.encode_pseudo)
+			emit_opcodes((this->*instruction_encoding.encode_pseudo)(instruction));
 	}
 
-	void generator::visit(const ast::label_statement& label)
+	void generator::generate_config(ast::node_id config)
 	{
-		register_symbol_addr(current_proc_name + "." + label.identifier.to_string());
+		const auto id = nodes->token_at(config).to_string();
+		const auto& value = nodes->token_at(config, 1);
 
-		for (const auto& inner : label.inner_statements)
-			inner->accept(*this);
+		if (value.type == token_type::keyword_default)
+			cfg.reset(id);
+		else
+			cfg.set(id, value.to_integer());
 	}
 
-	void generator::visit(const ast::raw_statement& statement)
+	void generator::generate_raw(ast::node_id raw)
 	{
 		const auto aligned = cfg.get_as<bool>(config_vars::RAW_ALIGNED);
 
-		const arch::imm v = operand2imm(statement.opcode, arch::fmt_imm16);
+		const arch::imm v = fold_constant(nodes->expression(raw), arch::fmt_imm16);
 
 		if (aligned || v > std::numeric_limits<uint8_t>::max())
-			emit_opcode(v);
+			emit_opcode(static_cast<arch::opcode>(v));
 		else
-			emit_byte(v);
+			emit_byte(static_cast<uint8_t>(v));
 	}
 
-	void generator::register_constant(std::string &&symbol, arch::imm value)
+	void generator::register_constant(symbol_id symbol, arch::imm value)
 	{
 		//
 		// The sanitizer has already made sure it is not the same scope,
 		// so we can safely overwrite the previous definition
 		//
-		constants[std::move(symbol)] = value;
+		constants[symbol] = value;
+
+		if (current_proc == NO_SYMBOL)
+			global_constants.push_back(symbol);
 	}
 
-	void generator::register_sprite(std::string&& symbol, const arch::sprite& sprite)
+	void generator::register_sprite(symbol_id symbol, const arch::sprite& sprite)
 	{
-		if (sprites.contains(symbol))
-			throw chasm_exception("Generator found an already defined sprite \"{}\", this should have been caught by the sanitizer.", symbol);
+		if (sprites[symbol])
+			throw chasm_exception("Generator found an already defined sprite \"{}\", this should have been caught by the sanitizer.",
+								  names->name(symbol));
 
-		sprites[std::move(symbol)] = sprite;
+		sprites[symbol] = sprite;
+		sprites_order.push_back(symbol);
 	}
 
-	void generator::register_symbol_addr(std::string symbol)
+	void generator::register_symbol_addr(symbol_id symbol)
 	{
-		if (sym_addresses.contains(symbol))
-			throw chasm_exception("Generator found an already existing symbol \"{}\", this should have been caught by the sanitizer.", symbol);
+		if (addresses[symbol])
+			throw chasm_exception("Generator found an already existing symbol \"{}\", this should have been caught by the sanitizer.",
+								  names->name(symbol));
 
-		sym_addresses[std::move(symbol)] = binary.size();
+		addresses[symbol] = here();
+		symbols_map.push_back({ NO_SYMBOL, symbol, false, *addresses[symbol] });
 	}
 
-	void generator::register_patch_location(std::string&& symbol)
+	void generator::register_label_addr(symbol_id label)
+	{
+		if (current_proc == NO_SYMBOL)
+		{
+			register_symbol_addr(label);
+			symbols_map.back().label = true;
+			return;
+		}
+
+		if (local_addresses[label])
+			throw chasm_exception("Generator found an already existing label \"{}\", this should have been caught by the sanitizer.",
+								  names->name(label));
+
+		local_addresses[label] = here();
+		local_labels.push_back(label);
+		symbols_map.push_back({ current_proc, label, true, *local_addresses[label] });
+	}
+
+	void generator::register_patch_location(symbol_id symbol, int32_t offset)
 	{
 		patches.push_back({
-			.location = static_cast<arch::addr>(binary.size()),
-			.sym = std::move(symbol)
+			.location = here(),
+			.sym = symbol,
+			.offset = offset,
+			.statement = current_statement
 		});
 	}
 
-	arch::imm generator::operand2imm(const token& token, arch::imm_format imm_width) const
+	void generator::register_label_patch_location(symbol_id label, int32_t offset)
 	{
-		arch::imm imm = 0;
+		auto& pending = current_proc == NO_SYMBOL ? patches : local_patches;
+
+		pending.push_back({
+			.location = here(),
+			.sym = label,
+			.offset = offset,
+			.statement = current_statement
+		});
+	}
 
-		if (token.type == token_type::numerical)
-			imm = token.to_integer();
+	void generator::register_address_patch(const folded_expression& address)
+	{
+		// offsets were bounded by the 16 bits constants they were folded from
+		const auto offset = static_cast<int32_t>(address.value);
+
+		if (address.base_kind == ast::expression_term::kind::label)
+			register_label_patch_location(address.base, offset);
 		else
+			register_patch_location(address.base, offset);
+	}
+
+	void generator::resolve_local_labels()
+	{
+		//
+		// Labels of the procedure are all known once it ends. A reference to a label outside of it
+		// is rejected by the sanitizer when the procedure scope closes, it is never resolved globally.
+		//
+		for (const auto& patch : local_patches)
+			if (local_addresses[patch.sym])
+				fixups.push_back({ patch.location, *local_addresses[patch.sym], patch.offset, patch.statement });
+
+		for (const auto label : local_labels)
+			local_addresses[label].reset();
+
+		local_patches.clear();
+		local_labels.clear();
+	}
+
+	arch::imm generator::operand2imm(arch::imm value, symbol_id symbol, arch::imm_format imm_width) const
+	{
+		arch::imm imm = value;
+
+		if (symbol != NO_SYMBOL)
 		{
-			const auto identifier = token.to_string();
+			imm = 0;
 
-			if (constants.contains(identifier))
-				imm = constants.at(identifier);
-			else if (sprites.contains(identifier))
-				imm = sprites.at(identifier).row_count;
+			if (constants[symbol])
+				imm = *constants[symbol];
+			else if (sprites[symbol])
+				imm = sprites[symbol]->row_count;
 		}
 
 		if (!arch::imm_matches_format(imm, imm_width))
@@ -298,14 +671,189 @@ namespace chasm
 
 	arch::imm generator::operand2imm(const ast::instruction_operand& operand, arch::imm_format imm) const
 	{
-		return operand2imm(operand.operand, imm);
+		if (operand.is_expression())
+			return fold_constant(nodes->terms_of(operand), imm);
+
+		return operand2imm(operand.value, operand.symbol, imm);
 	}
 
-	arch::opcode generator::encode_add(const ast::instruction_statement& add)
+	generator::folded_expression generator::operand2address(const ast::instruction_operand& operand) const
+	{
+		using term_kind = ast::expression_term::kind;
+
+		if (operand.is_expression())
+			return fold(nodes->terms_of(operand));
+
+		const auto base_kind = operand.is_label()     ? term_kind::label
+							 : operand.is_procedure() ? term_kind::procedure
+							 : operand.is_sprite()    ? term_kind::sprite
+							 : term_kind::number;
+
+		return { .value = 0, .base = operand.symbol, .base_kind = base_kind };
+	}
+
+	int64_t generator::constant_value(symbol_id symbol) const
+	{
+		// names of sprites stand for their rows count, as operands of draw
+		if (constants[symbol])
+			return *constants[symbol];
+
+		if (sprites[symbol])
+			return sprites[symbol]->row_count;
+
+		return 0;
+	}
+
+	generator::folded_expression generator::fold(std::span<const ast::expression_term> terms) const
+	{
+		using term_kind = ast::expression_term::kind;
+
+		//
+		// Terms are in postfix order, operators pop their operands from the stack
+		//
+		std::vector<folded_expression> stack;
+		stack.reserve(terms.size());
+
+		for (const auto& term : terms)
+		{
+			const auto error = [&](std::string_view reason)
+			{
+				return generator_exception::invalid_expression(reason, locate(nodes->token_of(term)));
+			};
+
+			const auto pop = [&]
+			{
+				const auto operand = stack.back();
+				stack.pop_back();
+
+				return operand;
+			};
+
+			const auto constant = [&](const folded_expression& operand)
+			{
+				if (operand.base != NO_SYMBOL)
+					throw error("an address can only be offset by a constant");
+
+				return operand.value;
+			};
+
+			// values stay within 32 bits, so products and shifts of values cannot overflow
+			const auto push = [&](const folded_expression& folded)
+			{
+				if (folded.value < std::numeric_limits<int32_t>::min() || folded.value > std::numeric_limits<int32_t>::max())
+					throw error("value out of range");
+
+				stack.push_back(folded);
+			};
+
+			switch (term.what)
+			{
+				case term_kind::number:
+					push({ .value = term.value });
+					break;
+
+				case term_kind::constant:
+					push({ .value = constant_value(term.symbol) });
+					break;
+
+				case term_kind::sprite_size:
+					push({ .value = sprites[term.symbol] ? sprites[term.symbol]->row_count : 0 });
+					break;
+
+				case term_kind::label:
+				case term_kind::procedure:
+				case term_kind::sprite:
+					push({ .value = 0, .base = term.symbol, .base_kind = term.what });
+					break;
+
+				case term_kind::negate:    push({ .value = -constant(pop()) }); break;
+				case term_kind::bit_not:   push({ .value = ~constant(pop()) & 0xFFFF }); break;
+				case term_kind::high_byte: push({ .value = (constant(pop()) >> 8) & 0xFF }); break;
+				case term_kind::low_byte:  push({ .value = constant(pop()) & 0xFF }); break;
+
+				case term_kind::binary:
+				{
+					auto rhs = pop();
+					auto lhs = pop();
+
+					if (term.op == expression_operator::add && lhs.base == NO_SYMBOL)
+						std::swap(lhs, rhs);
+
+					// address + constant, constant + address or address - constant
+					if (lhs.base != NO_SYMBOL &&
+						(term.op == expression_operator::add || term.op == expression_operator::subtract))
+					{
+						const auto offset = constant(rhs);
+
+						lhs.value += term.op == expression_operator::add ? offset : -offset;
+						push(lhs);
+						break;
+					}
+
+					const auto x = constant(lhs);
+					const auto y = constant(rhs);
+
+					switch (term.op)
+					{
+						case expression_operator::add:      push({ .value = x + y }); break;
+						case expression_operator::subtract: push({ .value = x - y }); break;
+						case expression_operator::multiply: push({ .value = x * y }); break;
+						case expression_operator::bit_and:  push({ .value = x & y }); break;
+						case expression_operator::bit_or:   push({ .value = x | y }); break;
+						case expression_operator::bit_xor:  push({ .value = x ^ y }); break;
+
+						case expression_operator::divide:
+						case expression_operator::modulo:
+							if (y == 0)
+								throw error("division by zero");
+
+							push({ .value = term.op == expression_operator::divide ? x / y : x % y });
+							break;
+
+						case expression_operator::shift_left:
+						case expression_operator::shift_right:
+							if (y < 0 || y > 31)
+								throw error("shift count must be between 0 and 31");
+
+							push({ .value = term.op == expression_operator::shift_left ? x << y : x >> y });
+							break;
+
+						default:
+							throw error("invalid binary operator");
+					}
+
+					break;
+				}
+			}
+		}
+
+		return stack.back();
+	}
+
+	arch::imm generator::fold_constant(std::span<const ast::expression_term> terms, arch::imm_format imm_width) const
+	{
+		const auto [value, base, base_kind] = fold(terms);
+		const auto where = locate(nodes->token_of(terms.front()));
+
+		if (base != NO_SYMBOL)
+			throw generator_exception::invalid_expression("expected a constant but got an address", where);
+
+		if (value < 0)
+			throw generator_exception::invalid_expression(std::format("negative value {}", value), where);
+
+		if (value >= (int64_t(1) << imm_width))
+			throw generator_exception::invalid_expression(
+				std::format("value {} is too big for expected operand format of {} bits", value, static_cast<int>(imm_width)),
+				where);
+
+		return static_cast<arch::imm>(value);
+	}
+
+	arch::opcode generator::encode_add(const ast::instruction_view& add)
 	{
 		ensure_operands_count(add, 2);
 
-		switch (make_operands_mask(add))
+		switch (add.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8_R8:
 				return arch::enc::_8XY4(
@@ -321,75 +869,75 @@ namespace chasm
 				return arch::enc::_FX1E(operand2reg(add.operands[1]));
 
 			default:
-				throw generator_exception::invalid_operand_type(add);
+				throw generator_exception::invalid_operand_type(add, locate(add.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_sub(const ast::instruction_statement& sub)
+	arch::opcode generator::encode_sub(const ast::instruction_view& sub)
 	{
 		ensure_operands_count(sub, 2);
 
-		if (make_operands_mask(sub) == arch::operands_mask::MASK_R8_R8)
+		if (sub.operands_mask == arch::operands_mask::MASK_R8_R8)
 			return arch::enc::_8XY5(
 					operand2reg(sub.operands[0]),
 					operand2reg(sub.operands[1]));
 
-		throw generator_exception::invalid_operand_type(sub);
+		throw generator_exception::invalid_operand_type(sub, locate(sub.mnemonic));
 	}
 
-	arch::opcode generator::encode_suba(const ast::instruction_statement& suba)
+	arch::opcode generator::encode_suba(const ast::instruction_view& suba)
 	{
 		ensure_operands_count(suba, 2);
 
-		if (make_operands_mask(suba) == arch::operands_mask::MASK_R8_R8)
+		if (suba.operands_mask == arch::operands_mask::MASK_R8_R8)
 			return arch::enc::_8XY7(
 					operand2reg(suba.operands[0]),
 					operand2reg(suba.operands[1]));
 
-		throw generator_exception::invalid_operand_type(suba);
+		throw generator_exception::invalid_operand_type(suba, locate(suba.mnemonic));
 	}
 
-	arch::opcode generator::encode_or(const ast::instruction_statement& or_)
+	arch::opcode generator::encode_or(const ast::instruction_view& or_)
 	{
 		ensure_operands_count(or_, 2);
 
-		if (make_operands_mask(or_) == arch::operands_mask::MASK_R8_R8)
+		if (or_.operands_mask == arch::operands_mask::MASK_R8_R8)
 			return arch::enc::_8XY1(
 					operand2reg(or_.operands[0]),
 					operand2reg(or_.operands[1]));
 
-		throw generator_exception::invalid_operand_type(or_);
+		throw generator_exception::invalid_operand_type(or_, locate(or_.mnemonic));
 	}
 
-	arch::opcode generator::encode_and(const ast::instruction_statement& and_)
+	arch::opcode generator::encode_and(const ast::instruction_view& and_)
 	{
 		ensure_operands_count(and_, 2);
 
-		if (make_operands_mask(and_) == arch::operands_mask::MASK_R8_R8)
+		if (and_.operands_mask == arch::operands_mask::MASK_R8_R8)
 			return arch::enc::_8XY2(
 					operand2reg(and_.operands[0]),
 					operand2reg(and_.operands[1]));
 
-		throw generator_exception::invalid_operand_type(and_);
+		throw generator_exception::invalid_operand_type(and_, locate(and_.mnemonic));
 	}
 
-	arch::opcode generator::encode_xor(const ast::instruction_statement& xor_)
+	arch::opcode generator::encode_xor(const ast::instruction_view& xor_)
 	{
 		ensure_operands_count(xor_, 2);
 
-		if (make_operands_mask(xor_) == arch::operands_mask::MASK_R8_R8)
+		if (xor_.operands_mask == arch::operands_mask::MASK_R8_R8)
 			return arch::enc::_8XY3(
 					operand2reg(xor_.operands[0]),
 					operand2reg(xor_.operands[1]));
 
-		throw generator_exception::invalid_operand_type(xor_);
+		throw generator_exception::invalid_operand_type(xor_, locate(xor_.mnemonic));
 	}
 
-	arch::opcode generator::encode_shr(const ast::instruction_statement& shr)
+	arch::opcode generator::encode_shr(const ast::instruction_view& shr)
 	{
 		ensure_operands_count(shr, { 1, 2 });
 
-		switch (make_operands_mask(shr))
+		switch (shr.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8:
 				return arch::enc::_8X06(operand2reg(shr.operands[0]));
@@ -400,15 +948,15 @@ namespace chasm
 						operand2reg(shr.operands[1]));
 
 			default:
-				throw generator_exception::invalid_operand_type(shr);
+				throw generator_exception::invalid_operand_type(shr, locate(shr.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_shl(const ast::instruction_statement& shl)
+	arch::opcode generator::encode_shl(const ast::instruction_view& shl)
 	{
 		ensure_operands_count(shl, { 1, 2 });
 
-		switch (make_operands_mask(shl))
+		switch (shl.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8:
 				return arch::enc::_8X0E(operand2reg(shl.operands[0]));
@@ -419,35 +967,35 @@ namespace chasm
 						operand2reg(shl.operands[1]));
 
 			default:
-				throw generator_exception::invalid_operand_type(shl);
+				throw generator_exception::invalid_operand_type(shl, locate(shl.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_rdump(const ast::instruction_statement& rdump)
+	arch::opcode generator::encode_rdump(const ast::instruction_view& rdump)
 	{
 		ensure_operands_count(rdump, 1);
 
-		if (make_operands_mask(rdump) == arch::operands_mask::MASK_R8)
+		if (rdump.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX55(operand2reg(rdump.operands[0]));
 
-		throw generator_exception::invalid_operand_type(rdump);
+		throw generator_exception::invalid_operand_type(rdump, locate(rdump.mnemonic));
 	}
 
-	arch::opcode generator::encode_rload(const ast::instruction_statement& rload)
+	arch::opcode generator::encode_rload(const ast::instruction_view& rload)
 	{
 		ensure_operands_count(rload, 1);
 
-		if (make_operands_mask(rload) == arch::operands_mask::MASK_R8)
+		if (rload.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX65(operand2reg(rload.operands[0]));
 
-		throw generator_exception::invalid_operand_type(rload);
+		throw generator_exception::invalid_operand_type(rload, locate(rload.mnemonic));
 	}
 
-	arch::opcode generator::encode_mov(const ast::instruction_statement& mov)
+	arch::opcode generator::encode_mov(const ast::instruction_view& mov)
 	{
 		ensure_operands_count(mov, 2);
 
-		switch (make_operands_mask(mov))
+		switch (mov.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8_R8: return arch::enc::_8XY0(operand2reg(mov.operands[0]), operand2reg(mov.operands[1]));
 			case arch::operands_mask::MASK_R8_IMM: return arch::enc::_6XNN(operand2reg(mov.operands[0]), operand2imm(mov.operands[1]));
@@ -457,21 +1005,19 @@ namespace chasm
 			case arch::operands_mask::MASK_AR_IMM: return arch::enc::_ANNN(operand2imm(mov.operands[1], arch::fmt_imm12));
 
 			case arch::operands_mask::MASK_AR_ADDR:
-			{
-				register_patch_location(mov.operands[1].operand.to_string());
+				register_address_patch(operand2address(mov.operands[1]));
 				return arch::enc::_ANNN(0);
-			}
 
 			default:
-				throw generator_exception::invalid_operand_type(mov);
+				throw generator_exception::invalid_operand_type(mov, locate(mov.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_draw(const ast::instruction_statement& draw)
+	arch::opcode generator::encode_draw(const ast::instruction_view& draw)
 	{
 		ensure_operands_count(draw, 3);
 
-		switch (make_operands_mask(draw))
+		switch (draw.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8_R8_IMM:
 			{
@@ -479,7 +1025,7 @@ namespace chasm
 				const auto regY = operand2reg(draw.operands[1]);
 				const auto imm4 = operand2imm(draw.operands[2], arch::fmt_imm4);
 
-				if (imm4 == 0 && !options::has_flag("super"))
+				if (imm4 == 0 && !options.super)
 					warn_super_instruction(draw);
 
 				return arch::enc::_DXYN(regX, regY, imm4);
@@ -498,108 +1044,110 @@ namespace chasm
 			}
 		}
 
-		throw generator_exception::invalid_operand_type(draw);
+		throw generator_exception::invalid_operand_type(draw, locate(draw.mnemonic));
 	}
 
-	arch::opcode generator::encode_cls(const ast::instruction_statement& cls)
+	arch::opcode generator::encode_cls(const ast::instruction_view& cls)
 	{
 		ensure_operands_count(cls, 0);
 		return 0x00E0;
 	}
 
-	arch::opcode generator::encode_rand(const ast::instruction_statement& rand)
+	arch::opcode generator::encode_rand(const ast::instruction_view& rand)
 	{
 		ensure_operands_count(rand, 2);
 
-		if (make_operands_mask(rand) == arch::operands_mask::MASK_R8_IMM)
+		if (rand.operands_mask == arch::operands_mask::MASK_R8_IMM)
 			return arch::enc::_CXNN(
 					operand2reg(rand.operands[0]),
 					operand2imm(rand.operands[1]));
 
-		throw generator_exception::invalid_operand_type(rand);
+		throw generator_exception::invalid_operand_type(rand, locate(rand.mnemonic));
 	}
 
-	arch::opcode generator::encode_bcd(const ast::instruction_statement& bcd)
+	arch::opcode generator::encode_bcd(const ast::instruction_view& bcd)
 	{
 		ensure_operands_count(bcd, 1);
 
-		if (make_operands_mask(bcd) == arch::operands_mask::MASK_R8)
+		if (bcd.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX33(operand2reg(bcd.operands[0]));
 
-		throw generator_exception::invalid_operand_type(bcd);
+		throw generator_exception::invalid_operand_type(bcd, locate(bcd.mnemonic));
 	}
 
-	arch::opcode generator::encode_wkey(const ast::instruction_statement& wkey)
+	arch::opcode generator::encode_wkey(const ast::instruction_view& wkey)
 	{
 		ensure_operands_count(wkey, 1);
 
-		if (make_operands_mask(wkey) == arch::operands_mask::MASK_R8)
+		if (wkey.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX0A(operand2reg(wkey.operands[0]));
 
-		throw generator_exception::invalid_operand_type(wkey);
+		throw generator_exception::invalid_operand_type(wkey, locate(wkey.mnemonic));
 	}
 
-	arch::opcode generator::encode_ske(const ast::instruction_statement& ske)
+	arch::opcode generator::encode_ske(const ast::instruction_view& ske)
 	{
 		ensure_operands_count(ske, 1);
 
-		if (make_operands_mask(ske) == arch::operands_mask::MASK_R8)
+		if (ske.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_EX9E(operand2reg(ske.operands[0]));
 
-		throw generator_exception::invalid_operand_type(ske);
+		throw generator_exception::invalid_operand_type(ske, locate(ske.mnemonic));
 	}
 
-	arch::opcode generator::encode_skne(const ast::instruction_statement& skne)
+	arch::opcode generator::encode_skne(const ast::instruction_view& skne)
 	{
 		ensure_operands_count(skne, 1);
 
-		if (make_operands_mask(skne) == arch::operands_mask::MASK_R8)
+		if (skne.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_EXA1(operand2reg(skne.operands[0]));
 
-		throw generator_exception::invalid_operand_type(skne);
+		throw generator_exception::invalid_operand_type(skne, locate(skne.mnemonic));
 	}
 
-	arch::opcode generator::encode_ret(const ast::instruction_statement& ret)
+	arch::opcode generator::encode_ret(const ast::instruction_view& ret)
 	{
 		ensure_operands_count(ret, 0);
 		return 0x00EE;
 	}
 
-	arch::opcode generator::encode_jmp(const ast::instruction_statement& jmp)
+	arch::opcode generator::encode_jmp(const ast::instruction_view& jmp)
 	{
 		ensure_operands_count(jmp, 1);
 
-		switch (make_operands_mask(jmp))
+		switch (jmp.operands_mask)
 		{
 			case arch::operands_mask::MASK_ADDR:
-				if (jmp.operands[0].is_label())
+				if (const auto target = operand2address(jmp.operands[0]); target.base_kind == ast::expression_term::kind::label)
 				{
 					// jmp @label
-					register_patch_location(current_proc_name + "." + jmp.operands[0].operand.to_string());
+					register_address_patch(target);
 
 					return arch::enc::_1NNN(0);
 				}
 
+				[[fallthrough]];
+
 			// jmp [offset]
 			case arch::operands_mask::MASK_ADDR_REL:
 				return arch::enc::_BNNN(operand2imm(jmp.operands[0], arch::fmt_imm12));
 
 			default:
-				throw generator_exception::invalid_operand_type(jmp);
+				throw generator_exception::invalid_operand_type(jmp, locate(jmp.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_call(const ast::instruction_statement& call)
+	arch::opcode generator::encode_call(const ast::instruction_view& call)
 	{
 		ensure_operands_count(call, 1);
 
-		switch (make_operands_mask(call))
+		switch (call.operands_mask)
 		{
 			case arch::operands_mask::MASK_ADDR:
-				if (call.operands[0].is_procedure())
+				if (const auto target = operand2address(call.operands[0]); target.base_kind == ast::expression_term::kind::procedure)
 				{
 					// call $function
-					register_patch_location(call.operands[0].operand.to_string());
+					register_address_patch(target);
 
 					return arch::enc::_2NNN(0);
 				}
@@ -608,14 +1156,14 @@ namespace chasm
 				break;
 		}
 
-		throw generator_exception::invalid_operand_type(call);
+		throw generator_exception::invalid_operand_type(call, locate(call.mnemonic));
 	}
 
-	arch::opcode generator::encode_se(const ast::instruction_statement& se)
+	arch::opcode generator::encode_se(const ast::instruction_view& se)
 	{
 		ensure_operands_count(se, 2);
 
-		switch (make_operands_mask(se))
+		switch (se.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8_R8:
 				return arch::enc::_5XY0(
@@ -628,15 +1176,15 @@ namespace chasm
 						operand2imm(se.operands[1]));
 
 			default:
-				throw generator_exception::invalid_operand_type(se);
+				throw generator_exception::invalid_operand_type(se, locate(se.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_sne(const ast::instruction_statement& sne)
+	arch::opcode generator::encode_sne(const ast::instruction_view& sne)
 	{
 		ensure_operands_count(sne, 2);
 
-		switch (make_operands_mask(sne))
+		switch (sne.operands_mask)
 		{
 			case arch::operands_mask::MASK_R8_R8:
 				return arch::enc::_9XY0(
@@ -649,105 +1197,105 @@ namespace chasm
 						operand2imm(sne.operands[1]));
 
 			default:
-				throw generator_exception::invalid_operand_type(sne);
+				throw generator_exception::invalid_operand_type(sne, locate(sne.mnemonic));
 		}
 	}
 
-	arch::opcode generator::encode_inc(const ast::instruction_statement& inc)
+	arch::opcode generator::encode_inc(const ast::instruction_view& inc)
 	{
 		ensure_operands_count(inc, 1);
 
-		if (make_operands_mask(inc) == arch::operands_mask::MASK_R8)
+		if (inc.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_7XNN(operand2reg(inc.operands[0]), 1);
 
-		throw generator_exception::invalid_operand_type(inc);
+		throw generator_exception::invalid_operand_type(inc, locate(inc.mnemonic));
 	}
 
-	arch::opcode generator::encode_ldf(const ast::instruction_statement& ldf)
+	arch::opcode generator::encode_ldf(const ast::instruction_view& ldf)
 	{
 		ensure_operands_count(ldf, 1);
 
-		if (make_operands_mask(ldf) == arch::operands_mask::MASK_R8)
+		if (ldf.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX29(operand2reg(ldf.operands[0]));
 
-		throw generator_exception::invalid_operand_type(ldf);
+		throw generator_exception::invalid_operand_type(ldf, locate(ldf.mnemonic));
 	}
 
-	arch::opcode generator::encode_exit(const ast::instruction_statement& exit)
+	arch::opcode generator::encode_exit(const ast::instruction_view& exit)
 	{
 		ensure_operands_count(exit, 0);
 		return 0x00FD;
 	}
 
-	arch::opcode generator::encode_scrd(const ast::instruction_statement& scrd)
+	arch::opcode generator::encode_scrd(const ast::instruction_view& scrd)
 	{
 		ensure_operands_count(scrd, 1);
 
-		if (make_operands_mask(scrd) == arch::operands_mask::MASK_IMM)
+		if (scrd.operands_mask == arch::operands_mask::MASK_IMM)
 			return arch::enc::_00CN(operand2imm(scrd.operands[0], arch::fmt_imm4));
 
-		throw generator_exception::invalid_operand_type(scrd);
+		throw generator_exception::invalid_operand_type(scrd, locate(scrd.mnemonic));
 	}
 
-	arch::opcode generator::encode_scrl(const ast::instruction_statement& scrl)
+	arch::opcode generator::encode_scrl(const ast::instruction_view& scrl)
 	{
 		ensure_operands_count(scrl, 0);
 		return 0x00FC;
 	}
 
-	arch::opcode generator::encode_scrr(const ast::instruction_statement& scrr)
+	arch::opcode generator::encode_scrr(const ast::instruction_view& scrr)
 	{
 		ensure_operands_count(scrr, 0);
 		return 0x00FB;
 	}
 
-	arch::opcode generator::encode_high(const ast::instruction_statement& high)
+	arch::opcode generator::encode_high(const ast::instruction_view& high)
 	{
 		ensure_operands_count(high, 0);
 		return 0x00FF;
 	}
 
-	arch::opcode generator::encode_low(const ast::instruction_statement& low)
+	arch::opcode generator::encode_low(const ast::instruction_view& low)
 	{
 		ensure_operands_count(low, 0);
 		return 0x00FE;
 	}
 
-	arch::opcode generator::encode_ldfs(const ast::instruction_statement& ldfs)
+	arch::opcode generator::encode_ldfs(const ast::instruction_view& ldfs)
 	{
 		ensure_operands_count(ldfs, 1);
 
-		if (make_operands_mask(ldfs) == arch::operands_mask::MASK_R8)
+		if (ldfs.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX30(operand2reg(ldfs.operands[0]));
 
-		throw generator_exception::invalid_operand_type(ldfs);
+		throw generator_exception::invalid_operand_type(ldfs, locate(ldfs.mnemonic));
 	}
 
-	arch::opcode generator::encode_saverpl(const ast::instruction_statement& saverpl)
+	arch::opcode generator::encode_saverpl(const ast::instruction_view& saverpl)
 	{
 		ensure_operands_count(saverpl, 1);
 
-		if (make_operands_mask(saverpl) == arch::operands_mask::MASK_R8)
+		if (saverpl.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX75(operand2reg(saverpl.operands[0]));
 
-		throw generator_exception::invalid_operand_type(saverpl);
+		throw generator_exception::invalid_operand_type(saverpl, locate(saverpl.mnemonic));
 	}
 
-	arch::opcode generator::encode_loadrpl(const ast::instruction_statement& loadrpl)
+	arch::opcode generator::encode_loadrpl(const ast::instruction_view& loadrpl)
 	{
 		ensure_operands_count(loadrpl, 1);
 
-		if (make_operands_mask(loadrpl) == arch::operands_mask::MASK_R8)
+		if (loadrpl.operands_mask == arch::operands_mask::MASK_R8)
 			return arch::enc::_FX85(operand2reg(loadrpl.operands[0]));
 
-		throw generator_exception::invalid_operand_type(loadrpl);
+		throw generator_exception::invalid_operand_type(loadrpl, locate(loadrpl.mnemonic));
 	}
 
-	std::vector<arch::opcode> generator::encode_swp(const ast::instruction_statement& swp)
+	std::vector<arch::opcode> generator::encode_swp(const ast::instruction_view& swp)
 	{
 		ensure_operands_count(swp, 2);
 
-		if (make_operands_mask(swp) == arch::operands_mask::MASK_R8_R8)
+		if (swp.operands_mask == arch::operands_mask::MASK_R8_R8)
 		{
 			std::vector<arch::opcode> opcodes;
 
@@ -766,6 +1314,6 @@ namespace chasm
 			return opcodes;
 		}
 
-		throw generator_exception::invalid_operand_type(swp);
+		throw generator_exception::invalid_operand_type(swp, locate(swp.mnemonic));
 	}
 }
\ No newline at end of file
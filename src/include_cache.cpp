@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <chrono>
+
+#include <chasm/include_cache.hpp>
+#include <chasm/mapped_file.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		constexpr auto STAMP_RESOLUTION = std::chrono::seconds(2);
+
+		[[nodiscard]]
+		bool unchanged(const include_dependency& dependency)
+		{
+			if (!std::filesystem::is_regular_file(dependency.path))
+				return false;
+
+			return include_cache::content_hash(mapped_file(dependency.path).bytes()) == dependency.content_hash;
+		}
+	}
+
+	parsed_include::parsed_include(std::filesystem::path file_path, uint64_t hash, std::string&& text)
+		: path(std::move(file_path)),
+		  content_hash(hash),
+		  source(std::move(text))
+	{}
+
+	include_cache::include_cache(const include_cache_limits& cache_limits)
+		: limits(cache_limits)
+	{}
+
+	uint64_t include_cache::content_hash(std::span<const uint8_t> content)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (const uint8_t byte : content)
+			hash = (hash ^ byte) * 1099511628211ull;
+
+		return hash;
+	}
+
+	std::shared_ptr<const parsed_include> include_cache::parse(const std::filesystem::path& path,
+															   std::span<const std::filesystem::path> including)
+	{
+		const auto file = std::filesystem::weakly_canonical(path);
+
+		if (std::ranges::contains(including, file))
+			throw include_exception::circular_include(file);
+
+		if (!std::filesystem::is_regular_file(file))
+			throw include_exception::file_not_found(path);
+
+		const auto mapped = mapped_file(file);
+		const auto text = std::string_view(mapped.text().data(), mapped.text().size());
+		const auto hash = content_hash(mapped.bytes());
+
+		std::shared_ptr<const parsed_include> cached;
+
+		{
+			std::scoped_lock lock(guard);
+
+			if (const auto found = entries.find(file.string()); found != entries.end())
+			{
+				cached = found->second.include;
+				found->second.last_use = ++use_clock;
+			}
+		}
+
+		//
+		// Files the cached entry includes are read without holding the lock,
+		// the entry is only used while none of them changed
+		//
+		if (cached && cached->content_hash == hash && std::ranges::all_of(cached->dependencies, unchanged))
+		{
+			// a cached file may include one of the files including it now
+			for (const auto& dependency : cached->dependencies)
+				if (std::ranges::contains(including, dependency.path))
+					throw include_exception::circular_include(dependency.path);
+
+			return cached;
+		}
+
+		//
+		// Parsed without holding the lock, the files it includes go through the cache too
+		//
+		auto entry = std::make_shared<parsed_include>(file, hash, std::string(text));
+
+		std::vector<std::filesystem::path> chain(including.begin(), including.end());
+		chain.push_back(file);
+
+		try
+		{
+			auto lex = lexer(entry->source.text());
+			auto parse = parser(lex);
+
+			parse.resolve_includes(std::move(chain), this);
+			parse.parse_included(*entry);
+		}
+		catch (const std::runtime_error& error)
+		{
+			throw include_exception::error_in_file(file, error.what());
+		}
+
+		const auto bytes = entry->source.text().size();
+
+		std::scoped_lock lock(guard);
+
+		auto& cached_entry = entries[file.string()];
+
+		held_bytes = held_bytes - (cached_entry.include ? cached_entry.bytes : 0) + bytes;
+		cached_entry = { entry, bytes, ++use_clock };
+
+		evict();
+
+		return entry;
+	}
+
+	loaded_module include_cache::load_module(const std::filesystem::path& path)
+	{
+		const auto file = std::filesystem::weakly_canonical(path);
+
+		std::error_code error;
+		const auto stamp = file_stamp {
+			.size = std::filesystem::is_regular_file(file, error) ? std::filesystem::file_size(file, error) : 0,
+			.modified = std::filesystem::last_write_time(file, error)
+		};
+
+		if (error || !std::filesystem::is_regular_file(file))
+			throw include_exception::file_not_found(path);
+
+		const auto key = file.string();
+		const auto now = std::filesystem::file_time_type::clock::now();
+
+		{
+			std::scoped_lock lock(guard);
+
+			//
+			// A file written again within the resolution of its modification time keeps the same stamp,
+			// the stamp of a file modified that close to when it was taken is not trusted
+			//
+			if (const auto found = modules.find(key);
+				found != modules.end() && found->second.stamp == stamp && stamp.modified + STAMP_RESOLUTION < found->second.stamped_at)
+			{
+				found->second.last_use = ++use_clock;
+
+				return { found->second.module, found->second.content_hash };
+			}
+		}
+
+		const auto hash = content_hash(mapped_file(file).bytes());
+
+		std::shared_ptr<const precompiled_module> module;
+
+		{
+			std::scoped_lock lock(guard);
+
+			if (const auto found = modules.find(key); found != modules.end() && found->second.content_hash == hash)
+				module = found->second.module;
+		}
+
+		// the module loaded first is kept as long as the content is the same
+		if (!module)
+			module = std::make_shared<const precompiled_module>(file);
+
+		std::scoped_lock lock(guard);
+
+		auto& cached = modules[key];
+
+		if (cached.module != module)
+		{
+			const auto bytes = module->bytes().size();
+
+			held_bytes = held_bytes - (cached.module ? cached.bytes : 0) + bytes;
+			cached.module = module;
+			cached.content_hash = hash;
+			cached.bytes = bytes;
+		}
+
+		cached.stamp = stamp;
+		cached.stamped_at = now;
+		cached.last_use = ++use_clock;
+
+		evict();
+
+		return { module, hash };
+	}
+
+	void include_cache::evict()
+	{
+		const auto over_limits = [this]
+		{
+			return (limits.max_entries && entries.size() + modules.size() > limits.max_entries) ||
+				   (limits.max_bytes && held_bytes > limits.max_bytes);
+		};
+
+		while (over_limits())
+		{
+			auto oldest_include = std::ranges::min_element(entries, {}, [](const auto& entry) { return entry.second.last_use; });
+			auto oldest_module = std::ranges::min_element(modules, {}, [](const auto& entry) { return entry.second.last_use; });
+
+			if (oldest_module == modules.end() ||
+				(oldest_include != entries.end() && oldest_include->second.last_use < oldest_module->second.last_use))
+			{
+				held_bytes -= oldest_include->second.bytes;
+				entries.erase(oldest_include);
+			}
+			else
+			{
+				held_bytes -= oldest_module->second.bytes;
+				modules.erase(oldest_module);
+			}
+
+			++evicted;
+		}
+	}
+
+	size_t include_cache::size() const
+	{
+		std::scoped_lock lock(guard);
+
+		return entries.size() + modules.size();
+	}
+
+	void include_cache::clear()
+	{
+		std::scoped_lock lock(guard);
+
+		entries.clear();
+		modules.clear();
+		held_bytes = 0;
+	}
+
+	size_t include_cache::bytes() const
+	{
+		std::scoped_lock lock(guard);
+
+		return held_bytes;
+	}
+
+	uint64_t include_cache::evictions() const
+	{
+		std::scoped_lock lock(guard);
+
+		return evicted;
+	}
+}
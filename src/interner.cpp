@@ -0,0 +1,39 @@
+#include <chasm/interner.hpp>
+#include <chasm/chasm_exception.hpp>
+
+
+namespace chasm
+{
+	symbol_id interner::intern(std::string_view name)
+	{
+		if (const auto it = ids.find(name); it != ids.end())
+			return it->second;
+
+		if (names.size() >= NO_SYMBOL)
+			throw chasm_exception("Too many distinct symbols, at most {} are supported.", NO_SYMBOL);
+
+		const auto id = static_cast<symbol_id>(names.size());
+
+		ids.emplace(names.emplace_back(name), id);
+
+		return id;
+	}
+
+	std::optional<symbol_id> interner::find(std::string_view name) const
+	{
+		if (const auto it = ids.find(name); it != ids.end())
+			return it->second;
+
+		return std::nullopt;
+	}
+
+	std::string_view interner::name(symbol_id id) const
+	{
+		return names.at(id);
+	}
+
+	size_t interner::size() const
+	{
+		return names.size();
+	}
+}
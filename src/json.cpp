@@ -0,0 +1,429 @@
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <cmath>
+
+#include <chasm/json.hpp>
+
+
+namespace chasm::json
+{
+	namespace
+	{
+		// nesting deeper than this is refused instead of exhausting the stack
+		constexpr size_t MAX_DEPTH = 64;
+
+		class reader
+		{
+		public:
+			explicit reader(std::string_view json_text)
+				: text(json_text)
+			{}
+
+			value read_document()
+			{
+				auto document = read_value(0);
+
+				skip_whitespace();
+
+				if (at != text.size())
+					fail("unexpected content after the value");
+
+				return document;
+			}
+
+		private:
+			[[noreturn]] void fail(std::string_view reason) const
+			{
+				throw json_exception::invalid_json(at, reason);
+			}
+
+			void skip_whitespace()
+			{
+				while (at < text.size() && (text[at] == ' ' || text[at] == '\t' || text[at] == '\n' || text[at] == '\r'))
+					++at;
+			}
+
+			[[nodiscard]] char peek()
+			{
+				skip_whitespace();
+
+				if (at == text.size())
+					fail("unexpected end of input");
+
+				return text[at];
+			}
+
+			void expect(char c)
+			{
+				if (peek() != c)
+					fail(std::format("expected '{}'", c));
+
+				++at;
+			}
+
+			bool consume(std::string_view literal)
+			{
+				if (!text.substr(at).starts_with(literal))
+					return false;
+
+				at += literal.size();
+				return true;
+			}
+
+			value read_value(size_t depth)
+			{
+				if (depth > MAX_DEPTH)
+					fail("too deeply nested");
+
+				switch (peek())
+				{
+					case '{': return read_object(depth);
+					case '[': return read_array(depth);
+					case '"': return value(read_string());
+
+					default:
+						break;
+				}
+
+				if (consume("true"))
+					return value(true);
+
+				if (consume("false"))
+					return value(false);
+
+				if (consume("null"))
+					return value();
+
+				return value(read_number());
+			}
+
+			value read_object(size_t depth)
+			{
+				value::object members;
+
+				expect('{');
+
+				if (peek() == '}')
+				{
+					++at;
+					return value(std::move(members));
+				}
+
+				while (true)
+				{
+					if (peek() != '"')
+						fail("expected a key");
+
+					auto key = read_string();
+					expect(':');
+
+					members.insert_or_assign(std::move(key), read_value(depth + 1));
+
+					if (peek() != ',')
+						break;
+
+					++at;
+				}
+
+				expect('}');
+
+				return value(std::move(members));
+			}
+
+			value read_array(size_t depth)
+			{
+				value::array elements;
+
+				expect('[');
+
+				if (peek() == ']')
+				{
+					++at;
+					return value(std::move(elements));
+				}
+
+				while (true)
+				{
+					elements.push_back(read_value(depth + 1));
+
+					if (peek() != ',')
+						break;
+
+					++at;
+				}
+
+				expect(']');
+
+				return value(std::move(elements));
+			}
+
+			double read_number()
+			{
+				const auto begin = text.data() + at;
+				const auto end = text.data() + text.size();
+
+				// JSON allows neither a leading '+' nor leading zeros, from_chars is not as strict
+				if (*begin == '+' || (begin[0] == '0' && begin + 1 < end && begin[1] >= '0' && begin[1] <= '9'))
+					fail("invalid number");
+
+				double number {};
+				const auto [stop, error] = std::from_chars(begin, end, number);
+
+				if (error != std::errc() || !std::isfinite(number))
+					fail("invalid value");
+
+				at += static_cast<size_t>(stop - begin);
+
+				return number;
+			}
+
+			uint32_t read_hex4()
+			{
+				uint32_t code {};
+
+				if (at + 4 > text.size() || std::from_chars(text.data() + at, text.data() + at + 4, code, 16).ptr != text.data() + at + 4)
+					fail("invalid \\u escape");
+
+				at += 4;
+				return code;
+			}
+
+			void append_utf8(std::string& string, uint32_t code)
+			{
+				if (code < 0x80)
+					string += static_cast<char>(code);
+				else if (code < 0x800)
+				{
+					string += static_cast<char>(0xC0 | code >> 6);
+					string += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000)
+				{
+					string += static_cast<char>(0xE0 | code >> 12);
+					string += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+					string += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					string += static_cast<char>(0xF0 | code >> 18);
+					string += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+					string += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+					string += static_cast<char>(0x80 | (code & 0x3F));
+				}
+			}
+
+			std::string read_string()
+			{
+				std::string string;
+
+				expect('"');
+
+				while (true)
+				{
+					if (at == text.size())
+						fail("unterminated string");
+
+					const char c = text[at++];
+
+					if (c == '"')
+						return string;
+
+					if (static_cast<unsigned char>(c) < 0x20)
+						fail("control character in string");
+
+					if (c != '\\')
+					{
+						string += c;
+						continue;
+					}
+
+					if (at == text.size())
+						fail("unterminated string");
+
+					switch (text[at++])
+					{
+						case '"':  string += '"';  break;
+						case '\\': string += '\\'; break;
+						case '/':  string += '/';  break;
+						case 'b':  string += '\b'; break;
+						case 'f':  string += '\f'; break;
+						case 'n':  string += '\n'; break;
+						case 'r':  string += '\r'; break;
+						case 't':  string += '\t'; break;
+
+						case 'u':
+						{
+							auto code = read_hex4();
+
+							// characters outside of the BMP are escaped as a surrogate pair
+							if (code >= 0xD800 && code < 0xDC00)
+							{
+								if (!consume("\\u"))
+									fail("unpaired surrogate");
+
+								const auto low = read_hex4();
+
+								if (low < 0xDC00 || low >= 0xE000)
+									fail("unpaired surrogate");
+
+								code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+							}
+							else if (code >= 0xDC00 && code < 0xE000)
+								fail("unpaired surrogate");
+
+							append_utf8(string, code);
+							break;
+						}
+
+						default:
+							fail("invalid escape");
+					}
+				}
+			}
+
+		private:
+			std::string_view text;
+			size_t at {};
+		};
+	}
+
+	value::value(bool boolean)
+		: storage(boolean)
+	{}
+
+	value::value(double number)
+		: storage(number)
+	{}
+
+	value::value(std::string string)
+		: storage(std::move(string))
+	{}
+
+	value::value(array elements)
+		: storage(std::make_shared<const array>(std::move(elements)))
+	{}
+
+	value::value(object members)
+		: storage(std::make_shared<const object>(std::move(members)))
+	{}
+
+	bool value::is_null() const
+	{
+		return std::holds_alternative<std::monostate>(storage);
+	}
+
+	bool value::is_bool() const
+	{
+		return std::holds_alternative<bool>(storage);
+	}
+
+	bool value::is_number() const
+	{
+		return std::holds_alternative<double>(storage);
+	}
+
+	bool value::is_string() const
+	{
+		return std::holds_alternative<std::string>(storage);
+	}
+
+	bool value::is_array() const
+	{
+		return std::holds_alternative<std::shared_ptr<const array>>(storage);
+	}
+
+	bool value::is_object() const
+	{
+		return std::holds_alternative<std::shared_ptr<const object>>(storage);
+	}
+
+	bool value::as_bool() const
+	{
+		if (!is_bool())
+			throw json_exception::type_mismatch("boolean");
+
+		return std::get<bool>(storage);
+	}
+
+	double value::as_number() const
+	{
+		if (!is_number())
+			throw json_exception::type_mismatch("number");
+
+		return std::get<double>(storage);
+	}
+
+	const std::string& value::as_string() const
+	{
+		if (!is_string())
+			throw json_exception::type_mismatch("string");
+
+		return std::get<std::string>(storage);
+	}
+
+	const value::array& value::as_array() const
+	{
+		if (!is_array())
+			throw json_exception::type_mismatch("array");
+
+		return *std::get<std::shared_ptr<const array>>(storage);
+	}
+
+	const value::object& value::as_object() const
+	{
+		if (!is_object())
+			throw json_exception::type_mismatch("object");
+
+		return *std::get<std::shared_ptr<const object>>(storage);
+	}
+
+	const value* value::find(std::string_view key) const
+	{
+		if (!is_object())
+			return nullptr;
+
+		const auto& members = as_object();
+		const auto member = members.find(key);
+
+		return member != members.end() ? &member->second : nullptr;
+	}
+
+	value parse(std::string_view text)
+	{
+		return reader(text).read_document();
+	}
+
+	void append_string(std::string& json, std::string_view text)
+	{
+		json += '"';
+
+		for (const char c : text)
+		{
+			switch (c)
+			{
+				case '"':  json += "\\\""; break;
+				case '\\': json += "\\\\"; break;
+				case '\n': json += "\\n";  break;
+				case '\r': json += "\\r";  break;
+				case '\t': json += "\\t";  break;
+
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+						json += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+					else
+						json += c;
+			}
+		}
+
+		json += '"';
+	}
+
+	std::string to_string(double number)
+	{
+		if (number == std::trunc(number) && std::abs(number) < 1e15)
+			return std::format("{}", static_cast<int64_t>(number));
+
+		return std::format("{}", number);
+	}
+}
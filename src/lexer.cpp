@@ -1,8 +1,11 @@
-#include <unordered_set>
-#include <unordered_map>
-#include <fstream>
+#include <exception>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <array>
 
 #include <chasm/lexer.hpp>
+#include <chasm/scan.hpp>
 #include <chasm/log.hpp>
 
 
@@ -10,20 +13,174 @@ namespace chasm
 {
     namespace
     {
-		template<typename KeyType>
-		using lexeme_map = std::unordered_map<KeyType, token_type>;
-
-        const lexeme_map<std::string_view> keywords = {
-				{ "define", token_type::keyword_define     },
-				{ "config", token_type::keyword_config     },
-				{ "default", token_type::keyword_default   },
-				{ "sprite", token_type::keyword_sprite     },
-				{ "raw",    token_type::keyword_raw        },
-				{ "proc",   token_type::keyword_proc_start },
-				{ "endp",   token_type::keyword_proc_end   }
+		constexpr std::pair<std::string_view, token_type> keywords[] = {
+				{ "define",  token_type::keyword_define     },
+				{ "config",  token_type::keyword_config     },
+				{ "default", token_type::keyword_default    },
+				{ "sprite",  token_type::keyword_sprite     },
+				{ "raw",     token_type::keyword_raw        },
+				{ "proc",    token_type::keyword_proc_start },
+				{ "endp",    token_type::keyword_proc_end   },
+				{ "include", token_type::keyword_include    }
 		};
 
-		const lexeme_map<char> special_characters = {
+		//
+		// Every lexeme that is not an identifier: mnemonics carry their arch::instruction_id
+		// as value and registers their arch::register_id
+		//
+		struct reserved_word
+		{
+			std::string_view lexeme;
+			token_type type;
+			uint16_t value;
+		};
+
+		constexpr auto reserved_words = []
+		{
+			std::array<reserved_word, arch::mnemonics.size() + std::size(keywords) + arch::register_names.size()> words {};
+			size_t i = 0;
+
+			for (size_t id = 0; id < arch::mnemonics.size(); ++id)
+				words[i++] = { arch::mnemonics[id], token_type::instruction, static_cast<uint16_t>(id) };
+
+			for (const auto& [keyword, type] : keywords)
+				words[i++] = { keyword, type, 0 };
+
+			for (size_t id = 0; id < arch::register_names.size(); ++id)
+				words[i++] = { arch::register_names[id], token_type::register_name, static_cast<uint16_t>(id) };
+
+			return words;
+		}();
+
+		//
+		// Perfect hash of the reserved words: a seeded FNV-1a whose top bits index a slot table,
+		// the seed is searched at compile time so that no two reserved words share a slot.
+		//
+		constexpr uint32_t RESERVED_HASH_BITS = 9;
+		constexpr uint8_t  EMPTY_SLOT = 0xFF;
+
+		static_assert(reserved_words.size() < EMPTY_SLOT);
+
+		constexpr uint32_t reserved_hash(std::string_view lexeme, uint32_t seed)
+		{
+			uint32_t hash = 2166136261u ^ seed;
+
+			for (const char c : lexeme)
+				hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+
+			return hash >> (32 - RESERVED_HASH_BITS);
+		}
+
+		struct reserved_hash_table
+		{
+			uint32_t seed;
+			std::array<uint8_t, 1u << RESERVED_HASH_BITS> slots;
+		};
+
+		constexpr auto reserved_table = []
+		{
+			reserved_hash_table table {};
+
+			for (table.seed = 0; table.seed < 1024; ++table.seed)
+			{
+				table.slots.fill(EMPTY_SLOT);
+
+				bool collision = false;
+
+				for (size_t i = 0; i < reserved_words.size() && !collision; ++i)
+				{
+					auto& slot = table.slots[reserved_hash(reserved_words[i].lexeme, table.seed)];
+
+					collision = slot != EMPTY_SLOT;
+					slot = static_cast<uint8_t>(i);
+				}
+
+				if (!collision)
+					return table;
+			}
+
+			throw "No perfect hash seed found for the reserved words, increase RESERVED_HASH_BITS";
+		}();
+
+		constexpr reserved_word classify_lexeme(std::string_view lexeme)
+		{
+			const auto slot = reserved_table.slots[reserved_hash(lexeme, reserved_table.seed)];
+
+			if (slot != EMPTY_SLOT && reserved_words[slot].lexeme == lexeme)
+				return reserved_words[slot];
+
+			return { lexeme, token_type::identifier, 0 };
+		}
+
+		static_assert(classify_lexeme("loadrpl").value == arch::instruction_id::LOADRPL);
+		static_assert(classify_lexeme("rf").value == 0xF);
+		static_assert(classify_lexeme("st").value == arch::register_id::REG_ST);
+		static_assert(classify_lexeme("endp").type == token_type::keyword_proc_end);
+		static_assert(classify_lexeme("rg").type == token_type::identifier);
+
+		//
+		// Every byte of the source is classified through a single lookup in this table,
+		// next_token() then dispatches on the class instead of chaining ctype calls.
+		//
+		enum class char_class : uint8_t
+		{
+			invalid,
+			whitespace,
+			comment,
+			digit,
+			alpha,
+			underscore,
+			quote,
+			double_quote,
+			punctuation,
+			shift        // first character of << and >>
+		};
+
+		struct char_traits
+		{
+			char_class cls   = char_class::invalid;
+
+			// digit value in base 16 for [0-9a-fA-F], 0xFF for anything else
+			uint8_t digit    = 0xFF;
+
+			// token type for single character tokens
+			token_type token = token_type::eof;
+
+			// expression_operator of operator signs
+			uint8_t value    = 0;
+		};
+
+		constexpr auto char_table = []
+		{
+			std::array<char_traits, 256> table {};
+
+			for (const char c : std::string_view(" \t\n\v\f\r"))
+				table[static_cast<unsigned char>(c)].cls = char_class::whitespace;
+
+			for (size_t c = 'a'; c <= 'z'; ++c)
+			{
+				table[c].cls = char_class::alpha;
+				table[c - 'a' + 'A'].cls = char_class::alpha;
+			}
+
+			for (size_t c = '0'; c <= '9'; ++c)
+			{
+				table[c].cls   = char_class::digit;
+				table[c].digit = static_cast<uint8_t>(c - '0');
+			}
+
+			for (size_t c = 'a'; c <= 'f'; ++c)
+			{
+				table[c].digit = static_cast<uint8_t>(c - 'a' + 0xA);
+				table[c - 'a' + 'A'].digit = static_cast<uint8_t>(c - 'a' + 0xA);
+			}
+
+			table[';'].cls  = char_class::comment;
+			table['_'].cls  = char_class::underscore;
+			table['\''].cls = char_class::quote;
+			table['"'].cls  = char_class::double_quote;
+
+			const std::pair<char, token_type> punctuations[] = {
 				{ '[', token_type::bracket_open      },
 				{ ']', token_type::bracket_close     },
 				{ '(', token_type::parenthesis_open  },
@@ -35,70 +192,126 @@ namespace chasm
 				{ ':', token_type::colon             },
 				{ ',', token_type::comma             },
 				{ '=', token_type::equal             }
-		};
+			};
 
-		bool is_lexeme_reg(std::string_view lexeme)
-		{
-			if (lexeme == "ar" || lexeme == "dt" || lexeme == "st")
-				return true;
-
-			if (lexeme.empty() || lexeme.size() > 2)
-				return false;
-
-			// r + hex digit
-			return lexeme[0] == 'r' &&
-			     ((lexeme[1] >= '0' && lexeme[1] <= '9') ||
-				  (lexeme[1] >= 'a' && lexeme[1] <= 'f'));
-		}
-
-        token_type map_token_type(std::string_view lexeme)
-        {
-            if (is_lexeme_reg(lexeme))
-                return token_type::register_name;
+			for (const auto& [c, type] : punctuations)
+			{
+				table[static_cast<unsigned char>(c)].cls   = char_class::punctuation;
+				table[static_cast<unsigned char>(c)].token = type;
+			}
 
-            if (arch::has_mnemonic(lexeme))
-                return token_type::instruction;
+			const std::pair<char, expression_operator> operators[] = {
+				{ '+', expression_operator::add         },
+				{ '-', expression_operator::subtract    },
+				{ '*', expression_operator::multiply    },
+				{ '/', expression_operator::divide      },
+				{ '%', expression_operator::modulo      },
+				{ '&', expression_operator::bit_and     },
+				{ '|', expression_operator::bit_or      },
+				{ '^', expression_operator::bit_xor     },
+				{ '~', expression_operator::bit_not     },
+				{ '<', expression_operator::shift_left  },
+				{ '>', expression_operator::shift_right }
+			};
+
+			for (const auto& [c, op] : operators)
+			{
+				table[static_cast<unsigned char>(c)].cls   = char_class::punctuation;
+				table[static_cast<unsigned char>(c)].token = token_type::operator_sign;
+				table[static_cast<unsigned char>(c)].value = std::to_underlying(op);
+			}
 
-			if (keywords.contains(lexeme))
-				return keywords.at(lexeme);
+			table['<'].cls = char_class::shift;
+			table['>'].cls = char_class::shift;
 
-			return token_type::identifier;
-        }
+			return table;
+		}();
 
-		bool base_has_digit(int base, char digit)
+		constexpr const char_traits& traits_of(char c)
 		{
-			if (base == 10 &&  digit >= '0' && digit <= '9')  return true;
-			if (base ==  8 &&  digit >= '0' && digit <= '7')  return true;
-			if (base ==  2 && (digit == '0' || digit == '1')) return true;
-
-			digit = static_cast<char>(std::tolower(digit));
+			return char_table[static_cast<unsigned char>(c)];
+		}
 
-			if (base == 16 && ((digit >= '0' && digit<= '9') || (digit>= 'a' && digit <= 'f')))
-				return true;
+		constexpr bool is_alnum(char c)
+		{
+			const auto cls = traits_of(c).cls;
+			return cls == char_class::alpha || cls == char_class::digit;
+		}
 
-			return false;
+		constexpr bool base_has_digit(int base, char digit)
+		{
+			return traits_of(digit).digit < base;
 		}
+
+		//
+		// Below this amount of bytes per job, starting a thread costs more than lexing the chunk
+		//
+		constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
     }
 
 	lexer::lexer(std::string&& buff)
 		: istream(std::move(buff))
 	{}
 
-	token lexer::make_token(token_type type, std::string lexeme) const
+	lexer::lexer(const char* buff)
+		: istream(std::string(buff))
+	{}
+
+	lexer::lexer(std::span<const char> source)
+		: istream(source)
+	{}
+
+	lexer::lexer(std::span<const char> source, size_t range_begin, size_t range_end)
+		: istream(source, range_begin, range_end)
+	{}
+
+	lexer::~lexer()
+	{
+		// unblocks the lexing thread if it waits for room in the ring, it is joined right after
+		if (lexed_concurrently)
+			lexed_concurrently->close();
+	}
+
+	token lexer::make_token(token_type type, size_t lexeme_start, uint16_t value) const
+	{
+		return {
+			.type = type,
+			.value = value,
+			.offset = static_cast<source_offset>(lexeme_start),
+			.lexeme = istream.slice(lexeme_start)
+		};
+	}
+
+	token lexer::make_numerical_token(arch::size_type numerical_value, size_t lexeme_start) const
 	{
-		source_location source_loc = cursor;
-		source_loc.step_back(lexeme.size());
+		return make_token(token_type::numerical, lexeme_start, numerical_value);
+	}
+
+	const chasm::stream& lexer::source() const
+	{
+		return istream;
+	}
 
-		return { .type = type, .source_location = source_loc, .data = std::move(lexeme) };
+	chasm::stream& lexer::source()
+	{
+		return istream;
+	}
+
+	source_location lexer::locate(const token& token) const
+	{
+		return istream.locate(token.offset);
 	}
 
-	token lexer::make_numerical_token(arch::size_type numerical_value) const
+	source_location lexer::cursor() const
 	{
-		return { .type = token_type::numerical, .source_location = cursor, .data = numerical_value };
+		return istream.locate(istream.position());
 	}
 
-	std::vector<token> lexer::enumerate_tokens()
+	std::vector<token> lexer::enumerate_tokens(unsigned jobs)
 	{
+		if (jobs > 1 && istream.pending().size() >= 2 * MIN_CHUNK_SIZE)
+			return enumerate_chunks(jobs);
+
 		std::vector<token> tokens;
 
 		for (auto token = next_token(); token.type != token_type::eof; token = next_token())
@@ -107,43 +320,261 @@ namespace chasm
 		return tokens;
 	}
 
+	std::vector<token> lexer::enumerate_chunks(unsigned jobs)
+	{
+		const auto text  = istream.text();
+		const auto begin = istream.position();
+		const auto size  = istream.pending().size();
+		const auto end   = begin + size;
+
+		jobs = static_cast<unsigned>(std::min<size_t>(jobs, size / MIN_CHUNK_SIZE));
+
+		//
+		// Comments end at a newline and no token spans over lines, so chunks are split
+		// right after the first newline that follows each even share of the source
+		//
+		std::vector<size_t> bounds { begin };
+
+		for (unsigned job = 1; job < jobs; ++job)
+		{
+			const auto share = std::max(bounds.back(), begin + size / jobs * job);
+			const auto split = share + scan::line_end(text.substr(share, end - share)) + 1;
+
+			if (split >= end)
+				break;
+
+			bounds.push_back(split);
+		}
+
+		bounds.push_back(end);
+
+		const auto chunks_count = bounds.size() - 1;
+
+		std::vector<std::vector<token>> chunks(chunks_count);
+		std::vector<std::exception_ptr> errors(chunks_count);
+
+		{
+			std::vector<std::jthread> workers;
+			workers.reserve(chunks_count);
+
+			for (size_t chunk = 0; chunk < chunks_count; ++chunk)
+				workers.emplace_back([&, chunk]
+				{
+					try
+					{
+						auto chunk_lexer = lexer(text, bounds[chunk], bounds[chunk + 1]);
+						chunks[chunk] = chunk_lexer.enumerate_tokens();
+					}
+					catch (...)
+					{
+						errors[chunk] = std::current_exception();
+					}
+				});
+		}
+
+		//
+		// The earliest failing chunk holds the error a sequential run would have stopped at
+		//
+		for (const auto& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+
+		istream.skip(size);
+
+		size_t tokens_count = 0;
+
+		for (const auto& chunk : chunks)
+			tokens_count += chunk.size();
+
+		std::vector<token> tokens;
+		tokens.reserve(tokens_count);
+
+		for (const auto& chunk : chunks)
+			tokens.insert(tokens.end(), chunk.begin(), chunk.end());
+
+		return tokens;
+	}
+
+	void lexer::lex_ahead(unsigned jobs)
+	{
+		lexed_ahead = enumerate_tokens(jobs);
+		next_lexed_ahead = 0;
+	}
+
+	void lexer::lex_concurrently()
+	{
+		const auto begin = istream.position();
+		const auto end   = begin + istream.pending().size();
+
+		lexed_concurrently = std::make_unique<batch_ring>();
+
+		lexing_thread = std::jthread([this, text = istream.text(), begin, end]
+		{
+			//
+			// The background lexer reads the same buffer, tokens lexed from it are the same
+			//
+			auto range_lexer = lexer(text, begin, end);
+			lexed_batch batch;
+
+			try
+			{
+				for (auto token = range_lexer.next_token(); token.type != token_type::eof; token = range_lexer.next_token())
+				{
+					batch.tokens.push_back(token);
+
+					if (batch.tokens.size() == BATCH_SIZE && !lexed_concurrently->push(std::exchange(batch, {})))
+						return;
+				}
+			}
+			catch (...)
+			{
+				// tokens lexed before the error are served first
+				lexed_concurrently->push(std::exchange(batch, {}));
+				batch.error = std::current_exception();
+			}
+
+			if (!batch.tokens.empty() || batch.error)
+				lexed_concurrently->push(std::move(batch));
+
+			lexed_concurrently->close();
+		});
+
+		istream.skip(end - begin);
+	}
+
+	token lexer::next_concurrent_token()
+	{
+		lexed_batch batch;
+
+		while (lexed_concurrently->pop(batch))
+		{
+			if (batch.error)
+				std::rethrow_exception(batch.error);
+
+			lexed_ahead = std::move(batch.tokens);
+			next_lexed_ahead = 0;
+
+			if (!lexed_ahead.empty())
+				return lexed_ahead[next_lexed_ahead++];
+		}
+
+		return make_token(token_type::eof, istream.position());
+	}
+
     token lexer::next_token()
     {
-        skip_wspaces();
+		if (next_lexed_ahead < lexed_ahead.size())
+			return lexed_ahead[next_lexed_ahead++];
 
-        char c = peek_chr();
+		if (lexed_concurrently)
+			return next_concurrent_token();
 
-        if (c == ';')
-        {
-			do
-			{
-				next_chr();
-				if (next_chr() != ';')
-					throw std::runtime_error("Expected a second \";\" for comment.");
+		if (!sink)
+			return lex_token();
 
-				skip_comment();
-				c = peek_chr();
-			} while (c == ';');
-        }
+		for (;;)
+		{
+			try
+			{
+				return lex_token();
+			}
+			catch (const std::runtime_error& error)
+			{
+				sink->error(error.what(), cursor());
+				skip_invalid_lexeme();
+			}
+		}
+	}
 
-        if (istream.eof())
-            return make_token(token_type::eof);
+	void lexer::report_to(diagnostics& diagnostics_sink)
+	{
+		sink = &diagnostics_sink;
+	}
 
-        else if (std::isdigit(c))
-            return make_numerical_token(read_numeric_lexeme());
+	void lexer::skip_invalid_lexeme()
+	{
+		//
+		// Skips at least the offending character, and the rest of a word or a number
+		// so that its tail is not lexed as another token
+		//
+		if (!istream.eof())
+			next_chr();
 
-        else if (std::isalpha(c))
-        {
-            const auto lexeme = read_alpha_lexeme();
-            return make_token(map_token_type(lexeme), lexeme);
-        }
-        else if (special_characters.contains(c))
-        {
+		while (!istream.eof() && (is_alnum(peek_chr()) || peek_chr() == '_' || peek_chr() == '\''))
 			next_chr();
-            return make_token(special_characters.at(c));
-        }
+	}
+
+	token lexer::lex_token()
+	{
+		for (;;)
+		{
+			const auto lexeme_start = istream.position();
+
+			if (istream.eof())
+				return make_token(token_type::eof, lexeme_start);
 
-        throw lexer_exception::undefined_character_token(c, cursor);
+			const char c = peek_chr();
+			const auto& traits = traits_of(c);
+
+			switch (traits.cls)
+			{
+				case char_class::whitespace:
+					skip_wspaces();
+					break;
+
+				case char_class::comment:
+					next_chr();
+
+					if (next_chr() != ';')
+						throw std::runtime_error("Expected a second \";\" for comment.");
+
+					skip_comment();
+					break;
+
+				case char_class::digit:
+				{
+					const auto value = read_numeric_lexeme(lexeme_start);
+					return make_numerical_token(value, lexeme_start);
+				}
+
+				case char_class::alpha:
+				{
+					const auto reserved = classify_lexeme(read_alpha_lexeme());
+					return make_token(reserved.type, lexeme_start, reserved.value);
+				}
+
+				case char_class::punctuation:
+					next_chr();
+					return make_token(traits.token, lexeme_start, traits.value);
+
+				case char_class::double_quote:
+				{
+					next_chr();
+
+					// strings do not span over lines, like any other token
+					const auto line = istream.pending().substr(0, scan::line_end(istream.pending()));
+					const auto closing = line.find('"');
+
+					if (closing == std::string_view::npos)
+						throw lexer_exception::unterminated_string_literal(istream.locate(lexeme_start));
+
+					istream.skip(closing + 1);
+					return make_token(token_type::string_literal, lexeme_start);
+				}
+
+				case char_class::shift:
+					next_chr();
+
+					if (peek_chr() != c)
+						throw lexer_exception::undefined_character_token(c, cursor());
+
+					next_chr();
+					return make_token(traits.token, lexeme_start, traits.value);
+
+				default:
+					throw lexer_exception::undefined_character_token(c, cursor());
+			}
+		}
     }
 
     char lexer::peek_chr() const
@@ -153,32 +584,21 @@ namespace chasm
 
     char lexer::next_chr()
     {
-        const char chr = istream.get();
-
-        if (chr == '\n')
-			cursor.next_line();
-        else if (chr != 0)
-			cursor.advance();
-
-        return chr;
+        return istream.get();
     }
 
     void lexer::skip_comment()
     {
-        // Assumes comment was already detected
-        while (!istream.eof() && peek_chr() != '\n')
-            next_chr();
-
-        skip_wspaces();
+        // Assumes comment was already detected, the newline is left to skip_wspaces
+        istream.skip(scan::line_end(istream.pending()));
     }
 
     void lexer::skip_wspaces()
     {
-        for (char chr = peek_chr(); std::isspace(chr); chr = peek_chr())
-            next_chr();
+        istream.skip(scan::whitespace_run(istream.pending()));
     }
 
-    arch::size_type lexer::read_numeric_lexeme()
+    arch::size_type lexer::read_numeric_lexeme(size_t lexeme_start)
     {
         const auto base = [this]() -> int
         {
@@ -198,25 +618,36 @@ namespace chasm
             }
         }();
 
-		std::string numeric_lexeme;
+		//
+		// Digits are accumulated directly, the lexeme (delimiters included) is only sliced
+		// out of the stream buffer if the constant does not fit.
+		//
+		uint32_t constant_value = 0;
+		bool too_large = false;
 
 		if (base != 10)
 			next_chr();
 
 		for (char c = peek_chr(); ; c = peek_chr())
 		{
-			if (std::isalnum(c))
+			if (is_alnum(c))
 			{
 				if (!base_has_digit(base, c))
-					throw lexer_exception::invalid_digit_for_base(c, base, cursor);
+					throw lexer_exception::invalid_digit_for_base(c, base, cursor());
 
-				numeric_lexeme += next_chr();
+				constant_value = constant_value * static_cast<uint32_t>(base) + traits_of(next_chr()).digit;
+
+				if (constant_value > std::numeric_limits<arch::size_type>::max())
+				{
+					too_large = true;
+					constant_value = 0;
+				}
 			}
-			else if (c == '\'')
+			else if (traits_of(c).cls == char_class::quote)
 			{
 				next_chr();
 
-				if (!std::isalnum(peek_chr()))
+				if (!is_alnum(peek_chr()))
 				{
 					istream.unget();
 					break;
@@ -226,28 +657,90 @@ namespace chasm
 				break;
 		}
 
-		arch::size_type constant_value {};
-		const auto [_, ec] = std::from_chars(
-									numeric_lexeme.data(),
-									numeric_lexeme.data() + numeric_lexeme.size(),
-									constant_value,
-									base
-							 );
-
-		if (ec == std::errc::result_out_of_range)
-			throw lexer_exception::numeric_constant_too_large(numeric_lexeme, cursor);
+		if (too_large)
+			throw lexer_exception::numeric_constant_too_large(istream.slice(lexeme_start), istream.locate(lexeme_start));
 
-		return constant_value;
+		return static_cast<arch::size_type>(constant_value);
     }
 
-    std::string lexer::read_alpha_lexeme()
+    std::string_view lexer::read_alpha_lexeme()
     {
-		std::string lexeme;
+		// Assumes the first character was already checked to be alphabetic
+		const auto lexeme_start = istream.position();
 
-		do
-			lexeme += next_chr();
-		while (peek_chr() == '_' || std::isalnum(peek_chr()));
+		istream.skip(scan::identifier_run(istream.pending()));
 
-		return lexeme;
+		return istream.slice(lexeme_start);
     }
+
+	relexed_range relex(std::vector<token>& tokens, std::span<const char> source, const text_edit& edit)
+	{
+		const auto text  = std::string_view(source.data(), source.size());
+		const auto shift = static_cast<ptrdiff_t>(edit.inserted.size()) - static_cast<ptrdiff_t>(edit.erased);
+
+		//
+		// Tokens never span over lines, so lexing restarts at the beginning of the edited line
+		//
+		const auto line_begin = edit.offset == 0 ? 0 : text.rfind('\n', edit.offset - 1) + 1;
+		const auto first = static_cast<size_t>(std::ranges::lower_bound(tokens, line_begin, {}, &token::offset) - tokens.begin());
+
+		//
+		// The lexer holds no state between tokens: once a token lexed past the inserted text starts
+		// where an old token started (shifted), every following token is that old token shifted
+		//
+		auto synced = tokens.size();
+		auto old_token = first;
+
+		std::vector<token> relexed;
+		auto relexer = lexer(source, line_begin, text.size());
+
+		for (auto token = relexer.next_token(); token.type != token_type::eof; token = relexer.next_token())
+		{
+			if (token.offset >= edit.offset + edit.inserted.size())
+			{
+				const auto old_offset = static_cast<size_t>(static_cast<ptrdiff_t>(token.offset) - shift);
+
+				while (old_token < tokens.size() && tokens[old_token].offset < old_offset)
+					++old_token;
+
+				if (old_token < tokens.size() && tokens[old_token].offset == old_offset)
+				{
+					synced = old_token;
+					break;
+				}
+			}
+
+			relexed.push_back(token);
+		}
+
+		auto rebase = [text](token& t, ptrdiff_t offset_shift)
+		{
+			t.offset = static_cast<source_offset>(static_cast<ptrdiff_t>(t.offset) + offset_shift);
+			t.lexeme = text.substr(t.offset, t.lexeme.size());
+		};
+
+		//
+		// The tokens before the edit only need to be rebased if the source moved to another buffer
+		//
+		if (first > 0 && tokens.front().lexeme.data() != text.data() + tokens.front().offset)
+			for (size_t i = 0; i < first; ++i)
+				rebase(tokens[i], 0);
+
+		for (size_t i = synced; i < tokens.size(); ++i)
+			rebase(tokens[i], shift);
+
+		const auto replaced_begin = tokens.begin() + static_cast<ptrdiff_t>(first);
+		const auto replaced_end   = tokens.begin() + static_cast<ptrdiff_t>(synced);
+
+		const auto common = std::min<ptrdiff_t>(replaced_end - replaced_begin, std::ssize(relexed));
+
+		std::copy_n(relexed.begin(), common, replaced_begin);
+
+		if (common < std::ssize(relexed))
+			tokens.insert(replaced_begin + common, relexed.begin() + common, relexed.end());
+		else
+			tokens.erase(replaced_begin + common, replaced_end);
+
+		return { first, relexed.size() };
+	}
 }
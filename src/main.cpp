@@ -1,51 +1,67 @@
+#include <optional>
+#include <fstream>
+#include <chrono>
+#include <memory>
 #include <vector>
 
 #include <chasm/ds/disassembly_interface.hpp>
 #include <chasm/ds/disassembler.hpp>
+#include <chasm/precompiled_module.hpp>
+#include <chasm/build_cache.hpp>
+#include <chasm/diagnostics.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/depfile.hpp>
+#include <chasm/batch.hpp>
+#include <chasm/mapped_file.hpp>
 #include <chasm/options.hpp>
-#include <chasm/parser.hpp>
-#include <chasm/lexer.hpp>
+#include <chasm/server.hpp>
 #include <chasm/arch.hpp>
 #include <chasm/log.hpp>
 
 namespace io
 {
-	std::string content(const std::filesystem::path& path)
+	//
+	// The command line is only read here, the assembler gets its options explicitly
+	//
+	chasm::assembler_options assembler_options()
+	{
+		return {
+			.relocate     = chasm::options::arg<chasm::arch::addr>("relocate"),
+			.super        = chasm::options::has_flag("super"),
+			.pad_sprites  = chasm::options::has_flag("pad-sprites"),
+			.jobs         = chasm::options::arg<unsigned int>("jobs"),
+			.pipeline     = chasm::options::has_flag("pipeline"),
+			.symbols_file = chasm::options::has_flag("symbols") ? chasm::options::arg<std::string>("symbols") : std::string()
+		};
+	}
+
+	void check_extension(const std::filesystem::path& path)
 	{
 		if (path.extension() != ".c8")
 			chasm::log::warn("Input file does not have the c8 extension");
-
-		std::ifstream is(path);
-
-		if (!is)
-			throw std::runtime_error("Could not open source file " + path.string() + " for reading");
-
-		return { std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
 	}
 
-	std::vector<uint8_t> bytes(const std::filesystem::path& path)
+	//
+	// The output depends on the assembled file then on the files it includes
+	//
+	void write_depfile(const std::filesystem::path& ofile,
+					   const std::filesystem::path& ifile,
+					   std::span<const std::filesystem::path> included)
 	{
-		std::basic_ifstream<uint8_t> is(path, std::ios::binary);
-
-		if (!is)
-			throw std::runtime_error("Could not open assembled source file " + path.string() + " for reading");
+		std::vector<std::filesystem::path> inputs { ifile };
+		inputs.append_range(included);
 
-		return { std::istreambuf_iterator<uint8_t>(is), std::istreambuf_iterator<uint8_t>() };
+		chasm::write_depfile(ofile, inputs);
 	}
 
-	void write(const std::filesystem::path& file, const std::vector<uint8_t>& binary)
+	void write_bytes(const std::filesystem::path& file, const std::vector<uint8_t>& bytes)
 	{
 		std::ofstream os(file, std::ios::binary);
 
 		if (!os)
 			throw std::runtime_error("Could not open file " + file.string() + " for writing");
 
-		if (binary.size() > chasm::arch::MAX_PROGRAM_SIZE)
-			chasm::log::warn("CHIP-8 programs are generally up to {} bytes but input file assembled to {} bytes.",
-							 chasm::arch::MAX_PROGRAM_SIZE,
-							 binary.size());
-
-		os.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+		os.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
 	}
 
 	void hexdump(const std::vector<uint8_t>& binary)
@@ -54,17 +70,361 @@ namespace io
 		const auto perline = chasm::options::arg<unsigned int>("hex");
 		const auto binsize = static_cast<chasm::arch::size_type>(binary.size());
 
-		for (chasm::arch::addr curr = 0; curr < binsize; curr += perline)
+		for (size_t curr = 0; curr < binsize; curr += perline)
 		{
 			std::cout << std::format("0x{:04X}: ", offset + curr);
 
-			for (int j = 0; j < perline; ++j)
+			for (size_t j = 0; j < perline; ++j)
 				if (curr + j < binsize)
 					std::cout << std::format("{:02X} ", binary[curr + j]);
 
 			std::cout << '\n';
 		}
 	}
+
+	//
+	// Build cache of the --cache directory, none if it was not given
+	//
+	std::unique_ptr<chasm::build_cache> open_cache()
+	{
+		if (!chasm::options::has_flag("cache"))
+			return nullptr;
+
+		const uint64_t max_size = uint64_t(chasm::options::arg<unsigned int>("cache-size")) * 1024 * 1024;
+
+		return std::make_unique<chasm::build_cache>(chasm::options::arg<std::string>("cache"), max_size);
+	}
+
+	//
+	// Outputs of a previous build of the same source with the same options and included files
+	//
+	bool restore_cached(chasm::build_cache& cache,
+						const chasm::build_cache::key& key,
+						const std::string& ifile,
+						const std::string& ofile,
+						const std::string& symbols_file)
+	{
+		const auto cached = cache.fetch(key, ofile, symbols_file);
+
+		if (!cached)
+			return false;
+
+		for (const auto& line : cached->log)
+			std::cout << line << '\n';
+
+		if (chasm::options::has_flag("depfile"))
+			io::write_depfile(ofile, ifile, cached->dependencies);
+
+		return true;
+	}
+
+	//
+	// What the build logs is kept to be cached with its output, and printed once it is done
+	//
+	template<typename Build>
+	auto logged(std::vector<std::string>& log_lines, Build&& build)
+	{
+		const auto print = [&log_lines]
+		{
+			for (const auto& line : log_lines)
+				std::cout << line << '\n';
+		};
+
+		try
+		{
+			const chasm::log::capture capture(log_lines);
+			auto result = build();
+
+			print();
+			return result;
+		}
+		catch (...)
+		{
+			print();
+			throw;
+		}
+	}
+
+	//
+	// Key of the build in the --cache directory, none without it
+	//
+	std::optional<chasm::build_cache::key> cache_key(const chasm::build_cache* cache,
+													 std::string_view source,
+													 const std::string& ifile,
+													 const chasm::assembler_options& options,
+													 chasm::build_cache::build_kind kind)
+	{
+		if (!cache)
+			return std::nullopt;
+
+		return chasm::build_cache::make_key(source, ifile, options, kind);
+	}
+
+	int assemble(const std::string& ifile, const std::string& ofile, std::string_view source)
+	{
+		const auto options = assembler_options();
+		const auto cache = open_cache();
+		const auto key = cache_key(cache.get(), source, ifile, options, chasm::build_cache::build_kind::program);
+
+		if (key && restore_cached(*cache, *key, ifile, ofile, options.symbols_file))
+		{
+			if (chasm::options::has_flag("hex"))
+			{
+				const auto output = chasm::mapped_file(ofile);
+				hexdump({ output.bytes().begin(), output.bytes().end() });
+			}
+
+			chasm::log::info("Build of file {} to {} restored from the cache", ifile, ofile);
+
+			return EXIT_SUCCESS;
+		}
+
+		std::vector<std::filesystem::path> dependencies;
+		std::vector<std::string> log_lines;
+
+		const auto binary = logged(log_lines, [&]
+		{
+			return chasm::assemble(source, options, ifile, &dependencies);
+		});
+
+		if (binary.empty())
+		{
+			chasm::log::warn("No input to be read.\n");
+			return EXIT_SUCCESS;
+		}
+
+		if (chasm::options::has_flag("hex"))
+			hexdump(binary);
+
+		write_bytes(ofile, binary);
+
+		if (chasm::options::has_flag("depfile"))
+			write_depfile(ofile, ifile, dependencies);
+
+		if (key)
+			cache->store(*key, dependencies, ofile, options.symbols_file, log_lines);
+
+		chasm::log::info("Build of file {} to {} finished", ifile, ofile);
+
+		return EXIT_SUCCESS;
+	}
+
+	//
+	// Reports every error and warning of the source, the output is only written if there is no error.
+	// Only a build without errors is cached, its report is printed again when it is restored.
+	//
+	int assemble_diagnosed(const std::string& ifile, const std::string& ofile, std::string_view source)
+	{
+		const auto json = chasm::options::arg<std::string>("diagnostics") == "json";
+		const auto kind = json ? chasm::build_cache::build_kind::diagnostics_json : chasm::build_cache::build_kind::diagnostics;
+
+		const auto options = assembler_options();
+		const auto cache = open_cache();
+		const auto key = cache_key(cache.get(), source, ifile, options, kind);
+
+		if (key && restore_cached(*cache, *key, ifile, ofile, options.symbols_file))
+			return EXIT_SUCCESS;
+
+		std::vector<std::filesystem::path> dependencies;
+		std::vector<std::string> log_lines;
+
+		chasm::diagnostics sink;
+
+		const auto binary = logged(log_lines, [&]
+		{
+			return chasm::assemble(source, sink, options, ifile, &dependencies);
+		});
+
+		if (json)
+		{
+			log_lines.push_back(sink.to_json(ifile));
+			std::cout << log_lines.back() << std::endl;
+		}
+		else
+		{
+			for (const auto& [level, message, location] : sink.entries())
+			{
+				if (level == chasm::severity::error)
+					chasm::log::error("{}", message);
+				else
+				{
+					chasm::log::warn("{}", message);
+					log_lines.push_back("[WARN] " + message);
+				}
+			}
+		}
+
+		if (!binary)
+			return EXIT_FAILURE;
+
+		write_bytes(ofile, *binary);
+
+		if (chasm::options::has_flag("depfile"))
+			write_depfile(ofile, ifile, dependencies);
+
+		if (key)
+			cache->store(*key, dependencies, ofile, options.symbols_file, log_lines);
+
+		return EXIT_SUCCESS;
+	}
+
+	//
+	// Precompiled module of the source, programs including it do not parse the source again
+	//
+	int compile_module(const std::string& ifile, const std::string& ofile, std::string_view source)
+	{
+		const auto options = assembler_options();
+		const auto cache = open_cache();
+		const auto key = cache_key(cache.get(), source, ifile, options, chasm::build_cache::build_kind::module);
+
+		// a module has no symbols file, one left by another build must not be cached with it
+		if (key && restore_cached(*cache, *key, ifile, ofile, {}))
+		{
+			chasm::log::info("Module {} restored from the cache to {}", ifile, ofile);
+			return EXIT_SUCCESS;
+		}
+
+		std::vector<std::filesystem::path> dependencies;
+		std::vector<std::string> log_lines;
+
+		const auto module = logged(log_lines, [&]
+		{
+			return chasm::compile_module(source, options, ifile, &dependencies);
+		});
+
+		write_bytes(ofile, module);
+
+		if (chasm::options::has_flag("depfile"))
+			write_depfile(ofile, ifile, dependencies);
+
+		if (key)
+			cache->store(*key, dependencies, ofile, {}, log_lines);
+
+		chasm::log::info("Module {} compiled to {}", ifile, ofile);
+
+		return EXIT_SUCCESS;
+	}
+
+	int print_cache_statistics()
+	{
+		const auto cache = open_cache();
+
+		if (!cache)
+			throw std::runtime_error("Option \"cache-stats\" needs the cache directory given with \"cache\"");
+
+		const auto [hits, misses, evictions, entries, size] = cache->statistics();
+		const auto lookups = hits + misses;
+
+		chasm::log::info("Cache {}: {} builds, {:.1f} MiB", chasm::options::arg<std::string>("cache"), entries, double(size) / (1024 * 1024));
+		chasm::log::info("{} hits, {} misses ({:.1f}% hit rate), {} evictions",
+						 hits,
+						 misses,
+						 lookups == 0 ? 0.0 : 100.0 * double(hits) / double(lookups),
+						 evictions);
+
+		return EXIT_SUCCESS;
+	}
+
+	//
+	// Files of the manifest then every --in file, each built next to its source unless the manifest says otherwise
+	//
+	std::vector<chasm::batch_entry> batch_entries(std::string_view output_extension)
+	{
+		std::vector<chasm::batch_entry> entries;
+
+		if (chasm::options::has_flag("batch"))
+			entries = chasm::read_manifest(chasm::options::arg<std::string>("batch"), output_extension);
+
+		if (chasm::options::has_flag("in"))
+			for (const auto& ifile : chasm::options::arg<std::vector<std::string>>("in"))
+				entries.push_back({ .source = ifile, .output = chasm::default_output(ifile, output_extension) });
+
+		return entries;
+	}
+
+	//
+	// Assembles many files in this process, then reports each of them in the order they were given
+	//
+	int assemble_batch()
+	{
+		if (chasm::options::has_flag("hex") || chasm::options::has_flag("symbols"))
+			chasm::log::warn("Options \"hex\" and \"symbols\" are ignored when assembling a batch.");
+
+		const bool modules = chasm::options::has_flag("module");
+		const auto entries = batch_entries(modules ? chasm::precompiled_module::EXTENSION : std::string_view(".c8c"));
+
+		const auto cache = open_cache();
+
+		const chasm::batch_options options {
+			.assembler = assembler_options(),
+			.workers   = chasm::options::has_flag("jobs") ? chasm::options::arg<unsigned int>("jobs") : 0,
+			.modules   = modules,
+			.depfiles  = chasm::options::has_flag("depfile"),
+			.cache     = cache.get()
+		};
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto results = chasm::assemble_batch(entries, options);
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+		const bool json = chasm::options::has_flag("diagnostics") && chasm::options::arg<std::string>("diagnostics") == "json";
+		size_t failed = 0;
+
+		for (const auto& result : results)
+		{
+			const auto ifile = result.source.string();
+
+			for (const auto& line : result.log)
+				std::cout << line << '\n';
+
+			if (json)
+				std::cout << result.report.to_json(ifile) << std::endl;
+			else
+			{
+				for (const auto& [level, message, location] : result.report.entries())
+				{
+					if (level == chasm::severity::error)
+						chasm::log::error("{}: {}", ifile, message);
+					else
+						chasm::log::warn("{}: {}", ifile, message);
+				}
+			}
+
+			if (result.success)
+				chasm::log::info("Built {} to {}", ifile, result.output.string());
+			else
+			{
+				++failed;
+				chasm::log::error("Build of {} failed", ifile);
+			}
+		}
+
+		chasm::log::info("Batch of {} files finished in {} ms: {} built, {} failed",
+						 results.size(),
+						 elapsed.count(),
+						 results.size() - failed,
+						 failed);
+
+		return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//
+	// Stays up answering requests, responses are the only output on the standard output when serving it
+	//
+	int serve(const std::string& endpoint)
+	{
+		chasm::server server;
+
+		if (endpoint == "-")
+			server.serve(std::cin, std::cout);
+		else
+		{
+			chasm::log::info("Serving requests on {}", endpoint);
+			server.serve_socket(endpoint);
+		}
+
+		return EXIT_SUCCESS;
+	}
 }
 
 int main(int argc, char** argv)
@@ -76,42 +436,45 @@ int main(int argc, char** argv)
 		if (chasm::options::has_flag("help"))
 			chasm::options::help();
 
+		if (chasm::options::has_flag("serve"))
+			return io::serve(chasm::options::arg<std::string>("serve"));
+
+		if (chasm::options::has_flag("cache-stats"))
+			return io::print_cache_statistics();
+
+		if (chasm::options::has_flag("batch") ||
+			(chasm::options::has_flag("in") && chasm::options::arg<std::vector<std::string>>("in").size() > 1))
+			return io::assemble_batch();
+
 		if (chasm::options::has_flag("in"))
 		{
-			const auto ifile = chasm::options::arg<std::string>("in");
+			const auto ifile = chasm::options::arg<std::vector<std::string>>("in").front();
 			const auto ofile = chasm::options::arg<std::string>("out");
 
-			auto lexer  = chasm::lexer(io::content(ifile));
-			auto tokens = lexer.enumerate_tokens();
+			io::check_extension(ifile);
 
-			if (tokens.empty())
-			{
-				chasm::log::warn("No input to be read.\n");
-				return EXIT_SUCCESS;
-			}
+			const auto file = chasm::mapped_file(ifile);
+			const auto source = std::string_view(file.text().data(), file.text().size());
 
-			auto parser = chasm::parser(std::move(tokens));
-			auto ast = parser.make_tree();
-			const auto binary = ast.generate();
-
-			if (chasm::options::has_flag("hex"))
-				io::hexdump(binary);
+			if (chasm::options::has_flag("module"))
+				return io::compile_module(ifile, ofile, source);
 
-			io::write(ofile, binary);
+			if (chasm::options::has_flag("diagnostics"))
+				return io::assemble_diagnosed(ifile, ofile, source);
 
-			chasm::log::info("Build of file {} to {} finished", ifile, ofile);
+			return io::assemble(ifile, ofile, source);
 		}
 		else if (chasm::options::has_flag("dis"))
     	{
-			auto bytes = io::bytes(chasm::options::arg<std::string>("dis"));
+			const auto rom = chasm::mapped_file(chasm::options::arg<std::string>("dis"));
 
-			if (bytes.empty())
+			if (rom.empty())
 			{
 				chasm::log::warn("No input to be read.\n");
 				return EXIT_SUCCESS;
 			}
 
-			auto disassembler = chasm::ds::disassembler(std::move(bytes), chasm::options::arg<chasm::arch::addr>("relocate"));
+			auto disassembler = chasm::ds::disassembler(rom.bytes(), chasm::options::arg<chasm::arch::addr>("relocate"));
 			auto interface = chasm::ds::disassembly_interface(disassembler.get_graph());
 			interface.run();
     	}
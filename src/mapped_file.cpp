@@ -0,0 +1,146 @@
+#include <stdexcept>
+#include <fstream>
+
+#include <chasm/mapped_file.hpp>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+
+namespace chasm
+{
+	mapped_file::mapped_file(const std::filesystem::path& path)
+	{
+		if (!map(path))
+			read(path);
+	}
+
+	mapped_file::~mapped_file()
+	{
+		if (!mapping)
+			return;
+
+#if defined(_WIN32)
+		UnmapViewOfFile(mapping);
+#else
+		munmap(mapping, size);
+#endif
+	}
+
+	std::span<const uint8_t> mapped_file::bytes() const
+	{
+		return { reinterpret_cast<const uint8_t*>(data), size };
+	}
+
+	std::span<const char> mapped_file::text() const
+	{
+		return { data, size };
+	}
+
+	bool mapped_file::empty() const
+	{
+		return size == 0;
+	}
+
+	bool mapped_file::is_mapped() const
+	{
+		return mapping != nullptr;
+	}
+
+#if defined(_WIN32)
+	bool mapped_file::map(const std::filesystem::path& path)
+	{
+		const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+										OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER file_size {};
+
+		if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		const HANDLE view = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if (!view)
+			return false;
+
+		mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(view);
+
+		if (!mapping)
+			return false;
+
+		data = static_cast<const char*>(mapping);
+		size = static_cast<size_t>(file_size.QuadPart);
+
+		return true;
+	}
+#else
+	bool mapped_file::map(const std::filesystem::path& path)
+	{
+		const int fd = ::open(path.c_str(), O_RDONLY);
+
+		if (fd < 0)
+			return false;
+
+		struct stat info {};
+
+		if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* view = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (view == MAP_FAILED)
+			return false;
+
+		// sources and ROMs are read front to back exactly once
+		::madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+		mapping = view;
+		data = static_cast<const char*>(view);
+		size = static_cast<size_t>(info.st_size);
+
+		return true;
+	}
+#endif
+
+	void mapped_file::read(const std::filesystem::path& path)
+	{
+		std::ifstream is(path, std::ios::binary);
+
+		if (!is)
+			throw std::runtime_error("Could not open file " + path.string() + " for reading");
+
+		constexpr std::streamsize CHUNK_SIZE = 64 * 1024;
+
+		while (is)
+		{
+			const auto used = fallback.size();
+			fallback.resize(used + CHUNK_SIZE);
+
+			is.read(fallback.data() + used, CHUNK_SIZE);
+			fallback.resize(used + static_cast<size_t>(is.gcount()));
+		}
+
+		data = fallback.data();
+		size = fallback.size();
+	}
+}
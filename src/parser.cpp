@@ -2,107 +2,424 @@
 #include <chasm/parser.hpp>
 #include <chasm/log.hpp>
 
+#include <algorithm>
+
 
 namespace chasm
 {
+	namespace
+	{
+		constexpr token_set primary_first = {
+			token_type::identifier,
+			token_type::numerical,
+			token_type::at_label,
+			token_type::dollar_proc,
+			token_type::hash_sprite,
+			token_type::parenthesis_open
+		};
+
+		// an operand starting with an operator sign is an expression such as -1 or ~mask
+		constexpr token_set operand_first = primary_first | token_set {
+			token_type::register_name,
+			token_type::bracket_open,
+			token_type::operator_sign
+		};
+
+		constexpr token_set statement_first = {
+			token_type::instruction,
+			token_type::dot_label,
+			token_type::keyword_define,
+			token_type::keyword_config,
+			token_type::keyword_raw,
+			token_type::keyword_sprite,
+			token_type::keyword_proc_start,
+			token_type::keyword_proc_end,
+			token_type::keyword_include
+		};
+
+		[[nodiscard]]
+		arch::operand_type register_operand_type(uint16_t id)
+		{
+			switch (id)
+			{
+				case arch::register_id::REG_AR: return arch::operand_type::reg_ar;
+				case arch::register_id::REG_ST: return arch::operand_type::reg_st;
+				case arch::register_id::REG_DT: return arch::operand_type::reg_dt;
+
+				default:
+					return arch::operand_type::reg_rx;
+			}
+		}
 
-    parser::parser(std::vector<token> &&tokens_list)
-        : tokens(std::move(tokens_list)),
-		  token_it(std::begin(tokens))
+		[[nodiscard]]
+		uint16_t make_operands_mask(std::span<const ast::instruction_operand> operands)
+		{
+			uint16_t mask = 0;
+			uint16_t shift = 0;
+
+			for (const auto& operand : operands)
+			{
+				mask |= (static_cast<uint8_t>(operand.type) << shift);
+				shift += arch::BITSHIFT_OP_MASK;
+			}
+
+			return mask;
+		}
+	}
+
+	constinit const parser::grammar_table parser::grammar = []
+	{
+		grammar_table table {};
+
+		auto rule = [&](parse_context context, token_type type, statement_rule parse)
+		{
+			table[context][std::to_underlying(type)] = parse;
+		};
+
+		for (const auto context : { top_level, procedure_body, label_body })
+		{
+			rule(context, token_type::keyword_define, &parser::parse_define);
+			rule(context, token_type::keyword_config, &parser::parse_config);
+			rule(context, token_type::keyword_raw,    &parser::parse_raw);
+			rule(context, token_type::instruction,    &parser::parse_instruction);
+		}
+
+		rule(top_level, token_type::eof,                &parser::end_block);
+		rule(top_level, token_type::keyword_sprite,     &parser::parse_sprite);
+		rule(top_level, token_type::dot_label,          &parser::parse_label);
+		rule(top_level, token_type::keyword_proc_start, &parser::parse_procedure);
+		rule(top_level, token_type::keyword_include,    &parser::parse_include);
+
+		rule(procedure_body, token_type::eof,                &parser::reject_unterminated_procedure);
+		rule(procedure_body, token_type::keyword_proc_start, &parser::reject_nested_procedure);
+		rule(procedure_body, token_type::keyword_proc_end,   &parser::end_block);
+		rule(procedure_body, token_type::dot_label,          &parser::parse_label);
+
+		// a label body goes on until the next label or the end of its procedure
+		rule(label_body, token_type::eof,              &parser::end_block);
+		rule(label_body, token_type::keyword_proc_end, &parser::end_block);
+		rule(label_body, token_type::dot_label,        &parser::end_block);
+
+		return table;
+	}();
+
+    parser::parser(lexer& token_source)
+        : lex(token_source),
+		  lookahead(lex.next_token())
     {}
 
+	parser::parser(lexer& token_source, diagnostics& diagnostics_sink)
+		: lex(token_source),
+		  lookahead(),
+		  sink(&diagnostics_sink)
+	{
+		// the first token may already be invalid
+		lex.report_to(diagnostics_sink);
+		lookahead = lex.next_token();
+	}
+
 	token parser::advance()
 	{
 		if (no_more_tokens())
 			throw chasm_exception("Expected more tokens before end of file.");
 
-		const token t = *token_it;
-		++token_it;
+		const token t = lookahead;
+		lookahead = lex.next_token();
 
 		return t;
 	}
 
+	token parser::expect(token_set expected_types)
+	{
+		const token t = advance();
+
+		if (!expected_types.contains(t.type))
+			throw parser_exception::expected_others_error(t, lex.locate(t), expected_types);
+
+		return t;
+	}
+
+	bool parser::advance_if(token_set types)
+	{
+		if (!next_any_of(types))
+			return false;
+
+		advance();
+		return true;
+	}
+
+	bool parser::next_any_of(token_set types) const
+	{
+		return !no_more_tokens() && types.contains(lookahead.type);
+	}
+
     bool parser::no_more_tokens() const
     {
-        return token_it == std::end(tokens);
+        return lookahead.type == token_type::eof;
     }
 
     ast::abstract_tree parser::make_tree()
     {
-		std::vector<ast::statement> branches;
-
-		while (auto branch = parse_primary_statement())
-			branches.push_back(std::move(branch));
+		parse_block(top_level);
 
-        return ast::abstract_tree(std::move(branches));
+        return ast::abstract_tree(std::move(nodes), std::move(names), lex.source());
     }
 
-	ast::statement parser::parse_primary_statement()
+	ast::flat_nodes parser::parse_fragment(size_t min_nodes)
 	{
-		if (no_more_tokens())
-			return {};
+		while (nodes.size() < min_nodes && parse_statement(top_level) != ast::NO_NODE)
+			;
+
+		return std::exchange(nodes, {});
+	}
+
+	const interner& parser::symbols() const
+	{
+		return names;
+	}
+
+	void parser::resolve_includes(std::vector<std::filesystem::path> chain, include_cache* cache)
+	{
+		for (auto& file : chain)
+			file = std::filesystem::weakly_canonical(file);
+
+		include_chain = std::move(chain);
+		includes = cache;
+	}
+
+	const std::vector<std::filesystem::path>& parser::dependencies() const
+	{
+		return included_paths;
+	}
+
+	void parser::parse_included(parsed_include& file)
+	{
+		parse_block(top_level);
+
+		file.nodes = std::exchange(nodes, {});
+		file.symbols = std::exchange(names, {});
+		file.dependencies.clear();
+
+		for (size_t i = 0; i < included_paths.size(); ++i)
+			file.dependencies.push_back({ included_paths[i], included_hashes[i] });
+
+		for (const auto& nested : included_files)
+			static_cast<void>(file.source.attach(std::shared_ptr<const stream>(nested, &nested->source), nested->path.string()));
+	}
+
+	symbol_id parser::intern(const token& identifier)
+	{
+		return names.intern(identifier.lexeme);
+	}
+
+	ast::node_id parser::parse_statement(parse_context context)
+	{
+		const auto rule = grammar[context][std::to_underlying(lookahead.type)];
+
+		if (!rule)
+			throw parser_exception::unexpected_error(lookahead, lex.locate(lookahead));
 
-		switch (token_it->type)
+		return (this->*rule)();
+	}
+
+	void parser::parse_block(parse_context context)
+	{
+		if (sink)
+			return parse_block_recovering(context);
+
+		while (parse_statement(context) != ast::NO_NODE)
+			;
+	}
+
+	void parser::parse_block_recovering(parse_context context)
+	{
+		//
+		// Recovery point: a statement with an error is reported and dropped,
+		// nested blocks recover first so the statements around it are kept
+		//
+		for (;;)
 		{
-			case token_type::keyword_define:     return parse_define();
-			case token_type::keyword_config:     return parse_config();
-			case token_type::keyword_sprite:     return parse_sprite();
-			case token_type::keyword_raw:        return parse_raw();
-			case token_type::dot_label:          return parse_label();
-			case token_type::keyword_proc_start: return parse_procedure();
-			case token_type::instruction:        return parse_instruction();
+			const auto checkpoint = nodes.mark();
+			const auto statement_start = lookahead.offset;
 
-			default:
-				throw parser_exception::unexpected_error(*token_it);
+			try
+			{
+				if (parse_statement(context) == ast::NO_NODE)
+					return;
+			}
+			catch (const chasm_exception& error)
+			{
+				nodes.rollback(checkpoint);
+
+				if (!error_at_eof)
+					sink->error(error.what(), lex.source().locate(statement_start));
+
+				error_at_eof = no_more_tokens();
+
+				if (no_more_tokens())
+					return;
+
+				synchronize(statement_start);
+			}
+		}
+	}
+
+	void parser::synchronize(source_offset statement_start)
+	{
+		// the statement may have been rejected on its first token, which must not be parsed again
+		if (lookahead.offset == statement_start)
+			advance();
+
+		while (!no_more_tokens() && !next_any_of(statement_first))
+			advance();
+	}
+
+	ast::node_id parser::end_block()
+	{
+		return ast::NO_NODE;
+	}
+
+	ast::node_id parser::reject_nested_procedure()
+	{
+		throw chasm_exception("Cannot define a procedure inside another.");
+	}
+
+	ast::node_id parser::reject_unterminated_procedure()
+	{
+		throw chasm_exception("Found unexpected EOF before function end while parsing procedure.");
+	}
+
+	ast::node_id parser::parse_include()
+	{
+		expect(token_type::keyword_include);
+
+		const auto path_token = expect(token_type::string_literal);
+		const auto written = path_token.lexeme.substr(1, path_token.lexeme.size() - 2);
+
+		const auto path = include_chain.empty()
+			? std::filesystem::path(written)
+			: include_chain.back().parent_path() / written;
+
+		if (precompiled_module::is_module(path))
+			return parse_module_include(path_token, path);
+
+		const auto file = include_files().parse(path, include_chain);
+
+		//
+		// Tokens of the included file are moved to the offsets its stream is attached at,
+		// its symbols are interned again so they refer to the same names as the including file
+		//
+		const auto offset_base = lex.source().attach(std::shared_ptr<const stream>(file, &file->source), file->path.string());
+		included_files.push_back(file);
+
+		std::vector<symbol_id> symbol_map(file->symbols.size());
+
+		for (symbol_id symbol = 0; symbol < symbol_map.size(); ++symbol)
+			symbol_map[symbol] = names.intern(file->symbols.name(symbol));
+
+		const auto id = nodes.append(ast::node_kind::include, NO_SYMBOL, { path_token });
+		nodes.splice(file->nodes, symbol_map, offset_base);
+
+		depend_on(file->path, file->content_hash);
+
+		for (const auto& [dependency, hash] : file->dependencies)
+			depend_on(dependency, hash);
+
+		return id;
+	}
+
+	ast::node_id parser::parse_module_include(const token& path_token, const std::filesystem::path& path)
+	{
+		//
+		// Nothing of the module is parsed, the names it exports are interned for the statements using them
+		//
+		const auto [module, content_hash] = include_files().load_module(path);
+		const auto id = nodes.append(ast::node_kind::module, NO_SYMBOL, { path_token });
+
+		nodes.set_children(id, nodes.modules.size(), module->symbols_count());
+		nodes.modules.push_back({ module, static_cast<uint32_t>(nodes.imports.size()) });
+
+		for (size_t i = 0; i < module->symbols_count(); ++i)
+			nodes.imports.push_back(names.intern(module->symbol_at(i).name));
+
+		depend_on(std::filesystem::weakly_canonical(path), content_hash);
+
+		return id;
+	}
+
+	include_cache& parser::include_files()
+	{
+		if (!includes)
+		{
+			own_includes = std::make_unique<include_cache>();
+			includes = own_includes.get();
 		}
+
+		return *includes;
 	}
 
-	ast::statement parser::parse_raw()
+	void parser::depend_on(const std::filesystem::path& dependency, uint64_t content_hash)
+	{
+		if (std::ranges::contains(included_paths, dependency))
+			return;
+
+		included_paths.push_back(dependency);
+		included_hashes.push_back(content_hash);
+	}
+
+	ast::node_id parser::parse_raw()
 	{
 		expect(token_type::keyword_raw);
 		expect(token_type::parenthesis_open);
 
-		auto token = expect(token_type::numerical, token_type::identifier);
+		const auto id = nodes.append(ast::node_kind::raw, NO_SYMBOL, { lookahead });
+		const auto first_term = nodes.terms.size();
+
+		parse_expression();
 
 		expect(token_type::parenthesis_close);
 
-		return std::make_unique<ast::raw_statement>(std::move(token));
+		nodes.set_children(id, first_term, nodes.terms.size() - first_term);
+
+		return id;
 	}
 
-	ast::statement parser::parse_define()
+	ast::node_id parser::parse_define()
 	{
 		expect(token_type::keyword_define);
 
-		auto identifier = expect(token_type::identifier);
-		auto value = expect(token_type::numerical, token_type::keyword_default);
+		const auto identifier = expect(token_type::identifier);
+		const auto id = nodes.append(ast::node_kind::define, intern(identifier), { identifier, lookahead });
+		const auto first_term = nodes.terms.size();
 
-		return std::make_unique<ast::define_statement>(
-					std::move(identifier),
-					std::move(value)
-				);
+		if (next_any_of(token_type::keyword_default))
+			push_term(ast::expression_term::kind::number, advance());
+		else
+			parse_expression();
+
+		nodes.set_children(id, first_term, nodes.terms.size() - first_term);
+
+		return id;
 	}
 
-	ast::statement parser::parse_config()
+	ast::node_id parser::parse_config()
 	{
 		expect(token_type::keyword_config);
 
-		auto identifier = expect(token_type::identifier);
+		const auto identifier = expect(token_type::identifier);
 
 		expect(token_type::equal);
 
-		auto value = expect(token_type::numerical, token_type::keyword_default);
+		const auto value = expect({ token_type::numerical, token_type::keyword_default });
 
-		return std::make_unique<ast::config_statement>(
-					std::move(identifier),
-					std::move(value)
-				);
+		return nodes.append(ast::node_kind::config, NO_SYMBOL, { identifier, value });
 	}
 
-	ast::statement parser::parse_sprite()
+	ast::node_id parser::parse_sprite()
 	{
 		expect(token_type::keyword_sprite);
 
-		auto identifier = expect(token_type::identifier);
+		const auto identifier = expect(token_type::identifier);
 		expect(token_type::bracket_open);
 
 		arch::sprite sprite {};
@@ -122,176 +439,292 @@ namespace chasm
 			if (!arch::imm_matches_format(value, arch::fmt_imm8))
 				throw chasm_exception("Sprite digits must be less than 255");
 
-			sprite.data[sprite.row_count] = value;
+			sprite.data[sprite.row_count] = static_cast<uint8_t>(value);
 			++sprite.row_count;
 		}
 		while (advance_if(token_type::comma));
 
 		expect(token_type::bracket_close);
 
-		return std::make_unique<ast::sprite_statement>(
-					std::move(identifier),
-					sprite
-				);
+		const auto id = nodes.append(ast::node_kind::sprite, intern(identifier), { identifier });
+
+		nodes.set_children(id, nodes.sprites.size(), 1);
+		nodes.sprites.push_back(sprite);
+
+		return id;
 	}
 
-	std::vector<ast::instruction_operand> parser::parse_operands()
+	void parser::parse_operands()
 	{
-		std::vector<ast::instruction_operand> operands;
-
-		while (next_any_of(token_type::identifier,
-						   token_type::register_name,
-						   token_type::at_label,
-						   token_type::hash_sprite,
-						   token_type::dollar_proc,
-						   token_type::numerical,
-						   token_type::bracket_open))
+		while (next_any_of(operand_first))
 		{
-			operands.push_back(parse_operand());
+			nodes.operands.push_back(parse_operand());
 
 			if (!advance_if(token_type::comma))
 				break;
 		}
-
-		return operands;
 	}
 
-	ast::statement parser::parse_instruction()
+	ast::node_id parser::parse_instruction()
 	{
-		auto mnemonic = expect(token_type::instruction);
+		const auto mnemonic = expect(token_type::instruction);
+		const auto id = nodes.append(ast::node_kind::instruction, NO_SYMBOL, { mnemonic });
+		const auto first_operand = nodes.operands.size();
 
-		return std::make_unique<ast::instruction_statement>(
-					std::move(mnemonic),
-					parse_operands()
-				);
-	}
+		parse_operands();
 
-	ast::statement parser::parse_procedure()
-	{
-		auto parse_inner_statement = [&]() -> ast::statement
-		{
-			if (no_more_tokens())
-				throw chasm_exception("Found unexpected EOF before function end while parsing procedure.");
+		const auto operands_count = nodes.operands.size() - first_operand;
 
-			switch (token_it->type)
-			{
-				case token_type::keyword_proc_end: return {};
-				case token_type::keyword_define:   return parse_define();
-				case token_type::keyword_config:   return parse_config();
-				case token_type::keyword_raw:      return parse_raw();
-				case token_type::instruction:      return parse_instruction();
-				case token_type::dot_label:        return parse_label();
+		if (operands_count > arch::MAX_OPERANDS)
+			throw chasm_exception("Instruction \"{}\" at {} has {} operands "
+								  "but CHIP-8 instructions can have up to {} operands.",
+								  mnemonic.to_string(),
+								  chasm::to_string(lex.locate(mnemonic)),
+								  operands_count,
+								  arch::MAX_OPERANDS);
 
-				case token_type::keyword_proc_start:
-					throw chasm_exception("Cannot define a procedure inside another.");
+		nodes.set_children(id, first_operand, operands_count);
+		nodes.operands_masks[id] = make_operands_mask(nodes.instruction(id).operands);
 
-				default:
-					throw parser_exception::unexpected_error(*token_it);
-			}
-		};
+		return id;
+	}
 
+	ast::node_id parser::parse_procedure()
+	{
 		expect(token_type::keyword_proc_start);
-		auto proc_name_beg = expect(token_type::identifier);
 
-		std::vector<ast::statement> inner_statements;
+		const auto proc_name_beg = expect(token_type::identifier);
+		const auto id = nodes.append(ast::node_kind::procedure, intern(proc_name_beg), { proc_name_beg });
 
-		while (auto block = parse_inner_statement())
-			inner_statements.push_back(std::move(block));
+		parse_block(procedure_body);
+		nodes.close_body(id);
 
 		expect(token_type::keyword_proc_end);
-		auto proc_name_end = expect(token_type::identifier);
+		const auto proc_name_end = expect(token_type::identifier);
 
-		if (proc_name_end.data != proc_name_beg.data)
-			throw parser_exception::unmatching_procedure_names(proc_name_beg, proc_name_end);
+		if (proc_name_end.lexeme != proc_name_beg.lexeme)
+			throw parser_exception::unmatching_procedure_names(proc_name_beg, lex.locate(proc_name_beg),
+															   proc_name_end, lex.locate(proc_name_end));
 
-		return std::make_unique<ast::procedure_statement>(
-					std::move(proc_name_beg),
-					std::move(proc_name_end),
-					std::move(inner_statements)
-				);
+		return id;
 	}
 
-	ast::statement parser::parse_label()
+	ast::node_id parser::parse_label()
 	{
-		auto parse_inner_statement = [&]() -> ast::statement
+		expect(token_type::dot_label);
+		const auto identifier = expect(token_type::identifier);
+		expect(token_type::colon);
+
+		const auto id = nodes.append(ast::node_kind::label, intern(identifier), { identifier });
+
+		parse_block(label_body);
+		nodes.close_body(id);
+
+		return id;
+	}
+
+	ast::instruction_operand parser::parse_operand()
+	{
+		using kind = ast::instruction_operand::kind;
+
+		if (next_any_of(token_type::register_name))
 		{
-			if (no_more_tokens())
-				return {};
+			const auto token = advance();
+			const auto token_index = static_cast<uint32_t>(nodes.tokens.size());
+
+			nodes.tokens.push_back(token);
+
+			return {
+				.type       = register_operand_type(token.value),
+				.written_as = kind::reg,
+				.value      = token.value,
+				.symbol     = NO_SYMBOL,
+				.token      = token_index
+			};
+		}
+
+		if (!advance_if(token_type::bracket_open))
+			return parse_value_operand();
 
-			switch (token_it->type)
+		auto operand = parse_value_operand();
+		expect(token_type::bracket_close);
+
+		if (operand.type == arch::operand_type::address)
+			throw chasm_exception("Indirection at {} must be a constant, not an address.",
+								  chasm::to_string(lex.locate(nodes.tokens[operand.token])));
+
+		operand.type = arch::operand_type::address_indirect;
+		operand.written_as = kind::indirection;
+
+		return operand;
+	}
+
+	ast::instruction_operand parser::parse_value_operand()
+	{
+		using kind = ast::instruction_operand::kind;
+		using term_kind = ast::expression_term::kind;
+
+		const auto first_term = nodes.terms.size();
+
+		parse_expression();
+
+		const auto terms = std::span(nodes.terms).subspan(first_term);
+		const auto& first = terms.front();
+
+		//
+		// Operands written as a single value keep their value or symbol in the operand itself,
+		// so most operands never go through expression folding
+		//
+		if (terms.size() == 1 && first.what != term_kind::sprite_size)
+		{
+			const auto written_as = [&]
 			{
-				case token_type::keyword_proc_end:
-				case token_type::dot_label:
-					return {};
+				switch (first.what)
+				{
+					case term_kind::label:     return kind::label;
+					case term_kind::procedure: return kind::procedure;
+					case term_kind::sprite:    return kind::sprite;
+
+					default:
+						return kind::immediate;
+				}
+			}();
+
+			const ast::instruction_operand operand = {
+				.type       = first.is_address() ? arch::operand_type::address : arch::operand_type::immediate,
+				.written_as = written_as,
+				.value      = first.value,
+				.symbol     = first.symbol,
+				.token      = first.token
+			};
+
+			nodes.terms.pop_back();
+
+			return operand;
+		}
 
-				case token_type::keyword_define: return parse_define();
-				case token_type::keyword_config: return parse_config();
-				case token_type::keyword_raw:    return parse_raw();
-				case token_type::instruction:    return parse_instruction();
+		const bool is_address = std::ranges::any_of(terms, &ast::expression_term::is_address);
 
-				default:
-					throw parser_exception::unexpected_error(*token_it);
-			}
+		return {
+			.type        = is_address ? arch::operand_type::address : arch::operand_type::immediate,
+			.written_as  = kind::expression,
+			.value       = 0,
+			.symbol      = NO_SYMBOL,
+			.token       = first.token,
+			.first_term  = static_cast<uint32_t>(first_term),
+			.terms_count = static_cast<uint32_t>(terms.size())
 		};
+	}
 
-		expect(token_type::dot_label);
-		auto identifier = expect(token_type::identifier);
-		expect(token_type::colon);
+	void parser::push_term(ast::expression_term::kind what, const token& written, expression_operator op)
+	{
+		using term_kind = ast::expression_term::kind;
+
+		const auto names_symbol = what == term_kind::constant  ||
+								  what == term_kind::label     ||
+								  what == term_kind::procedure ||
+								  what == term_kind::sprite    ||
+								  what == term_kind::sprite_size;
+
+		nodes.terms.push_back({
+			.what   = what,
+			.op     = op,
+			.value  = what == term_kind::number ? written.value : uint16_t(0),
+			.symbol = names_symbol ? intern(written) : NO_SYMBOL,
+			.token  = static_cast<uint32_t>(nodes.tokens.size())
+		});
+
+		nodes.tokens.push_back(written);
+	}
+
+	void parser::parse_expression(uint8_t min_precedence)
+	{
+		parse_unary();
+
+		while (next_any_of(token_type::operator_sign))
+		{
+			const auto op = static_cast<expression_operator>(lookahead.value);
+			const auto precedence = binary_precedence(op);
 
-		std::vector<ast::statement> inner_statements;
+			if (precedence == 0 || precedence < min_precedence)
+				break;
 
-		while (auto block = parse_inner_statement())
-			inner_statements.push_back(std::move(block));
+			const auto sign = advance();
 
-		return std::make_unique<ast::label_statement>(
-					std::move(identifier),
-					std::move(inner_statements)
-				);
+			// left associative, the right operand only takes operators binding tighter
+			parse_expression(precedence + 1);
+			push_term(ast::expression_term::kind::binary, sign, op);
+		}
 	}
 
-	ast::instruction_operand parser::parse_operand()
+	void parser::parse_unary()
 	{
-		auto token = expect(token_type::register_name,
-							token_type::identifier,
-							token_type::numerical,
-							token_type::at_label,
-							token_type::dollar_proc,
-							token_type::hash_sprite,
-							token_type::bracket_open);
+		using term_kind = ast::expression_term::kind;
+
+		if (!next_any_of(token_type::operator_sign))
+			return parse_primary();
+
+		const auto sign = advance();
+		const auto op = static_cast<expression_operator>(sign.value);
+
+		if (op != expression_operator::subtract && op != expression_operator::bit_not)
+			throw parser_exception::unexpected_error(sign, lex.locate(sign));
+
+		parse_unary();
+		push_term(op == expression_operator::subtract ? term_kind::negate : term_kind::bit_not, sign);
+	}
+
+	void parser::parse_primary()
+	{
+		using term_kind = ast::expression_term::kind;
+
+		const auto token = expect(primary_first);
 
 		switch (token.type)
 		{
-			case token_type::register_name:
-				return ast::instruction_operand::make_reg(std::move(token));
+			case token_type::numerical:
+				return push_term(term_kind::number, token);
 
 			case token_type::at_label:
-			{
-				auto label = expect(token_type::identifier);
-				return ast::instruction_operand::make_label(std::move(label));
-			}
+				return push_term(term_kind::label, expect(token_type::identifier));
 
 			case token_type::dollar_proc:
-			{
-				auto proc = expect(token_type::identifier);
-				return ast::instruction_operand::make_proc(std::move(proc));
-			}
+				return push_term(term_kind::procedure, expect(token_type::identifier));
 
 			case token_type::hash_sprite:
-			{
-				auto sprite = expect(token_type::identifier);
-				return ast::instruction_operand::make_sprite(std::move(sprite));
-			}
+				return push_term(term_kind::sprite, expect(token_type::identifier));
 
-			case token_type::bracket_open:
-			{
-				auto inner_token = expect(token_type::identifier,
-										  token_type::numerical);
-				expect(token_type::bracket_close);
-				return ast::instruction_operand::make_indirect(std::move(inner_token));
-			}
+			case token_type::parenthesis_open:
+				parse_expression();
+				expect(token_type::parenthesis_close);
+				return;
 
 			default:
-				return ast::instruction_operand::make_immediate(std::move(token));
+				break;
 		}
+
+		//
+		// hi, lo and sizeof are only functions when called, they stay valid constant names
+		//
+		const auto is_function = next_any_of(token_type::parenthesis_open) &&
+								 (token.lexeme == "hi" || token.lexeme == "lo" || token.lexeme == "sizeof");
+
+		if (!is_function)
+			return push_term(term_kind::constant, token);
+
+		expect(token_type::parenthesis_open);
+
+		if (token.lexeme == "sizeof")
+		{
+			expect(token_type::hash_sprite);
+			push_term(term_kind::sprite_size, expect(token_type::identifier));
+		}
+		else
+		{
+			parse_expression();
+			push_term(token.lexeme == "hi" ? term_kind::high_byte : term_kind::low_byte, token);
+		}
+
+		expect(token_type::parenthesis_close);
 	}
 }
@@ -0,0 +1,124 @@
+#include <exception>
+#include <thread>
+
+#include <chasm/generator.hpp>
+#include <chasm/spsc_ring.hpp>
+#include <chasm/pipeline.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		//
+		// Nodes parsed before the statements are handed over to the code generation
+		//
+		constexpr size_t FRAGMENT_NODES = 1024;
+
+		struct parsed_fragment
+		{
+			ast::flat_nodes nodes;
+
+			// names interned by the parser since the previous fragment, in interning order
+			std::vector<std::string_view> new_names;
+
+			// set on a last fragment without nodes if parsing failed
+			std::exception_ptr error;
+		};
+
+		using fragment_ring = spsc_ring<parsed_fragment, 8>;
+	}
+
+	std::optional<std::vector<uint8_t>> assemble_pipelined(std::span<const char> source,
+														   const assembler_options& options,
+														   const std::filesystem::path& source_file,
+														   std::vector<std::filesystem::path>* dependencies)
+	{
+		auto lex = lexer(source);
+		lex.lex_concurrently();
+
+		auto parse = parser(lex);
+		fragment_ring fragments;
+
+		auto chain = source_file.empty() ? std::vector<std::filesystem::path>() : std::vector { source_file };
+		parse.resolve_includes(std::move(chain), options.includes);
+
+		//
+		// Parsing stage, an empty fragment is never pushed so the ring is
+		// closed right after the last statements were handed over
+		//
+		std::jthread parsing_thread([&]
+		{
+			parsed_fragment fragment;
+			size_t names_sent = 0;
+
+			try
+			{
+				for (fragment.nodes = parse.parse_fragment(FRAGMENT_NODES);
+					 fragment.nodes.size() > 0;
+					 fragment.nodes = parse.parse_fragment(FRAGMENT_NODES))
+				{
+					const auto& names = parse.symbols();
+
+					// interned names never move, the views stay valid while the parser lives
+					for (; names_sent < names.size(); ++names_sent)
+						fragment.new_names.push_back(names.name(static_cast<symbol_id>(names_sent)));
+
+					if (!fragments.push(std::exchange(fragment, {})))
+						return;
+				}
+			}
+			catch (...)
+			{
+				fragments.push({ .nodes = {}, .new_names = {}, .error = std::current_exception() });
+			}
+
+			fragments.close();
+		});
+
+		//
+		// Code generation stage, on the calling thread. The parser's interner keeps growing
+		// so names are interned again in the same order, which gives them the same ids.
+		//
+		interner names;
+		generator generator(names, lex.source(), options);
+
+		parsed_fragment fragment;
+		bool any_nodes = false;
+
+		try
+		{
+			while (fragments.pop(fragment))
+			{
+				if (fragment.error)
+					std::rethrow_exception(fragment.error);
+
+				for (const auto name : fragment.new_names)
+					static_cast<void>(names.intern(name));
+
+				generator.generate(fragment.nodes);
+
+				any_nodes = true;
+			}
+		}
+		catch (...)
+		{
+			// stops the parsing stage before it is joined
+			fragments.close();
+			throw;
+		}
+
+		// every file was included once the parser is done
+		parsing_thread.join();
+
+		if (dependencies)
+			dependencies->insert(dependencies->end(), parse.dependencies().begin(), parse.dependencies().end());
+
+		if (!any_nodes)
+			return std::nullopt;
+
+		return generator.link();
+	}
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <utility>
+#include <limits>
+
+#include <chasm/precompiled_module.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		constexpr std::array<uint8_t, 4> MAGIC = { 'C', '8', 'M', 0 };
+
+		// magic, version, reserved, then the size of each part
+		constexpr size_t HEADER_SIZE = 4 + 2 + 2 + 6 * 4;
+
+		// bytes of a record of each table, names and code are counted in bytes
+		constexpr std::array<size_t, 6> RECORD_SIZES = { 16, 8, 1 + arch::MAX_SPRITE_ROWS, 20, 1, 1 };
+
+		[[nodiscard]]
+		uint32_t read_u32(std::span<const uint8_t> bytes, size_t at)
+		{
+			return uint32_t(bytes[at]) | uint32_t(bytes[at + 1]) << 8 | uint32_t(bytes[at + 2]) << 16 | uint32_t(bytes[at + 3]) << 24;
+		}
+
+		[[nodiscard]]
+		uint16_t read_u16(std::span<const uint8_t> bytes, size_t at)
+		{
+			return static_cast<uint16_t>(bytes[at] | bytes[at + 1] << 8);
+		}
+
+		void write_u32(std::vector<uint8_t>& bytes, uint32_t value)
+		{
+			for (int shift = 0; shift < 32; shift += 8)
+				bytes.push_back(static_cast<uint8_t>(value >> shift));
+		}
+
+		void write_u16(std::vector<uint8_t>& bytes, uint16_t value)
+		{
+			bytes.push_back(static_cast<uint8_t>(value));
+			bytes.push_back(static_cast<uint8_t>(value >> 8));
+		}
+	}
+
+	precompiled_module::precompiled_module(const std::filesystem::path& path)
+		: file(path)
+	{
+		validate(path);
+	}
+
+	bool precompiled_module::is_module(const std::filesystem::path& path)
+	{
+		return path.extension() == EXTENSION;
+	}
+
+	void precompiled_module::validate(const std::filesystem::path& path)
+	{
+		const auto bytes = file.bytes();
+
+		if (bytes.size() < HEADER_SIZE || !std::ranges::equal(bytes.first(MAGIC.size()), MAGIC))
+			throw module_exception::invalid_module(path, "missing module header");
+
+		if (const auto version = read_u16(bytes, 4); version != VERSION)
+			throw module_exception::invalid_module(path, std::format("unsupported version {}", version));
+
+		size_t offset = HEADER_SIZE;
+
+		for (size_t index = 0; index < parts_count; ++index)
+		{
+			sizes[index] = read_u32(bytes, 8 + index * 4);
+			offsets[index] = offset;
+
+			offset += size_t(sizes[index]) * RECORD_SIZES[index];
+		}
+
+		if (offset != bytes.size())
+			throw module_exception::invalid_module(path, "truncated or oversized file");
+
+		//
+		// Everything records refer to is checked once here, accessors trust them afterwards
+		//
+		for (size_t i = 0; i < symbols_count(); ++i)
+		{
+			const auto entry = record(symbols_table, i);
+
+			const auto kind = static_cast<symbol_kind>(entry[0]);
+			const auto name_offset = read_u32(entry, 4);
+			const auto name_size = read_u32(entry, 8);
+			const auto value = read_u32(entry, 12);
+
+			if (name_size == 0 || uint64_t(name_offset) + name_size > sizes[names_blob])
+				throw module_exception::invalid_module(path, "symbol name out of bounds");
+
+			const bool valid_value = kind == symbol_kind::procedure ? value < sections_count()
+								   : kind == symbol_kind::sprite    ? value < sprites_count()
+								   : kind == symbol_kind::constant  && value <= std::numeric_limits<arch::imm>::max();
+
+			if (!valid_value)
+				throw module_exception::invalid_module(path, "invalid symbol record");
+		}
+
+		for (size_t i = 0; i < sections_count(); ++i)
+		{
+			const auto entry = record(sections_table, i);
+
+			if (uint64_t(read_u32(entry, 0)) + read_u32(entry, 4) > sizes[code_blob])
+				throw module_exception::invalid_module(path, "section out of bounds");
+		}
+
+		for (size_t i = 0; i < sprites_count(); ++i)
+			if (record(sprites_table, i)[0] > arch::MAX_SPRITE_ROWS)
+				throw module_exception::invalid_module(path, "sprite with too many rows");
+
+		for (size_t i = 0; i < relocations_count(); ++i)
+		{
+			const auto [section, location, target, addend, to_symbol] = relocation_at(i);
+
+			if (section >= sections_count() || uint64_t(location) + sizeof(arch::opcode) > this->section(section).size())
+				throw module_exception::invalid_module(path, "relocation out of bounds");
+
+			if (target >= (to_symbol ? symbols_count() : sections_count()))
+				throw module_exception::invalid_module(path, "relocation to an unknown target");
+		}
+	}
+
+	std::span<const uint8_t> precompiled_module::record(part table, size_t index) const
+	{
+		return file.bytes().subspan(offsets[table] + index * RECORD_SIZES[table], RECORD_SIZES[table]);
+	}
+
+	size_t precompiled_module::symbols_count() const
+	{
+		return sizes[symbols_table];
+	}
+
+	size_t precompiled_module::sections_count() const
+	{
+		return sizes[sections_table];
+	}
+
+	size_t precompiled_module::sprites_count() const
+	{
+		return sizes[sprites_table];
+	}
+
+	size_t precompiled_module::relocations_count() const
+	{
+		return sizes[relocations_table];
+	}
+
+	precompiled_module::symbol precompiled_module::symbol_at(size_t index) const
+	{
+		const auto entry = record(symbols_table, index);
+		const auto names = file.text().subspan(offsets[names_blob], sizes[names_blob]);
+
+		return {
+			.kind  = static_cast<symbol_kind>(entry[0]),
+			.name  = std::string_view(names.subspan(read_u32(entry, 4), read_u32(entry, 8)).data(), read_u32(entry, 8)),
+			.value = read_u32(entry, 12)
+		};
+	}
+
+	std::span<const uint8_t> precompiled_module::section(size_t index) const
+	{
+		const auto entry = record(sections_table, index);
+
+		return file.bytes().subspan(offsets[code_blob] + read_u32(entry, 0), read_u32(entry, 4));
+	}
+
+	arch::sprite precompiled_module::sprite(size_t index) const
+	{
+		const auto entry = record(sprites_table, index);
+
+		arch::sprite sprite {};
+		sprite.row_count = entry[0];
+		std::ranges::copy(entry.subspan(1), sprite.data.begin());
+
+		return sprite;
+	}
+
+	precompiled_module::relocation precompiled_module::relocation_at(size_t index) const
+	{
+		const auto entry = record(relocations_table, index);
+
+		return {
+			.section   = read_u32(entry, 0),
+			.offset    = read_u32(entry, 4),
+			.target    = read_u32(entry, 8),
+			.addend    = static_cast<int32_t>(read_u32(entry, 12)),
+			.to_symbol = entry[16] != 0
+		};
+	}
+
+	std::span<const uint8_t> precompiled_module::bytes() const
+	{
+		return file.bytes();
+	}
+
+	uint32_t module_writer::add_symbol(precompiled_module::symbol_kind kind, std::string_view name, uint32_t value)
+	{
+		auto& record = parts[part::symbols_table];
+
+		record.push_back(std::to_underlying(kind));
+		record.insert(record.end(), 3, 0);
+		write_u32(record, sizes[part::names_blob]);
+		write_u32(record, static_cast<uint32_t>(name.size()));
+		write_u32(record, value);
+
+		parts[part::names_blob].insert(parts[part::names_blob].end(), name.begin(), name.end());
+		sizes[part::names_blob] += static_cast<uint32_t>(name.size());
+
+		return sizes[part::symbols_table]++;
+	}
+
+	uint32_t module_writer::add_section(std::span<const uint8_t> code)
+	{
+		write_u32(parts[part::sections_table], sizes[part::code_blob]);
+		write_u32(parts[part::sections_table], static_cast<uint32_t>(code.size()));
+
+		parts[part::code_blob].insert(parts[part::code_blob].end(), code.begin(), code.end());
+		sizes[part::code_blob] += static_cast<uint32_t>(code.size());
+
+		return sizes[part::sections_table]++;
+	}
+
+	uint32_t module_writer::add_sprite(const arch::sprite& sprite)
+	{
+		auto& record = parts[part::sprites_table];
+
+		record.push_back(sprite.row_count);
+		record.insert(record.end(), sprite.data.begin(), sprite.data.end());
+
+		return sizes[part::sprites_table]++;
+	}
+
+	void module_writer::add_relocation(const precompiled_module::relocation& relocation)
+	{
+		auto& record = parts[part::relocations_table];
+
+		write_u32(record, relocation.section);
+		write_u32(record, relocation.offset);
+		write_u32(record, relocation.target);
+		write_u32(record, static_cast<uint32_t>(relocation.addend));
+		record.push_back(relocation.to_symbol);
+		record.insert(record.end(), 3, 0);
+
+		++sizes[part::relocations_table];
+	}
+
+	std::vector<uint8_t> module_writer::bytes() const
+	{
+		std::vector<uint8_t> bytes(MAGIC.begin(), MAGIC.end());
+
+		write_u16(bytes, precompiled_module::VERSION);
+		write_u16(bytes, 0);
+
+		for (const auto size : sizes)
+			write_u32(bytes, size);
+
+		for (const auto& content : parts)
+			bytes.insert(bytes.end(), content.begin(), content.end());
+
+		return bytes;
+	}
+}
@@ -0,0 +1,211 @@
+#include <cstdint>
+#include <bit>
+
+#include <chasm/scan.hpp>
+
+#if defined(__AVX2__)
+	#define CHASM_SCAN_AVX2
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CHASM_SCAN_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+namespace chasm::scan
+{
+	namespace
+	{
+		constexpr bool is_whitespace(char c)
+		{
+			return c == ' ' || (c >= '\t' && c <= '\r');
+		}
+
+		constexpr bool is_identifier(char c)
+		{
+			return (c >= 'a' && c <= 'z') ||
+			       (c >= 'A' && c <= 'Z') ||
+			       (c >= '0' && c <= '9') ||
+			       c == '_';
+		}
+
+#if defined(CHASM_SCAN_AVX2)
+
+		using block = __m256i;
+		constexpr size_t block_size = sizeof(block);
+
+		block load(const char* p)         { return _mm256_loadu_si256(reinterpret_cast<const block*>(p)); }
+		block splat(char c)               { return _mm256_set1_epi8(c); }
+		block eq(block a, block b)        { return _mm256_cmpeq_epi8(a, b); }
+		block sub(block a, block b)       { return _mm256_sub_epi8(a, b); }
+		block either(block a, block b)    { return _mm256_or_si256(a, b); }
+		block le_unsigned(block a, block b) { return _mm256_cmpeq_epi8(_mm256_min_epu8(a, b), a); }
+		uint32_t mask(block a)            { return static_cast<uint32_t>(_mm256_movemask_epi8(a)); }
+
+#elif defined(CHASM_SCAN_SSE2)
+
+		using block = __m128i;
+		constexpr size_t block_size = sizeof(block);
+
+		block load(const char* p)         { return _mm_loadu_si128(reinterpret_cast<const block*>(p)); }
+		block splat(char c)               { return _mm_set1_epi8(c); }
+		block eq(block a, block b)        { return _mm_cmpeq_epi8(a, b); }
+		block sub(block a, block b)       { return _mm_sub_epi8(a, b); }
+		block either(block a, block b)    { return _mm_or_si128(a, b); }
+		block le_unsigned(block a, block b) { return _mm_cmpeq_epi8(_mm_min_epu8(a, b), a); }
+		uint32_t mask(block a)            { return static_cast<uint32_t>(_mm_movemask_epi8(a)); }
+
+#endif
+
+#if defined(CHASM_SCAN_AVX2) || defined(CHASM_SCAN_SSE2)
+
+		constexpr uint32_t full_mask = block_size == 32 ? 0xFFFF'FFFF : 0xFFFF;
+
+		//
+		// One bit per byte of the block, set when the byte is whitespace
+		//
+		uint32_t whitespace_mask(block chars)
+		{
+			const block controls = le_unsigned(sub(chars, splat('\t')), splat('\r' - '\t'));
+			return mask(either(controls, eq(chars, splat(' '))));
+		}
+
+		//
+		// One bit per byte of the block, set when the byte is in [A-Za-z0-9_]
+		//
+		uint32_t identifier_mask(block chars)
+		{
+			const block lower  = either(chars, splat(0x20));
+			const block alpha  = le_unsigned(sub(lower, splat('a')), splat('z' - 'a'));
+			const block digit  = le_unsigned(sub(chars, splat('0')), splat('9' - '0'));
+			const block under  = eq(chars, splat('_'));
+
+			return mask(either(either(alpha, digit), under));
+		}
+
+		uint32_t newline_mask(block chars)
+		{
+			return mask(eq(chars, splat('\n')));
+		}
+
+		//
+		// Length of the run of bytes for which block_mask sets the bits,
+		// the tail that does not fill a block is handled by the scalar predicate
+		//
+		template<typename BlockMask, typename Predicate>
+		size_t run_length(std::string_view text, BlockMask block_mask, Predicate predicate)
+		{
+			size_t i = 0;
+
+			for (; i + block_size <= text.size(); i += block_size)
+			{
+				const uint32_t matching = block_mask(load(text.data() + i));
+
+				if (matching != full_mask)
+					return i + static_cast<size_t>(std::countr_one(matching));
+			}
+
+			while (i < text.size() && predicate(text[i]))
+				++i;
+
+			return i;
+		}
+
+#else
+
+		template<typename Predicate>
+		size_t run_length(std::string_view text, Predicate predicate)
+		{
+			size_t i = 0;
+
+			while (i < text.size() && predicate(text[i]))
+				++i;
+
+			return i;
+		}
+
+#endif
+	}
+
+#if defined(CHASM_SCAN_AVX2) || defined(CHASM_SCAN_SSE2)
+
+	size_t whitespace_run(std::string_view text)
+	{
+		return run_length(text, whitespace_mask, is_whitespace);
+	}
+
+	size_t identifier_run(std::string_view text)
+	{
+		return run_length(text, identifier_mask, is_identifier);
+	}
+
+	size_t line_end(std::string_view text)
+	{
+		size_t i = 0;
+
+		for (; i + block_size <= text.size(); i += block_size)
+		{
+			const uint32_t newlines = newline_mask(load(text.data() + i));
+
+			if (newlines != 0)
+				return i + static_cast<size_t>(std::countr_zero(newlines));
+		}
+
+		const auto tail = text.find('\n', i);
+		return tail == std::string_view::npos ? text.size() : tail;
+	}
+
+	size_t count_newlines(std::string_view text)
+	{
+		size_t i = 0;
+		size_t count = 0;
+
+		for (; i + block_size <= text.size(); i += block_size)
+			count += static_cast<size_t>(std::popcount(newline_mask(load(text.data() + i))));
+
+		for (; i < text.size(); ++i)
+			count += text[i] == '\n';
+
+		return count;
+	}
+
+	std::string_view kernel_name()
+	{
+		return block_size == 32 ? "avx2" : "sse2";
+	}
+
+#else
+
+	size_t whitespace_run(std::string_view text)
+	{
+		return run_length(text, is_whitespace);
+	}
+
+	size_t identifier_run(std::string_view text)
+	{
+		return run_length(text, is_identifier);
+	}
+
+	size_t line_end(std::string_view text)
+	{
+		const auto end = text.find('\n');
+		return end == std::string_view::npos ? text.size() : end;
+	}
+
+	size_t count_newlines(std::string_view text)
+	{
+		size_t count = 0;
+
+		for (const char c : text)
+			count += c == '\n';
+
+		return count;
+	}
+
+	std::string_view kernel_name()
+	{
+		return "scalar";
+	}
+
+#endif
+}
@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <exception>
+#include <charconv>
+#include <utility>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <format>
+#include <vector>
+
+#include <chasm/ds/listing.hpp>
+#include <chasm/diagnostics.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/server.hpp>
+#include <chasm/log.hpp>
+
+#if !defined(_WIN32)
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <cerrno>
+#endif
+
+
+namespace chasm
+{
+	namespace
+	{
+		// how often blocked socket operations check for a shutdown request
+		constexpr int STOP_POLL_MS = 100;
+
+		[[nodiscard]]
+		std::string to_hex(std::span<const uint8_t> bytes)
+		{
+			std::string hex;
+			hex.reserve(bytes.size() * 2);
+
+			for (const uint8_t byte : bytes)
+				hex += std::format("{:02X}", byte);
+
+			return hex;
+		}
+
+		[[nodiscard]]
+		std::vector<uint8_t> from_hex(std::string_view hex)
+		{
+			if (hex.size() % 2 != 0)
+				throw server_exception::invalid_request("\"bytes\" must have an even count of hexadecimal digits");
+
+			std::vector<uint8_t> bytes(hex.size() / 2);
+
+			for (size_t i = 0; i < bytes.size(); ++i)
+			{
+				const auto digits = hex.substr(i * 2, 2);
+
+				if (std::from_chars(digits.data(), digits.data() + 2, bytes[i], 16).ptr != digits.data() + 2)
+					throw server_exception::invalid_request("\"bytes\" must only have hexadecimal digits");
+			}
+
+			return bytes;
+		}
+
+		[[nodiscard]]
+		const json::value* member(const json::value& object, std::string_view key, bool required)
+		{
+			const auto found = object.find(key);
+
+			if (!found && required)
+				throw server_exception::invalid_request(std::format("missing \"{}\"", key));
+
+			return found;
+		}
+
+		[[nodiscard]]
+		arch::addr address_member(const json::value& object, std::string_view key, arch::addr fallback)
+		{
+			const auto found = member(object, key, false);
+
+			if (!found)
+				return fallback;
+
+			const auto number = found->as_number();
+
+			if (number < 0 || number > std::numeric_limits<arch::addr>::max() || number != static_cast<arch::addr>(number))
+				throw server_exception::invalid_request(std::format("\"{}\" is not an address", key));
+
+			return static_cast<arch::addr>(number);
+		}
+
+		[[nodiscard]]
+		bool flag_member(const json::value& object, std::string_view key)
+		{
+			const auto found = member(object, key, false);
+
+			return found && found->as_bool();
+		}
+
+		void append_id(std::string& response, const json::value* id)
+		{
+			response += "{\"id\": ";
+
+			if (id && id->is_number())
+				response += json::to_string(id->as_number());
+			else if (id && id->is_string())
+				json::append_string(response, id->as_string());
+			else
+				response += "null";
+		}
+
+		[[nodiscard]]
+		std::string error_response(const json::value* id, std::string_view error)
+		{
+			std::string response;
+
+			append_id(response, id);
+			response += ", \"ok\": false, \"error\": ";
+			json::append_string(response, error);
+
+			return response + '}';
+		}
+
+#if !defined(_WIN32)
+		// false if the client is gone
+		[[nodiscard]]
+		bool send_all(int client, std::string_view data)
+		{
+			for (size_t sent = 0; sent < data.size();)
+			{
+#if defined(MSG_NOSIGNAL)
+				const auto written = ::send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+				const auto written = ::send(client, data.data() + sent, data.size() - sent, 0);
+#endif
+				if (written < 0 && errno == EINTR)
+					continue;
+
+				if (written <= 0)
+					return false;
+
+				sent += static_cast<size_t>(written);
+			}
+
+			return true;
+		}
+
+		// answers a connection that is not served with the reason and closes it
+		void refuse(int client, const std::exception& reason)
+		{
+			static_cast<void>(send_all(client, error_response(nullptr, reason.what()) + '\n'));
+			::close(client);
+		}
+#endif
+	}
+
+	server::server(const server_limits& serving_limits)
+		: limits(serving_limits),
+		  includes(serving_limits.cache)
+	{}
+
+	std::string server::handle(std::string_view request)
+	{
+		++requests_count;
+
+		json::value document;
+		std::string response;
+
+		try
+		{
+			document = json::parse(request);
+
+			if (!document.is_object())
+				throw server_exception::invalid_request("expected an object");
+
+			const auto& method = member(document, "method", true)->as_string();
+			std::string members;
+
+			if (method == "assemble")
+				members = assemble(document);
+			else if (method == "disassemble")
+				members = disassemble(document);
+			else if (method == "stats")
+				members = stats();
+			else if (method == "shutdown")
+				stop_requested = true;
+			else
+				throw server_exception::invalid_request(std::format("unknown method \"{}\"", method));
+
+			append_id(response, document.find("id"));
+			response += ", \"ok\": true" + members + '}';
+		}
+		catch (const std::exception& error)
+		{
+			response = error_response(document.find("id"), error.what());
+		}
+
+		return response;
+	}
+
+	std::string server::assemble(const json::value& request)
+	{
+		const auto& source = member(request, "source", true)->as_string();
+
+		const auto file = member(request, "file", false);
+		const auto source_file = file ? std::filesystem::path(file->as_string()) : std::filesystem::path();
+
+		assembler_options options;
+		options.includes = &includes;
+
+		if (const auto requested = member(request, "options", false))
+		{
+			options.relocate = address_member(*requested, "relocate", options.relocate);
+			options.super = flag_member(*requested, "super");
+			options.pad_sprites = flag_member(*requested, "pad_sprites");
+		}
+
+		//
+		// Anything logged while assembling belongs to the response, the output stream only carries responses
+		//
+		diagnostics sink;
+		std::vector<std::string> log_lines;
+		diagnosed<std::vector<uint8_t>> binary = std::unexpected(reported_errors { 1 });
+
+		try
+		{
+			const log::capture capture(log_lines);
+			binary = chasm::assemble(source, sink, options, source_file);
+		}
+		catch (const std::exception& error)
+		{
+			sink.error(error.what());
+		}
+
+		const bool assembled = binary && !sink.has_errors();
+
+		std::string members = std::format(", \"assembled\": {}, \"binary\": ", assembled);
+
+		if (assembled)
+			members += '"' + to_hex(*binary) + '"';
+		else
+			members += "null";
+
+		members += ", \"report\": " + sink.to_json(source_file.string()) + ", \"log\": [";
+
+		for (size_t i = 0; i < log_lines.size(); ++i)
+		{
+			if (i > 0)
+				members += ", ";
+
+			json::append_string(members, log_lines[i]);
+		}
+
+		return members + ']';
+	}
+
+	std::string server::disassemble(const json::value& request)
+	{
+		const auto bytes = from_hex(member(request, "bytes", true)->as_string());
+		const auto load_address = address_member(request, "load_address", 0x200);
+
+		std::string members = ", \"instructions\": [";
+		bool first = true;
+
+		for (const auto& [address, opcode, path_start, procedure_start, text] : ds::make_listing(bytes, load_address))
+		{
+			if (!std::exchange(first, false))
+				members += ", ";
+
+			members += std::format("{{\"address\": {}, \"opcode\": {}, \"path_start\": {}, \"procedure_start\": {}, \"text\": ",
+								   address,
+								   opcode,
+								   path_start,
+								   procedure_start);
+
+			json::append_string(members, text);
+			members += '}';
+		}
+
+		return members + ']';
+	}
+
+	std::string server::stats() const
+	{
+		return std::format(", \"requests\": {}, \"cached_files\": {}, \"cached_bytes\": {}, \"evicted_files\": {}",
+						   requests_count.load(),
+						   includes.size(),
+						   includes.bytes(),
+						   includes.evictions());
+	}
+
+	void server::serve(std::istream& input, std::ostream& output)
+	{
+		std::string line;
+
+		while (!stopped() && std::getline(input, line))
+		{
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			output << handle(line) << std::endl;
+		}
+	}
+
+	bool server::stopped() const
+	{
+		return stop_requested;
+	}
+
+#if defined(_WIN32)
+
+	void server::serve_socket(const std::filesystem::path& socket_path)
+	{
+		throw server_exception::socket_error(socket_path, "Unix domain sockets are not supported on this platform, serve the standard input instead");
+	}
+
+	void server::serve_connection(int)
+	{}
+
+#else
+
+	void server::serve_socket(const std::filesystem::path& socket_path)
+	{
+		sockaddr_un address {};
+		address.sun_family = AF_UNIX;
+
+		const auto native = socket_path.string();
+
+		if (native.size() >= sizeof(address.sun_path))
+			throw server_exception::socket_error(socket_path, "path too long");
+
+		std::ranges::copy(native, address.sun_path);
+
+		const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (listener < 0)
+			throw server_exception::socket_error(socket_path, "could not be created");
+
+		// a socket file left by a server that did not stop cleanly
+		if (std::filesystem::is_socket(socket_path))
+			std::filesystem::remove(socket_path);
+
+		if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0)
+		{
+			::close(listener);
+			throw server_exception::socket_error(socket_path, "could not be bound");
+		}
+
+		{
+			std::vector<std::future<void>> connections;
+
+			while (!stopped())
+			{
+				pollfd pending { .fd = listener, .events = POLLIN, .revents = 0 };
+
+				if (::poll(&pending, 1, STOP_POLL_MS) <= 0)
+					continue;
+
+				if (const int client = ::accept(listener, nullptr, nullptr); client >= 0)
+				{
+					// threads of closed connections are joined as new ones come, not only at shutdown
+					std::erase_if(connections, [](const auto& connection)
+					{
+						return connection.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+					});
+
+					if (connections.size() >= limits.max_connections)
+					{
+						refuse(client, server_exception::too_many_connections(limits.max_connections));
+						continue;
+					}
+
+					connections.push_back(std::async(std::launch::async, [this, client] { serve_connection(client); }));
+				}
+			}
+		}
+
+		::close(listener);
+		std::filesystem::remove(socket_path);
+	}
+
+	void server::serve_connection(int client)
+	{
+		std::string received;
+		char buffer[4096];
+
+		// received bytes before this offset have no newline, they are not searched again
+		size_t scanned = 0;
+
+		while (!stopped())
+		{
+			pollfd pending { .fd = client, .events = POLLIN, .revents = 0 };
+
+			if (::poll(&pending, 1, STOP_POLL_MS) <= 0)
+				continue;
+
+			const auto count = ::read(client, buffer, sizeof(buffer));
+
+			if (count < 0 && errno == EINTR)
+				continue;
+
+			if (count <= 0)
+				break;
+
+			received.append(buffer, static_cast<size_t>(count));
+
+			//
+			// Complete lines are answered in place, their bytes are dropped at once afterwards
+			//
+			size_t line_start = 0;
+
+			for (auto end = received.find('\n', scanned); end != std::string::npos; end = received.find('\n', line_start))
+			{
+				const auto line = std::string_view(received).substr(line_start, end - line_start);
+				line_start = end + 1;
+
+				if (line.find_first_not_of(" \t\r") == std::string_view::npos)
+					continue;
+
+				if (line.size() > limits.max_request_size)
+				{
+					refuse(client, server_exception::request_too_large(limits.max_request_size));
+					return;
+				}
+
+				if (!send_all(client, handle(line) + '\n'))
+				{
+					::close(client);
+					return;
+				}
+			}
+
+			received.erase(0, line_start);
+			scanned = received.size();
+
+			// what is left is the start of a line, it is refused before it grows any further
+			if (received.size() > limits.max_request_size)
+			{
+				refuse(client, server_exception::request_too_large(limits.max_request_size));
+				return;
+			}
+		}
+
+		::close(client);
+	}
+
+#endif
+}
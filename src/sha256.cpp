@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <format>
+#include <bit>
+
+#include <chasm/sha256.hpp>
+
+
+namespace chasm
+{
+	namespace
+	{
+		constexpr std::array<uint32_t, 64> ROUND_CONSTANTS = {
+			0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+			0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+			0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+			0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+			0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+			0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+			0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+			0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+		};
+	}
+
+	void sha256::update(std::span<const uint8_t> data)
+	{
+		total_size += data.size();
+
+		if (pending_size > 0)
+		{
+			const auto taken = std::min(data.size(), pending.size() - pending_size);
+
+			std::ranges::copy(data.first(taken), pending.begin() + static_cast<ptrdiff_t>(pending_size));
+			pending_size += taken;
+			data = data.subspan(taken);
+
+			if (pending_size < pending.size())
+				return;
+
+			compress(pending.data());
+			pending_size = 0;
+		}
+
+		for (; data.size() >= pending.size(); data = data.subspan(pending.size()))
+			compress(data.data());
+
+		std::ranges::copy(data, pending.begin());
+		pending_size = data.size();
+	}
+
+	void sha256::update(std::string_view data)
+	{
+		update(std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+	}
+
+	sha256::digest sha256::finish()
+	{
+		const uint64_t bits = total_size * 8;
+
+		//
+		// A single 1 bit, zeros up to 56 bytes modulo 64, then the size in bits as 64 bits big-endian
+		//
+		const uint8_t marker = 0x80;
+		update(std::span(&marker, 1));
+
+		const std::array<uint8_t, 64> zeros {};
+		update(std::span(zeros).first((pending.size() + 56 - pending_size) % pending.size()));
+
+		std::array<uint8_t, 8> length {};
+
+		for (size_t i = 0; i < length.size(); ++i)
+			length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+
+		update(length);
+
+		digest value {};
+
+		for (size_t i = 0; i < state.size(); ++i)
+			for (size_t byte = 0; byte < 4; ++byte)
+				value[i * 4 + byte] = static_cast<uint8_t>(state[i] >> (24 - 8 * byte));
+
+		return value;
+	}
+
+	sha256::digest sha256::hash(std::span<const uint8_t> data)
+	{
+		sha256 hasher;
+		hasher.update(data);
+
+		return hasher.finish();
+	}
+
+	std::string sha256::to_hex(const digest& value)
+	{
+		std::string hex;
+		hex.reserve(value.size() * 2);
+
+		for (const uint8_t byte : value)
+			hex += std::format("{:02x}", byte);
+
+		return hex;
+	}
+
+	void sha256::compress(const uint8_t* block)
+	{
+		std::array<uint32_t, 64> schedule {};
+
+		for (size_t i = 0; i < 16; ++i)
+			schedule[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 | uint32_t(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+
+		for (size_t i = 16; i < 64; ++i)
+		{
+			const auto s0 = std::rotr(schedule[i - 15], 7) ^ std::rotr(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+			const auto s1 = std::rotr(schedule[i - 2], 17) ^ std::rotr(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+
+			schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+		}
+
+		auto [a, b, c, d, e, f, g, h] = state;
+
+		for (size_t i = 0; i < 64; ++i)
+		{
+			const auto s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+			const auto choice = (e & f) ^ (~e & g);
+			const auto t1 = h + s1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+			const auto s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+			const auto majority = (a & b) ^ (a & c) ^ (b & c);
+			const auto t2 = s0 + majority;
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
@@ -1,16 +1,41 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
 #include <chasm/stream.hpp>
+#include <chasm/scan.hpp>
 
 
 namespace chasm
 {
     stream::stream(std::string&& src_stream)
-		: buffer(std::move(src_stream)),
-		  read { 0 }
+		: owned(std::move(src_stream)),
+		  buffer(owned),
+		  read { 0 },
+		  end { buffer.size() },
+		  attached_end { buffer.size() + 1 }
+	{
+		if (buffer.size() > std::numeric_limits<source_offset>::max())
+			throw std::runtime_error("Source buffers larger than 4GiB are not supported");
+	}
+
+	stream::stream(std::span<const char> src_view)
+		: stream(src_view, 0, src_view.size())
 	{}
 
+	stream::stream(std::span<const char> src_view, size_t range_begin, size_t range_end)
+		: buffer(src_view.data(), src_view.size()),
+		  read { std::min(range_begin, src_view.size()) },
+		  end { std::min(range_end, src_view.size()) },
+		  attached_end { buffer.size() + 1 }
+	{
+		if (buffer.size() > std::numeric_limits<source_offset>::max())
+			throw std::runtime_error("Source buffers larger than 4GiB are not supported");
+	}
+
     bool stream::eof() const
     {
-        return read >= buffer.size();
+        return read >= end;
     }
 
 	char stream::peek() const
@@ -34,4 +59,98 @@ namespace chasm
         if (read > 0)
             --read;
     }
+
+	std::string_view stream::pending() const
+	{
+		if (eof())
+			return {};
+
+		return buffer.substr(read, end - read);
+	}
+
+	void stream::skip(size_t count)
+	{
+		read = std::min(read + count, end);
+	}
+
+	size_t stream::position() const
+	{
+		return read;
+	}
+
+	std::string_view stream::slice(size_t begin) const
+	{
+		return buffer.substr(begin, read - begin);
+	}
+
+	std::string_view stream::text() const
+	{
+		return buffer;
+	}
+
+	source_location stream::locate(size_t offset) const
+	{
+		if (offset > buffer.size())
+		{
+			std::scoped_lock lock(attached_guard);
+
+			const auto next = std::ranges::upper_bound(attached, offset, {}, &attached_stream::base);
+
+			if (next != attached.begin())
+			{
+				const auto& [base, included, path] = *std::prev(next);
+				auto location = included->locate(offset - base);
+
+				// locations in files included by the included file already name their file
+				if (location.file.empty())
+					location.file = path;
+
+				return location;
+			}
+		}
+
+		std::call_once(lines_indexed, [this] { index_lines(); });
+
+		const auto next_line = std::ranges::upper_bound(line_starts, offset);
+		const auto line = static_cast<size_t>(std::distance(line_starts.begin(), next_line));
+
+		return {
+			.col  = offset - line_starts[line - 1] + 1,
+			.line = line
+		};
+	}
+
+	source_offset stream::attach(std::shared_ptr<const stream> included, std::string path)
+	{
+		std::scoped_lock lock(attached_guard);
+
+		const auto base = attached_end;
+
+		if (base + included->extent() > std::numeric_limits<source_offset>::max())
+			throw std::runtime_error("Sources larger than 4GiB with their included files are not supported");
+
+		attached_end += included->extent();
+		attached.push_back({ static_cast<source_offset>(base), std::move(included), std::move(path) });
+
+		return static_cast<source_offset>(base);
+	}
+
+	size_t stream::extent() const
+	{
+		std::scoped_lock lock(attached_guard);
+
+		return attached_end;
+	}
+
+	void stream::index_lines() const
+	{
+		line_starts.reserve(scan::count_newlines(buffer) + 1);
+		line_starts.push_back(0);
+
+		for (size_t line_end = scan::line_end(buffer); line_end < buffer.size();)
+		{
+			line_starts.push_back(static_cast<source_offset>(line_end + 1));
+			line_end += 1 + scan::line_end(buffer.substr(line_end + 1));
+		}
+	}
 }
@@ -1,163 +1,375 @@
 #include <chasm/symbol_sanitizer.hpp>
-#include <chasm/statements.hpp>
+#include <chasm/precompiled_module.hpp>
+#include <algorithm>
 #include <format>
 
 
 namespace chasm
 {
-	void symbol_sanitizer::traverse(const ast::abstract_tree& ast)
+	symbol_sanitizer::symbol_sanitizer(const interner& symbols, const stream& source_stream, diagnostics* diagnostics_sink)
+		: names(&symbols),
+		  source(&source_stream),
+		  sink(diagnostics_sink)
+	{}
+
+	template<typename Error>
+	bool symbol_sanitizer::reject(Error&& error, std::optional<source_location> where)
 	{
-		for (const auto& branch : ast.branches())
-			branch->accept(*this);
+		if (!sink)
+			throw std::forward<Error>(error);
 
-		post_visit();
+		sink->error(error.what(), where);
+
+		return false;
 	}
 
-	void symbol_sanitizer::push_scope()
+	void symbol_sanitizer::enter_fragment(const ast::flat_nodes& fragment)
 	{
-		++curr_scope_level;
+		nodes = &fragment;
+
+		grow_symbol_tables();
 	}
 
-	void symbol_sanitizer::pop_scope()
+	void symbol_sanitizer::leave_fragment()
 	{
-		scopes[curr_scope_level].clear();
-		--curr_scope_level;
+		// a fragment only holds complete statements, every scope ends with it
+		pop_scopes(static_cast<ast::node_id>(nodes->size()));
+
+		nodes = nullptr;
 	}
 
-	void symbol_sanitizer::visit(const ast::procedure_statement& statement)
+	bool symbol_sanitizer::check(ast::node_id id)
 	{
-		auto sym = statement.name_beg.to_string();
+		pop_scopes(id);
 
-		if (undefined_procs.contains(sym))
-			undefined_procs.erase(sym);
+		switch (nodes->kinds[id])
+		{
+			case ast::node_kind::procedure:   return check_procedure(id);
+			case ast::node_kind::label:       return check_label(id);
+			case ast::node_kind::instruction: return check_instruction(id);
+			case ast::node_kind::define:      return check_define(id);
+			case ast::node_kind::sprite:      return check_sprite(id);
+			case ast::node_kind::raw:         return check_raw(id);
+			case ast::node_kind::config:      return true;
+			case ast::node_kind::include:     return true;
+			case ast::node_kind::module:      return check_module(id);
+		}
 
-		register_symbol(
-				std::move(sym),
-				statement.name_beg.source_location
-			);
+		return true;
+	}
 
-		push_scope();
+	void symbol_sanitizer::grow_symbol_tables()
+	{
+		const auto symbols_count = names->size();
 
-		for (const auto& inner : statement.inner_statements)
-			inner->accept(*this);
+		if (symbols_count <= definition_scope.size())
+			return;
 
-		pop_scope();
+		definition_scope.resize(symbols_count, UNDEFINED);
+		undefined_labels.resize(symbols_count);
+		undefined_global_labels.resize(symbols_count);
+		undefined_procs.resize(symbols_count);
+	}
 
-		if (!undefined_labels.empty())
-			throw sanitize_exception::undefined_symbols(undefined_labels);
+	source_location symbol_sanitizer::locate(const token& token) const
+	{
+		return source->locate(token.offset);
 	}
 
-	void symbol_sanitizer::visit(const ast::instruction_statement& statement)
+	symbol_sanitizer::scope_id symbol_sanitizer::procedure_level() const
 	{
-		for (const auto& operand : statement.operands)
+		for (scope_id level = 1; level <= curr_scope_level; ++level)
+			if (nodes->kinds[scopes_owners[level]] == ast::node_kind::procedure)
+				return level;
+
+		return 0;
+	}
+
+	bool symbol_sanitizer::inside_procedure() const
+	{
+		return procedure_level() != 0;
+	}
+
+	void symbol_sanitizer::push_scope(ast::node_id body_owner)
+	{
+		++curr_scope_level;
+
+		if (curr_scope_level >= scopes.size())
+			throw chasm_exception("Invalid scope level for the body of \"{}\".", nodes->token_at(body_owner).lexeme);
+
+		scopes_owners[curr_scope_level] = body_owner;
+	}
+
+	void symbol_sanitizer::pop_scopes(ast::node_id reached)
+	{
+		//
+		// Nested bodies may end on the same node, e.g. the last label of a procedure
+		//
+		while (curr_scope_level > 0 && nodes->end_of(scopes_owners[curr_scope_level]) <= reached)
 		{
-			const auto& operand_token = operand.operand;
+			for (const auto symbol : scopes[curr_scope_level])
+				definition_scope[symbol] = UNDEFINED;
+
+			scopes[curr_scope_level].clear();
 
-			auto sym = operand_token.to_string();
+			const auto owner = scopes_owners[curr_scope_level--];
 
-			if (operand_token.type == token_type::identifier && !symbol_defined(sym))
+			if (nodes->kinds[owner] == ast::node_kind::procedure && !undefined_labels.empty())
 			{
-				const auto inst_id = statement.to_arch_id();
-
-				if (inst_id == arch::instruction_id::JMP)
-					undefined_labels.insert(std::make_pair(std::move(sym), operand_token.source_location));
-				else if (inst_id == arch::instruction_id::CALL)
-					undefined_procs.insert(std::make_pair(std::move(sym), operand_token.source_location));
-				else
-					throw sanitize_exception::undefined_symbols(sym, operand_token.source_location);
+				// reported once, at the end of the procedure they were referenced in
+				const auto undefined = undefined_labels.list(*names, *source);
+				undefined_labels.clear();
+
+				reject(sanitize_exception::undefined_symbols(undefined), locate(nodes->token_at(owner)));
 			}
 		}
 	}
 
-	void symbol_sanitizer::visit(const ast::label_statement& statement)
+	bool symbol_sanitizer::check_procedure(ast::node_id id)
 	{
-		auto sym = statement.identifier.to_string();
+		undefined_procs.remove(nodes->symbols[id]);
+
+		const bool registered = register_symbol(nodes->symbols[id], nodes->token_at(id));
 
-		if (undefined_labels.contains(sym))
-			undefined_labels.erase(sym);
+		// the body is checked even if the name is rejected
+		push_scope(id);
 
-		register_symbol(
-				std::move(sym),
-				statement.identifier.source_location
-			);
+		return registered;
+	}
 
-		push_scope();
+	bool symbol_sanitizer::check_label(ast::node_id id)
+	{
+		auto& forward_referenced = inside_procedure() ? undefined_labels : undefined_global_labels;
+		forward_referenced.remove(nodes->symbols[id]);
 
-		for (const auto& inner : statement.inner_statements)
-			inner->accept(*this);
+		const bool registered = register_symbol(nodes->symbols[id], nodes->token_at(id));
 
-		pop_scope();
+		push_scope(id);
+
+		return registered;
 	}
 
-	void symbol_sanitizer::visit(const ast::define_statement& statement)
+	bool symbol_sanitizer::check_instruction(ast::node_id id)
 	{
-		register_symbol(
-				statement.identifier.to_string(),
-				statement.identifier.source_location
-			);
+		using term_kind = ast::expression_term::kind;
+
+		const auto statement = nodes->instruction(id);
+
+		for (const auto& operand : statement.operands)
+		{
+			if (operand.is_expression())
+			{
+				if (!check_terms(nodes->terms_of(operand), statement.mnemonic))
+					return false;
+
+				continue;
+			}
+
+			if (operand.symbol == NO_SYMBOL)
+				continue;
+
+			const auto what = operand.is_label()     ? term_kind::label
+							: operand.is_procedure() ? term_kind::procedure
+							: term_kind::constant;
+
+			if (!check_reference(operand.symbol, what, nodes->token_of(operand), statement.mnemonic))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool symbol_sanitizer::check_define(ast::node_id id)
+	{
+		// the value is checked before the name is defined, so a define cannot refer to itself
+		if (!check_terms(nodes->expression(id), nodes->token_at(id)))
+			return false;
+
+		return register_symbol(nodes->symbols[id], nodes->token_at(id));
 	}
 
-	void symbol_sanitizer::visit(const ast::sprite_statement& statement)
+	bool symbol_sanitizer::check_sprite(ast::node_id id)
 	{
+		const auto& identifier = nodes->token_at(id);
+
 		if (curr_scope_level != 0)
-			throw chasm_exception(
-					"Sprite \"{}\" at {} must have a global scope",
-					statement.identifier.to_string(),
-					to_string(statement.identifier.source_location));
+			return reject(chasm_exception(
+							  "Sprite \"{}\" at {} must have a global scope",
+							  identifier.to_string(),
+							  to_string(locate(identifier))),
+						  locate(identifier));
 
-		register_symbol(
-				statement.identifier.to_string(),
-				statement.identifier.source_location
-			);
+		return register_symbol(nodes->symbols[id], identifier);
 	}
 
-	void symbol_sanitizer::visit(const ast::raw_statement& statement)
+	bool symbol_sanitizer::check_raw(ast::node_id id)
 	{
+		const auto& token = nodes->token_at(id);
+
 		if (curr_scope_level == 0)
-			throw chasm_exception("Invalid scope level for raw statement at line {}", statement.source_line());
+			return reject(chasm_exception("Invalid scope level for raw statement at line {}", locate(token).line),
+						  locate(token));
 
-		const auto& token = statement.opcode;
+		return check_terms(nodes->expression(id), token);
+	}
+
+	bool symbol_sanitizer::check_module(ast::node_id id)
+	{
+		//
+		// The module was checked when it was compiled, only the names it exports are defined here
+		//
+		const auto& file = *nodes->module(id).file;
+		const auto imports = nodes->imports_of(id);
 
-		if (token.type == token_type::identifier && !symbol_defined(token.to_string()))
-			throw sanitize_exception::undefined_symbols(token.to_string(), token.source_location);
+		bool registered = true;
+
+		for (size_t i = 0; i < imports.size(); ++i)
+		{
+			if (file.symbol_at(i).kind == precompiled_module::symbol_kind::procedure)
+				undefined_procs.remove(imports[i]);
+
+			registered = register_symbol(imports[i], nodes->token_at(id)) && registered;
+		}
+
+		return registered;
 	}
 
-	void symbol_sanitizer::register_symbol(std::string&& symbol, const source_location& sym_loc)
+	bool symbol_sanitizer::check_reference(symbol_id symbol, ast::expression_term::kind what,
+										   const token& reference, const token& statement)
+	{
+		if (symbol_defined(symbol))
+		{
+			//
+			// Labels outside of the procedure are already defined for a reference written after them,
+			// they are rejected the same as those only defined after the end of the procedure
+			//
+			const auto procedure = procedure_level();
+
+			if (what != ast::expression_term::kind::label || procedure == 0 || definition_scope[symbol] >= procedure)
+				return true;
+
+			return reject(sanitize_exception::undefined_symbols(reference.lexeme, locate(reference)),
+						  locate(statement));
+		}
+
+		switch (what)
+		{
+			case ast::expression_term::kind::label:
+				(inside_procedure() ? undefined_labels : undefined_global_labels).add(symbol, reference.offset);
+				return true;
+
+			case ast::expression_term::kind::procedure:
+				undefined_procs.add(symbol, reference.offset);
+				return true;
+
+			default:
+				return reject(sanitize_exception::undefined_symbols(reference.lexeme, locate(reference)),
+							  locate(statement));
+		}
+	}
+
+	bool symbol_sanitizer::check_terms(std::span<const ast::expression_term> terms, const token& statement)
+	{
+		for (const auto& term : terms)
+		{
+			if (term.symbol == NO_SYMBOL)
+				continue;
+
+			if (!check_reference(term.symbol, term.what, nodes->token_of(term), statement))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool symbol_sanitizer::register_symbol(symbol_id symbol, const token& sym_token)
 	{
 		if (curr_scope_level >= scopes.size())
 			throw chasm_exception(
 						"Invalid scope level for symbol \"{}\".",
-						symbol);
+						sym_token.lexeme);
 
 		if (symbol_defined(symbol))
-			throw sanitize_exception::already_defined_symbol(symbol, sym_loc);
+			return reject(sanitize_exception::already_defined_symbol(sym_token.lexeme, locate(sym_token)),
+						  locate(sym_token));
+
+		definition_scope[symbol] = curr_scope_level;
+		scopes[curr_scope_level].push_back(symbol);
 
-		scopes[curr_scope_level].insert({std::move(symbol), sym_loc});
+		return true;
 	}
 
-	bool symbol_sanitizer::symbol_defined(const std::string &symbol)
+	bool symbol_sanitizer::symbol_defined(symbol_id symbol) const
 	{
-		for (scope_id scp = 0; scp <= curr_scope_level; ++scp)
-			if (scope_has_symbol(scp, symbol))
-				return true;
+		//
+		// Symbols of popped scopes are reset to UNDEFINED, so any other
+		// scope is the current one or one of its parents
+		//
+		return definition_scope[symbol] != UNDEFINED;
+	}
 
-		return false;
+	void symbol_sanitizer::finish(bool require_entry_point)
+	{
+		if (!undefined_global_labels.empty())
+			reject(sanitize_exception::undefined_symbols(undefined_global_labels.list(*names, *source)), std::nullopt);
+
+		if (!undefined_procs.empty())
+			reject(sanitize_exception::undefined_symbols(undefined_procs.list(*names, *source)), std::nullopt);
+
+		if (!require_entry_point)
+			return;
+
+		const auto main = names->find("main");
+
+		if (!main || definition_scope[*main] != 0)
+			reject(chasm_exception("Entry-point label \".main\" was not defined."), std::nullopt);
 	}
 
-	bool symbol_sanitizer::scope_has_symbol(scope_id scope, const std::string &symbol)
+	void symbol_sanitizer::forward_references::resize(size_t symbols_count)
 	{
-		return scopes[scope].contains(symbol);
+		first_reference.resize(symbols_count, NOT_REFERENCED);
 	}
 
-	void symbol_sanitizer::post_visit()
+	void symbol_sanitizer::forward_references::add(symbol_id symbol, source_offset where)
 	{
-		if (!undefined_labels.empty())
-			throw sanitize_exception::undefined_symbols(undefined_labels);
+		if (first_reference[symbol] != NOT_REFERENCED)
+			return;
 
-		if (!undefined_procs.empty())
-			throw sanitize_exception::undefined_symbols(undefined_procs);
+		first_reference[symbol] = where;
+		++count;
+	}
+
+	void symbol_sanitizer::forward_references::remove(symbol_id symbol)
+	{
+		if (first_reference[symbol] == NOT_REFERENCED)
+			return;
+
+		first_reference[symbol] = NOT_REFERENCED;
+		--count;
+	}
+
+	void symbol_sanitizer::forward_references::clear()
+	{
+		std::ranges::fill(first_reference, NOT_REFERENCED);
+		count = 0;
+	}
+
+	bool symbol_sanitizer::forward_references::empty() const
+	{
+		return count == 0;
+	}
+
+	std::vector<symbol_reference> symbol_sanitizer::forward_references::list(const interner& symbols, const stream& source) const
+	{
+		std::vector<symbol_reference> references;
+
+		for (symbol_id symbol = 0; symbol < first_reference.size(); ++symbol)
+			if (first_reference[symbol] != NOT_REFERENCED)
+				references.push_back({
+					.name = symbols.name(symbol),
+					.location = source.locate(first_reference[symbol])
+				});
 
-		if (!scope_has_symbol(0, "main"))
-			throw chasm_exception("Entry-point label \".main\" was not defined.");
+		return references;
 	}
 }
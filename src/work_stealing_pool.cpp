@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include <chasm/work_stealing_pool.hpp>
+
+
+namespace chasm
+{
+	work_stealing_pool::work_stealing_pool(unsigned int workers)
+	{
+		if (workers == 0)
+			workers = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned int i = 0; i < workers; ++i)
+			queues.push_back(std::make_unique<worker_queue>());
+	}
+
+	unsigned int work_stealing_pool::size() const
+	{
+		return static_cast<unsigned int>(queues.size());
+	}
+
+	void work_stealing_pool::run(size_t tasks_count, const std::function<void(size_t)>& task)
+	{
+		const size_t workers = std::min(queues.size(), tasks_count);
+
+		for (size_t worker = 0; worker < workers; ++worker)
+		{
+			const size_t first = tasks_count * worker / workers;
+			const size_t last = tasks_count * (worker + 1) / workers;
+
+			const std::scoped_lock lock(queues[worker]->guard);
+
+			for (size_t i = first; i < last; ++i)
+				queues[worker]->tasks.push_back(i);
+		}
+
+		std::mutex error_guard;
+		std::exception_ptr first_error;
+
+		{
+			std::vector<std::jthread> threads;
+
+			for (size_t worker = 0; worker < workers; ++worker)
+				threads.emplace_back([&, worker]
+				{
+					size_t next;
+
+					while (pop(worker, next) || steal(worker, next))
+					{
+						try
+						{
+							task(next);
+						}
+						catch (...)
+						{
+							const std::scoped_lock lock(error_guard);
+
+							if (!first_error)
+								first_error = std::current_exception();
+						}
+					}
+				});
+		}
+
+		if (first_error)
+			std::rethrow_exception(first_error);
+	}
+
+	bool work_stealing_pool::pop(size_t worker, size_t& task)
+	{
+		auto& queue = *queues[worker];
+		const std::scoped_lock lock(queue.guard);
+
+		if (queue.tasks.empty())
+			return false;
+
+		task = queue.tasks.front();
+		queue.tasks.pop_front();
+
+		return true;
+	}
+
+	bool work_stealing_pool::steal(size_t thief, size_t& task)
+	{
+		//
+		// Tasks are only added before workers start, once every queue was seen empty none will be filled again
+		//
+		for (size_t offset = 1; offset < queues.size(); ++offset)
+		{
+			auto& victim = *queues[(thief + offset) % queues.size()];
+			const std::scoped_lock lock(victim.guard);
+
+			if (!victim.tasks.empty())
+			{
+				task = victim.tasks.back();
+				victim.tasks.pop_back();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,122 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/chasm_exception.hpp>
+#include <chasm/include_cache.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/log.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(libchasm)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		constexpr std::string_view program =
+				"sprite s [1, 2, 3]             \n"
+				".main:                         \n"
+				"    mov ar, #s                 \n"
+				"    jmp @main                  \n";
+	}
+
+	BOOST_AUTO_TEST_CASE(options_passed_explicitly)
+	{
+		const std::vector<uint8_t> loaded_at_0x200 = { 0xA2, 0x04, 0x12, 0x00, 1, 2, 3 };
+		const std::vector<uint8_t> loaded_at_0 = { 0xA0, 0x04, 0x10, 0x00, 1, 2, 3, 0 };
+
+		const auto code = assemble(details::program);
+		const auto relocated = assemble(details::program, { .relocate = 0x0000, .pad_sprites = true });
+
+		BOOST_CHECK_EQUAL_RANGES(code, loaded_at_0x200);
+		BOOST_CHECK_EQUAL_RANGES(relocated, loaded_at_0);
+
+		BOOST_CHECK(assemble("").empty());
+		BOOST_CHECK_THROW(static_cast<void>(assemble(".main: jmp @nowhere")), chasm_exception);
+	}
+
+	BOOST_AUTO_TEST_CASE(include_cache_passed_explicitly)
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "chasm_libchasm";
+		std::filesystem::create_directories(directory);
+
+		std::ofstream(directory / "sprites.c8") << "sprite s [1, 2, 3]\n";
+
+		const auto source = std::string_view("include \"sprites.c8\"\n.main:\n    mov ar, #s\n");
+		const auto source_file = directory / "main.c8";
+
+		include_cache cache;
+
+		// without a cache in the options, the included file is parsed again by each call
+		const auto uncached = assemble(source, {}, source_file);
+		BOOST_CHECK_EQUAL(cache.size(), 0);
+
+		const auto cached = assemble(source, { .includes = &cache }, source_file);
+		BOOST_CHECK_EQUAL(cache.size(), 1);
+
+		BOOST_CHECK_EQUAL_RANGES(cached, uncached);
+	}
+
+	BOOST_AUTO_TEST_CASE(concurrent_assemblies)
+	{
+		//
+		// Each thread assembles with its own relocation, none of them may see the options of another
+		//
+		constexpr arch::addr THREADS = 8;
+
+		std::vector<std::vector<uint8_t>> codes(THREADS);
+		std::vector<std::thread> threads;
+
+		for (arch::addr i = 0; i < THREADS; ++i)
+			threads.emplace_back([&codes, i]
+			{
+				for (int round = 0; round < 50; ++round)
+					codes[i] = assemble(details::program, { .relocate = static_cast<arch::addr>(i * 0x100) });
+			});
+
+		for (auto& thread : threads)
+			thread.join();
+
+		for (arch::addr i = 0; i < THREADS; ++i)
+		{
+			const std::vector<uint8_t> expected = {
+				static_cast<uint8_t>(0xA0 | i), 0x04,
+				static_cast<uint8_t>(0x10 | i), 0x00,
+				1, 2, 3
+			};
+
+			BOOST_CHECK_EQUAL_RANGES(codes[i], expected);
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(warnings_logged_by_the_assembling_thread)
+	{
+		//
+		// The command line caches what the build logs with its output, warnings must be part of it
+		//
+		std::string program = ".main: \n";
+
+		for (size_t i = 0; i <= arch::MAX_PROGRAM_SIZE / sizeof(arch::opcode); ++i)
+			program += "    cls \n";
+
+		for (const bool pipelined : { false, true })
+		{
+			std::vector<std::string> lines;
+
+			{
+				const log::capture capture(lines);
+				static_cast<void>(assemble(program, { .pipeline = pipelined }));
+			}
+
+			BOOST_REQUIRE_EQUAL(lines.size(), 1);
+			BOOST_CHECK(lines[0].find("CHIP-8 programs are generally up to") != std::string::npos);
+		}
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
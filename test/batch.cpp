@@ -0,0 +1,149 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/work_stealing_pool.hpp>
+#include <chasm/batch.hpp>
+#include <chasm/log.hpp>
+
+#include <filesystem>
+#include <stdexcept>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "options_fixture.hpp"
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(batch_assembly)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "chasm_batch";
+
+		std::filesystem::path write_file(const std::string& name, std::string_view content)
+		{
+			const auto path = directory / name;
+
+			std::filesystem::create_directories(path.parent_path());
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return path;
+		}
+
+		std::vector<uint8_t> read_file(const std::filesystem::path& path)
+		{
+			std::ifstream is(path, std::ios::binary);
+
+			return { std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(pool_runs_each_task_once)
+	{
+		constexpr size_t TASKS = 1000;
+
+		auto pool = work_stealing_pool(4);
+		std::vector<std::atomic<int>> runs(TASKS);
+
+		//
+		// The first worker gets the slow tasks, the others must steal its share to finish
+		//
+		pool.run(TASKS, [&runs](size_t i)
+		{
+			if (i < TASKS / 4)
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+
+			++runs[i];
+		});
+
+		BOOST_CHECK_EQUAL(pool.size(), 4);
+		BOOST_CHECK(std::ranges::all_of(runs, [](const auto& count) { return count == 1; }));
+
+		std::atomic<size_t> completed = 0;
+
+		BOOST_CHECK_THROW(pool.run(64, [&completed](size_t i)
+		{
+			if (i == 10)
+				throw std::runtime_error("task failed");
+
+			++completed;
+		}), std::runtime_error);
+
+		BOOST_CHECK_EQUAL(completed, 63);
+	}
+
+	BOOST_AUTO_TEST_CASE(every_file_reported_in_order)
+	{
+		details::write_file("shared.c8", "define STEP 2\n");
+		details::write_file("a.c8", "include \"shared.c8\"\n.main: add r0, STEP\n");
+		details::write_file("b.c8", ".main: jmp @nowhere\n");
+		details::write_file("c.c8", ".main: scrr\n");
+
+		const auto manifest = details::write_file("manifest.txt",
+				"# nightly ROMs  \n"
+				"a.c8            \n"
+				"                \n"
+				"b.c8            \n"
+				"c.c8 \"c out.ch8\"\n");
+
+		const auto entries = read_manifest(manifest, ".c8c");
+
+		BOOST_REQUIRE_EQUAL(entries.size(), 3);
+		BOOST_CHECK(entries[0].output == details::directory / "a.c8c");
+		BOOST_CHECK(entries[2].output == details::directory / "c out.ch8");
+
+		const auto results = assemble_batch(entries, { .assembler = test_env::zero_relocate, .workers = 3 });
+
+		BOOST_REQUIRE_EQUAL(results.size(), 3);
+
+		BOOST_CHECK(results[0].success);
+		BOOST_CHECK(results[0].source == entries[0].source);
+		const auto built = details::read_file(entries[0].output);
+		const std::vector<uint8_t> expected = { 0x70, 0x02 };
+
+		BOOST_CHECK_EQUAL_RANGES(built, expected);
+
+		BOOST_CHECK(!results[1].success);
+		BOOST_CHECK_EQUAL(results[1].report.error_count(), 1);
+
+		// the SuperCHIP-8 warning belongs to its file only
+		BOOST_CHECK(results[2].success);
+		BOOST_CHECK_EQUAL(results[2].report.warning_count(), 1);
+		BOOST_CHECK_EQUAL(results[0].report.warning_count(), 0);
+		BOOST_CHECK(std::filesystem::exists(entries[2].output));
+
+		BOOST_CHECK_THROW(static_cast<void>(read_manifest(details::write_file("bad.txt", "a.c8 a.c8c extra\n"), ".c8c")),
+						  batch_exception::invalid_manifest);
+	}
+
+	BOOST_AUTO_TEST_CASE(log_captured_per_thread)
+	{
+		std::vector<std::string> lines;
+		std::vector<std::string> other_lines;
+
+		{
+			const log::capture capture(lines);
+			log::warn("captured {}", 1);
+
+			std::thread([&other_lines]
+			{
+				const log::capture other(other_lines);
+				log::error("captured {}", 2);
+			}).join();
+		}
+
+		BOOST_REQUIRE_EQUAL(lines.size(), 1);
+		BOOST_REQUIRE_EQUAL(other_lines.size(), 1);
+		BOOST_CHECK_EQUAL(lines[0], "[WARN] captured 1");
+		BOOST_CHECK_EQUAL(other_lines[0], "[ERROR] captured 2");
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,201 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/build_cache.hpp>
+#include <chasm/assembler.hpp>
+#include <chasm/generator.hpp>
+#include <chasm/sha256.hpp>
+#include <chasm/batch.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "options_fixture.hpp"
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(build_cache_lookup)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "chasm_build_cache";
+
+		std::filesystem::path write_file(const std::string& name, std::string_view content)
+		{
+			const auto path = directory / name;
+
+			std::filesystem::create_directories(path.parent_path());
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return path;
+		}
+
+		std::vector<uint8_t> read_file(const std::filesystem::path& path)
+		{
+			std::ifstream is(path, std::ios::binary);
+
+			return { std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(sha256_digests)
+	{
+		BOOST_CHECK_EQUAL(sha256::to_hex(sha256::hash({})),
+						  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+		sha256 hasher;
+		hasher.update("abcdbcdecdefdefgefghfghighij");
+		hasher.update("hijkijkljklmklmnlmnomnopnopq");
+
+		BOOST_CHECK_EQUAL(sha256::to_hex(hasher.finish()),
+						  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	}
+
+	BOOST_AUTO_TEST_CASE(encoding_revision_pinned)
+	{
+		//
+		// Cached builds of an older encoding must not be restored. When this binary changes,
+		// bump generator::ENCODING_REVISION and update both pinned values.
+		//
+		const auto binary = assemble(
+				"sprite digit [0x20, 0x60, 0x20]        \n"
+				"define SPEED 3                         \n"
+				"proc step                              \n"
+				".loop:                                 \n"
+				"    add r1, SPEED                      \n"
+				"    mov ar, #digit                     \n"
+				"    draw r0, r1, digit                 \n"
+				"    se r1, 0xF0                        \n"
+				"    jmp @loop                          \n"
+				"    rand r2, 0x0F                      \n"
+				"    bcd r2                             \n"
+				"    rdump r3                           \n"
+				"    ret                                \n"
+				"endp step                              \n"
+				".main:                                 \n"
+				"    cls                                \n"
+				"    mov r0, dt                         \n"
+				"    call $step                         \n"
+				"    mov ar, @main + 2                  \n"
+				"    jmp @main                          \n",
+				test_env::zero_relocate);
+
+		BOOST_CHECK_EQUAL(sha256::to_hex(sha256::hash(binary)), "97e1544ac473465f9a2e3b62c760f564cce83feda0a5f6b415eceaf04d41a853");
+		BOOST_CHECK_EQUAL(generator::ENCODING_REVISION, 1);
+	}
+
+	BOOST_AUTO_TEST_CASE(key_covers_options_and_source)
+	{
+		const auto program = details::write_file("key.c8", ".main: cls\n");
+		const auto key = build_cache::make_key(".main: cls\n", program, test_env::zero_relocate);
+
+		auto super = test_env::zero_relocate;
+		super.super = true;
+
+		// threads and the symbols file do not change the binary
+		auto threaded = test_env::zero_relocate;
+		threaded.jobs = 4;
+		threaded.symbols_file = "key.c8s";
+
+		BOOST_CHECK(key.digest == build_cache::make_key(".main: cls\n", program, threaded).digest);
+		BOOST_CHECK(key.digest != build_cache::make_key(".main: cls\n", program, super).digest);
+		BOOST_CHECK(key.digest != build_cache::make_key(".main: ret\n", program, test_env::zero_relocate).digest);
+
+		// a module or diagnosed build of the source writes or logs something else
+		using kind = build_cache::build_kind;
+
+		BOOST_CHECK(key.digest == build_cache::make_key(".main: cls\n", program, test_env::zero_relocate, kind::program).digest);
+		BOOST_CHECK(key.digest != build_cache::make_key(".main: cls\n", program, test_env::zero_relocate, kind::module).digest);
+		BOOST_CHECK(key.digest != build_cache::make_key(".main: cls\n", program, test_env::zero_relocate, kind::diagnostics).digest);
+		BOOST_CHECK(build_cache::make_key(".main: cls\n", program, test_env::zero_relocate, kind::diagnostics).digest !=
+					build_cache::make_key(".main: cls\n", program, test_env::zero_relocate, kind::diagnostics_json).digest);
+	}
+
+	BOOST_AUTO_TEST_CASE(build_restored_until_include_changes)
+	{
+		std::filesystem::remove_all(details::directory / "cache");
+
+		details::write_file("shared.c8", "define STEP 2\n");
+		const auto program = details::write_file("program.c8", "include \"shared.c8\"\n.main: add r0, STEP\nscrr\n");
+		const std::vector<batch_entry> entries { { program, details::directory / "program.c8c" } };
+
+		{
+			build_cache cache(details::directory / "cache", 1024 * 1024);
+
+			const auto built = assemble_batch(entries, { .assembler = test_env::zero_relocate, .cache = &cache });
+			BOOST_REQUIRE(built[0].success);
+			BOOST_CHECK_EQUAL(built[0].report.warning_count(), 1);
+
+			std::filesystem::remove(entries[0].output);
+
+			//
+			// Restored without being assembled: no diagnostics, the warning is part of the cached log
+			//
+			const auto restored = assemble_batch(entries, { .assembler = test_env::zero_relocate, .cache = &cache });
+			BOOST_REQUIRE(restored[0].success);
+			BOOST_CHECK_EQUAL(restored[0].report.warning_count(), 0);
+			BOOST_REQUIRE_EQUAL(restored[0].log.size(), 1);
+			BOOST_CHECK(restored[0].log[0].starts_with("[WARN] "));
+
+			const auto output = details::read_file(entries[0].output);
+			const std::vector<uint8_t> expected = { 0x70, 0x02, 0x00, 0xFB };
+
+			BOOST_CHECK_EQUAL_RANGES(output, expected);
+
+			details::write_file("shared.c8", "define STEP 3\n");
+
+			const auto rebuilt = assemble_batch(entries, { .assembler = test_env::zero_relocate, .cache = &cache });
+			BOOST_REQUIRE(rebuilt[0].success);
+			BOOST_CHECK_EQUAL(details::read_file(entries[0].output)[1], 0x03);
+
+			const auto statistics = cache.statistics();
+			BOOST_CHECK_EQUAL(statistics.hits, 1);
+			BOOST_CHECK_EQUAL(statistics.misses, 2);
+			BOOST_CHECK_EQUAL(statistics.entries, 2);
+		}
+
+		// counts of a run are kept in the directory once it is done
+		const build_cache reopened(details::directory / "cache", 1024 * 1024);
+		BOOST_CHECK_EQUAL(reopened.statistics().hits, 1);
+		BOOST_CHECK_EQUAL(reopened.statistics().misses, 2);
+	}
+
+	BOOST_AUTO_TEST_CASE(least_recently_used_evicted)
+	{
+		std::filesystem::remove_all(details::directory / "small");
+
+		// about two builds of 400 bytes fit
+		build_cache cache(details::directory / "small", 1200);
+
+		const auto output = details::write_file("large.c8c", std::string(400, '\xAA'));
+		std::vector<build_cache::key> keys;
+
+		for (const auto source : { "first", "second", "third" })
+		{
+			keys.push_back(build_cache::make_key(source, {}, test_env::zero_relocate));
+			cache.store(keys.back(), {}, output, {}, {});
+
+			// file times are only as precise as the kernel clock tick
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+
+		BOOST_CHECK(!cache.fetch(keys[0], output, {}));
+		BOOST_CHECK(cache.fetch(keys[2], output, {}));
+
+		// an output that cannot be written is a miss, not an error
+		BOOST_CHECK(!cache.fetch(keys[2], details::directory / "missing" / "large.c8c", {}));
+
+		const auto statistics = cache.statistics();
+		BOOST_CHECK_GE(statistics.evictions, 1);
+		BOOST_CHECK_LE(statistics.size, 1200);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
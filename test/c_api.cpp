@@ -0,0 +1,186 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/chasm.h>
+
+#include <string_view>
+#include <cstring>
+#include <vector>
+#include <array>
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(c_interface)
+
+	namespace details
+	{
+		constexpr std::string_view program =
+				"proc bump                      \n"
+				"    add r0, 1                  \n"
+				"    ret                        \n"
+				"endp bump                      \n"
+				".main:                         \n"
+				"    mov r0, 5                  \n"
+				"    call $bump                 \n"
+				"    jmp @main                  \n";
+
+		chasm_options zero_relocate()
+		{
+			chasm_options options { .struct_size = sizeof(chasm_options) };
+
+			BOOST_REQUIRE(chasm_default_options(&options) == CHASM_OK);
+			options.relocate = 0x0000;
+
+			return options;
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(assemble_into_caller_buffer)
+	{
+		const auto options = details::zero_relocate();
+		const std::vector<uint8_t> expected = { 0x60, 0x05, 0x20, 0x06, 0x10, 0x00, 0x70, 0x01, 0x00, 0xEE };
+
+		std::array<uint8_t, 64> binary {};
+		std::array<chasm_diagnostic, 4> diagnostics {};
+		size_t binary_size = 0;
+		size_t diagnostics_count = 0;
+
+		const auto status = chasm_assemble(details::program.data(), details::program.size(), &options,
+										   binary.data(), binary.size(), &binary_size,
+										   diagnostics.data(), sizeof(chasm_diagnostic), diagnostics.size(), &diagnostics_count);
+
+		BOOST_REQUIRE(status == CHASM_OK);
+		BOOST_CHECK_EQUAL(diagnostics_count, 0);
+		BOOST_CHECK_EQUAL_RANGES(std::span(binary.data(), binary_size), expected);
+
+		// the size needed is reported when the binary does not fit
+		const auto too_small = chasm_assemble(details::program.data(), details::program.size(), &options,
+											  binary.data(), 4, &binary_size,
+											  nullptr, 0, 0, nullptr);
+
+		BOOST_CHECK(too_small == CHASM_BUFFER_TOO_SMALL);
+		BOOST_CHECK_EQUAL(binary_size, expected.size());
+
+		BOOST_CHECK(chasm_assemble(nullptr, 1, nullptr, nullptr, 0, &binary_size, nullptr, 0, 0, nullptr) == CHASM_INVALID_ARGUMENT);
+		BOOST_CHECK_EQUAL(chasm_api_version(), CHASM_API_VERSION);
+	}
+
+	BOOST_AUTO_TEST_CASE(diagnostics_returned_as_structs)
+	{
+		constexpr std::string_view source =
+				".main:                         \n"
+				"    mov r0, 5                  \n"
+				"    jmp @nowhere               \n";
+
+		std::array<uint8_t, 64> binary {};
+		std::array<chasm_diagnostic, 4> diagnostics {};
+		size_t binary_size = 0;
+		size_t diagnostics_count = 0;
+
+		const auto status = chasm_assemble(source.data(), source.size(), nullptr,
+										   binary.data(), binary.size(), &binary_size,
+										   diagnostics.data(), sizeof(chasm_diagnostic), diagnostics.size(), &diagnostics_count);
+
+		BOOST_CHECK(status == CHASM_ERROR);
+		BOOST_CHECK_EQUAL(binary_size, 0);
+		BOOST_REQUIRE_GE(diagnostics_count, 1);
+		BOOST_CHECK(diagnostics[0].severity == CHASM_SEVERITY_ERROR);
+		BOOST_CHECK(std::strstr(diagnostics[0].message, "nowhere") != nullptr);
+		BOOST_CHECK_LT(std::strlen(diagnostics[0].message), CHASM_MESSAGE_SIZE);
+	}
+
+	BOOST_AUTO_TEST_CASE(disassemble_byte_span)
+	{
+		const auto options = details::zero_relocate();
+
+		std::array<uint8_t, 64> binary {};
+		size_t binary_size = 0;
+
+		BOOST_REQUIRE(chasm_assemble(details::program.data(), details::program.size(), &options,
+									 binary.data(), binary.size(), &binary_size,
+									 nullptr, 0, 0, nullptr) == CHASM_OK);
+
+		std::array<chasm_instruction, 16> instructions {};
+		size_t instructions_count = 0;
+
+		const auto status = chasm_disassemble(binary.data(), binary_size, 0x0000,
+											  instructions.data(), sizeof(chasm_instruction), instructions.size(), &instructions_count,
+											  nullptr, 0);
+
+		BOOST_REQUIRE(status == CHASM_OK);
+		BOOST_REQUIRE_EQUAL(instructions_count, 5);
+
+		BOOST_CHECK_EQUAL(instructions[0].address, 0x0000);
+		BOOST_CHECK_EQUAL(instructions[0].opcode, 0x6005);
+		BOOST_CHECK(instructions[0].path_start);
+		BOOST_CHECK_EQUAL(instructions[1].opcode, 0x2006);
+
+		BOOST_CHECK_EQUAL(instructions[3].address, 0x0006);
+		BOOST_CHECK(instructions[3].procedure_start);
+		BOOST_CHECK(!instructions[0].procedure_start);
+		BOOST_CHECK_EQUAL(instructions[4].opcode, 0x00EE);
+
+		// an odd byte count leaves the last instruction incomplete
+		chasm_diagnostic error {};
+		const std::array<uint8_t, 3> truncated = { 0x60, 0x05, 0x70 };
+
+		BOOST_CHECK(chasm_disassemble(truncated.data(), truncated.size(), 0x0200,
+									  instructions.data(), sizeof(chasm_instruction), instructions.size(), &instructions_count,
+									  &error, sizeof(error)) == CHASM_ERROR);
+		BOOST_CHECK(std::strlen(error.message) > 0);
+	}
+
+	BOOST_AUTO_TEST_CASE(structure_sizes_given_by_caller)
+	{
+		//
+		// Structures of a caller built against a newer header with appended fields
+		//
+		struct newer_options
+		{
+			chasm_options known;
+			uint32_t appended;
+		};
+
+		struct newer_diagnostic
+		{
+			chasm_diagnostic known;
+			uint32_t appended;
+		};
+
+		constexpr std::string_view source = ".main: jmp @nowhere\n";
+
+		newer_options options { .known = { .struct_size = sizeof(newer_options) }, .appended = 0xFFFFFFFF };
+		BOOST_REQUIRE(chasm_default_options(&options.known) == CHASM_OK);
+		BOOST_CHECK_EQUAL(options.known.struct_size, sizeof(newer_options));
+		BOOST_CHECK_EQUAL(options.known.relocate, 0x200);
+		BOOST_CHECK_EQUAL(options.appended, 0);
+
+		std::array<newer_diagnostic, 2> diagnostics {};
+		diagnostics[0].appended = diagnostics[1].appended = 0xFFFFFFFF;
+
+		std::array<uint8_t, 16> binary {};
+		size_t binary_size = 0;
+		size_t diagnostics_count = 0;
+
+		BOOST_CHECK(chasm_assemble(source.data(), source.size(), &options.known,
+								   binary.data(), binary.size(), &binary_size,
+								   &diagnostics[0].known, sizeof(newer_diagnostic), diagnostics.size(), &diagnostics_count) == CHASM_ERROR);
+
+		BOOST_REQUIRE_EQUAL(diagnostics_count, 1);
+		BOOST_CHECK(std::strstr(diagnostics[0].known.message, "nowhere") != nullptr);
+		BOOST_CHECK_EQUAL(diagnostics[0].appended, 0);
+		BOOST_CHECK_EQUAL(diagnostics[1].appended, 0xFFFFFFFF);
+
+		// structures smaller than the ones of the library are rejected before anything is written
+		chasm_options older { .struct_size = sizeof(chasm_options) - 1 };
+
+		BOOST_CHECK(chasm_default_options(&older) == CHASM_INVALID_ARGUMENT);
+		BOOST_CHECK(chasm_assemble(source.data(), source.size(), &older,
+								   binary.data(), binary.size(), &binary_size,
+								   nullptr, 0, 0, nullptr) == CHASM_INVALID_ARGUMENT);
+		BOOST_CHECK(chasm_assemble(source.data(), source.size(), nullptr,
+								   binary.data(), binary.size(), &binary_size,
+								   &diagnostics[0].known, sizeof(chasm_diagnostic) - 1, diagnostics.size(), &diagnostics_count) == CHASM_INVALID_ARGUMENT);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
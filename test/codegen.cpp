@@ -13,13 +13,13 @@ namespace details
 	using namespace chasm;
 
 	std::vector<uint8_t>
-	try_codegen(std::string&& program)
+	try_codegen(std::string&& program, const assembler_options& options = test_env::zero_relocate)
 	{
 		auto lex = lexer(std::move(program));
-		auto par = parser(lex.enumerate_tokens());
+		auto par = parser(lex);
 		auto ast = par.make_tree();
 
-		return ast.generate();
+		return ast.generate(options);
 	}
 
 	arch::opcode opcode(std::string&& instruction_str)
@@ -30,7 +30,7 @@ namespace details
 	}
 }
 
-BOOST_FIXTURE_TEST_SUITE(machine_code_generation, test_env::zero_relocate)
+BOOST_AUTO_TEST_SUITE(machine_code_generation)
 
 	BOOST_AUTO_TEST_CASE(check_per_instruction_opcodes)
 	{
@@ -216,6 +216,36 @@ BOOST_FIXTURE_TEST_SUITE(machine_code_generation, test_env::zero_relocate)
 		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
 	}
 
+	BOOST_AUTO_TEST_CASE(check_procedure_scoped_labels)
+	{
+		const auto code = details::try_codegen("proc a            \n"   // 0x04
+											   ".loop:            \n"
+											   "    mov ar, @loop \n"   // 0x04
+											   "    jmp @loop     \n"   // 0x06
+											   "endp a            \n"
+											   "                  \n"
+											   "proc b            \n"   // 0x08
+											   ".loop:            \n"
+											   "    jmp @loop     \n"   // 0x08
+											   "endp b            \n"
+											   "                  \n"
+											   ".main:            \n"   // 0x00
+											   "    call $a       \n"   // 0x00
+											   "    call $b       \n"); // 0x02
+
+		const auto expected_code = {
+				0x20, 0x04,
+				0x20, 0x08,
+
+				0xA0, 0x04,
+				0x10, 0x04,
+
+				0x10, 0x08
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
+	}
+
 	BOOST_AUTO_TEST_CASE(check_pseudo_instruction_swap)
 	{
 		const auto code = details::try_codegen(".main:\n swp r0, r1");
@@ -265,12 +295,13 @@ BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(sprite_padding)
 
-	BOOST_FIXTURE_TEST_CASE(padding_off, test_env::default_options)
+	BOOST_AUTO_TEST_CASE(padding_off)
 	{
 		const auto code = details::try_codegen("sprite s1 [1, 2, 3]  \n"
 											   "sprite s2 [1, 2, 3]  \n"
 											   "sprite s3 [1, 2, 3]  \n"
-											   ".main:               \n");
+											   ".main:               \n",
+											   test_env::default_options);
 
 		const auto expected_code = {
 				1, 2, 3,
@@ -281,12 +312,13 @@ BOOST_AUTO_TEST_SUITE(sprite_padding)
 		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
 	}
 
-	BOOST_FIXTURE_TEST_CASE(padding_on, test_env::padded_sprites)
+	BOOST_AUTO_TEST_CASE(padding_on)
 	{
 		const auto code = details::try_codegen("sprite s1 [1, 2, 3]  \n"
 											   "sprite s2 [1, 2, 3]  \n"
 											   "sprite s3 [1, 2, 3]  \n"
-											   ".main:               \n");
+											   ".main:               \n",
+											   test_env::padded_sprites);
 
 		const auto expected_code = {
 				1, 2, 3, 0,
@@ -0,0 +1,169 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/diagnostics.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+
+BOOST_AUTO_TEST_SUITE(diagnostics_sink)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		diagnosed<std::vector<uint8_t>> try_assemble(std::string&& program, diagnostics& sink)
+		{
+			auto lex = lexer(std::move(program));
+			auto par = parser(lex, sink);
+			const auto ast = par.make_tree();
+
+			return ast.generate(sink);
+		}
+
+		std::vector<size_t> error_lines(const diagnostics& sink)
+		{
+			std::vector<size_t> lines;
+
+			for (const auto& [level, message, location] : sink.entries())
+				if (level == severity::error)
+					lines.push_back(location ? location->line : 0);
+
+			return lines;
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(errors_of_every_stage_collected)
+	{
+		diagnostics sink;
+
+		const auto binary = details::try_assemble(
+				"proc a                 \n"  // 1
+				"    mov r0, ?          \n"  // 2 lexer
+				"    add r1, 2          \n"
+				"    ret                \n"
+				"endp a                 \n"
+				".main:                 \n"
+				"    add r1, undefined  \n"  // 7 sanitizer
+				"    define 2 x         \n"  // 8 parser
+				"    mov r0, dt, r1     \n"  // 9 generator
+				"    call $a            \n", sink);
+
+		BOOST_REQUIRE(!binary.has_value());
+		BOOST_CHECK_EQUAL(binary.error().count, 5);
+
+		//
+		// Lexing and parsing errors come first, then the errors of the code generation in source order.
+		// Line 2 is reported twice: the invalid character is skipped, which leaves mov with one operand.
+		//
+		const std::vector<size_t> expected_lines = { 2, 8, 2, 7, 9 };
+		const auto lines = details::error_lines(sink);
+
+		BOOST_CHECK_EQUAL_COLLECTIONS(lines.begin(), lines.end(), expected_lines.begin(), expected_lines.end());
+	}
+
+	BOOST_AUTO_TEST_CASE(statements_around_errors_kept)
+	{
+		diagnostics sink;
+
+		//
+		// The statement with an error is dropped, the code of the others is the same
+		// as the one of the program without it
+		//
+		const auto recovered = details::try_assemble(
+				".main:                 \n"
+				"    cls                \n"
+				"    add r0,            \n"
+				"    ret                \n", sink);
+
+		BOOST_REQUIRE(!recovered.has_value());
+		BOOST_CHECK_EQUAL(sink.error_count(), 1);
+
+		diagnostics fixed_sink;
+
+		const auto fixed = details::try_assemble(
+				".main:                 \n"
+				"    cls                \n"
+				"    ret                \n", fixed_sink);
+
+		BOOST_REQUIRE(fixed.has_value());
+		BOOST_CHECK(fixed_sink.entries().empty());
+	}
+
+	BOOST_AUTO_TEST_CASE(address_patch_errors_collected)
+	{
+		diagnostics sink;
+
+		//
+		// Both addresses are only known once linked, each patch is reported and linking goes on
+		//
+		const auto binary = details::try_assemble(
+				".main:                     \n"  // 1
+				"    mov ar, @main - 0x300  \n"  // 2 negative
+				"    mov ar, @main + 0xFF00 \n"  // 3 out of range once relocated
+				"    jmp @main              \n", sink);
+
+		BOOST_REQUIRE(!binary.has_value());
+		BOOST_CHECK_EQUAL(sink.error_count(), 2);
+
+		const std::vector<size_t> expected_lines = { 2, 3 };
+		const auto lines = details::error_lines(sink);
+
+		BOOST_CHECK_EQUAL_COLLECTIONS(lines.begin(), lines.end(), expected_lines.begin(), expected_lines.end());
+	}
+
+	BOOST_AUTO_TEST_CASE(warnings_do_not_fail)
+	{
+		diagnostics sink;
+
+		const auto binary = details::try_assemble(".main: \n"
+												  "    exit \n", sink);
+
+		BOOST_REQUIRE(binary.has_value());
+		BOOST_CHECK_EQUAL(binary->size(), 2);
+		BOOST_CHECK_EQUAL(sink.warning_count(), 1);
+		BOOST_CHECK_EQUAL(sink.error_count(), 0);
+	}
+
+	BOOST_AUTO_TEST_CASE(oversized_program_warned)
+	{
+		diagnostics sink;
+
+		std::string program = ".main: \n";
+
+		for (size_t i = 0; i <= arch::MAX_PROGRAM_SIZE / sizeof(arch::opcode); ++i)
+			program += "    cls \n";
+
+		const auto binary = details::try_assemble(std::move(program), sink);
+
+		BOOST_REQUIRE(binary.has_value());
+		BOOST_CHECK_GT(binary->size(), arch::MAX_PROGRAM_SIZE);
+		BOOST_REQUIRE_EQUAL(sink.warning_count(), 1);
+		BOOST_CHECK(sink.entries().front().message.starts_with("CHIP-8 programs are generally up to"));
+	}
+
+	BOOST_AUTO_TEST_CASE(unterminated_procedure_reported_once)
+	{
+		diagnostics sink;
+
+		const auto binary = details::try_assemble(".main: \n"
+												  "    cls \n"
+												  "proc a \n"
+												  "    ret \n", sink);
+
+		BOOST_CHECK(!binary.has_value());
+		BOOST_CHECK_EQUAL(sink.error_count(), 1);
+	}
+
+	BOOST_AUTO_TEST_CASE(json_output)
+	{
+		diagnostics sink;
+
+		sink.error("Undefined \"x\"\n", source_location { .col = 5, .line = 2 });
+		sink.warning("No location");
+
+		BOOST_CHECK_EQUAL(sink.to_json("dir\\a.c8"),
+						  R"({"file": "dir\\a.c8", "errors": 1, "warnings": 1, "diagnostics": [)"
+						  R"({"severity": "error", "line": 2, "column": 5, "message": "Undefined \"x\"\n"}, )"
+						  R"({"severity": "warning", "line": null, "column": null, "message": "No location"}]})");
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -14,10 +14,10 @@ namespace details
 	codegen(std::string&& source)
 	{
 		auto lex = lexer(std::move(source));
-		auto par = parser(lex.enumerate_tokens());
+		auto par = parser(lex);
 		auto ast = par.make_tree();
 
-		return ast.generate();
+		return ast.generate(test_env::zero_relocate);
 	}
 
 	std::vector<ds::path>
@@ -29,7 +29,7 @@ namespace details
 }
 
 
-BOOST_FIXTURE_TEST_SUITE(paths_checker, test_env::zero_relocate)
+BOOST_AUTO_TEST_SUITE(paths_checker)
 
 	BOOST_AUTO_TEST_CASE(test_basic_chained_jumps)
 	{
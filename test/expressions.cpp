@@ -0,0 +1,162 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/generator.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+#include "options_fixture.hpp"
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(constant_expressions)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		std::vector<uint8_t> try_codegen(std::string&& program)
+		{
+			auto lex = lexer(std::move(program));
+			auto par = parser(lex);
+			const auto ast = par.make_tree();
+
+			return ast.generate(test_env::zero_relocate);
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(stored_in_postfix_order)
+	{
+		using term_kind = ast::expression_term::kind;
+
+		auto lex = lexer(
+				".main:                   \n"
+				"    mov r0, 5            \n"  // 1
+				"    mov r1, 1 + 2 * c    \n"  // 2
+		);
+
+		auto par = parser(lex);
+		const auto tree = par.make_tree();
+		const auto& nodes = tree.nodes();
+
+		// operands written as a single value are not expressions
+		BOOST_CHECK(!nodes.instruction(1).operands[1].is_expression());
+		BOOST_CHECK_EQUAL(nodes.instruction(1).operands[1].value, 5);
+
+		const auto& operand = nodes.instruction(2).operands[1];
+		const auto terms = nodes.terms_of(operand);
+
+		BOOST_CHECK(operand.type == arch::operand_type::immediate);
+		BOOST_REQUIRE_EQUAL(terms.size(), 5);
+
+		BOOST_CHECK(terms[0].what == term_kind::number);
+		BOOST_CHECK(terms[1].what == term_kind::number);
+		BOOST_CHECK(terms[2].what == term_kind::constant);
+		BOOST_CHECK(terms[3].what == term_kind::binary && terms[3].op == expression_operator::multiply);
+		BOOST_CHECK(terms[4].what == term_kind::binary && terms[4].op == expression_operator::add);
+		BOOST_CHECK_EQUAL(tree.symbols().name(terms[2].symbol), "c");
+	}
+
+	BOOST_AUTO_TEST_CASE(constants_folded)
+	{
+		const auto code = details::try_codegen(
+				"define w    8                  \n"
+				"define h    w * 2 + 1          \n"
+				"define mask ~0 & 0xF0          \n"
+				".main:                         \n"
+				"    mov r0, h                  \n"
+				"    mov r1, (w + 2) * 3        \n"
+				"    mov r2, 1 << 4 | 1         \n"
+				"    mov r3, mask               \n"
+				"    mov r4, 20 - 3 - 2         \n"
+				"    mov r5, -1 + 3             \n"
+				"    mov r6, 0x1F % 8 ^ 0b11    \n"
+		);
+
+		const std::vector<uint8_t> expected_code = {
+			0x60, 17,
+			0x61, 30,
+			0x62, 17,
+			0x63, 0xF0,
+			0x64, 15,
+			0x65, 2,
+			0x66, 4
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
+	}
+
+	BOOST_AUTO_TEST_CASE(builtin_functions)
+	{
+		const auto code = details::try_codegen(
+				"sprite s [1, 2, 3]             \n"
+				"define addr 0x2A4              \n"
+				"define hi   3                  \n"
+				".main:                         \n"
+				"    mov r0, hi(addr)           \n"
+				"    mov r1, lo(addr + 1)       \n"
+				"    mov r2, sizeof(#s) * 2     \n"
+				"    draw r0, r1, sizeof(#s) - 1\n"
+				"    mov r3, hi                 \n"
+				"    raw(hi(0x1234) << 8 | 0x56)\n"
+		);
+
+		const std::vector<uint8_t> expected_code = {
+			0x60, 0x02,
+			0x61, 0xA5,
+			0x62, 0x06,
+			0xD0, 0x12,
+			0x63, 0x03,
+			0x12, 0x56,
+			1, 2, 3
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
+	}
+
+	BOOST_AUTO_TEST_CASE(addresses_patched_with_offsets)
+	{
+		//
+		// Labels referenced before their definition are patched once laid out, like plain labels
+		//
+		const auto code = details::try_codegen(
+				".main:                         \n"
+				"    mov ar, @data + 2          \n"
+				"    mov ar, 2 * 2 + @data      \n"
+				"    jmp @data - 2              \n"
+				".data:                         \n"
+				"    raw(0x1234)                \n"
+				"    raw(0x5678)                \n"
+		);
+
+		const std::vector<uint8_t> expected_code = {
+			0xA0, 0x08,
+			0xA0, 0x0A,
+			0x10, 0x04,
+			0x12, 0x34,
+			0x56, 0x78
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
+	}
+
+	BOOST_AUTO_TEST_CASE(invalid_expressions)
+	{
+		using generator_exception::invalid_expression;
+
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, 1 / 0"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, 1 - 2"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, 0x80 * 2"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, 1 << 32"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov ar, hi(@main)"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov ar, @main + @main"), invalid_expression);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov ar, @main - 2"), chasm_exception);
+
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, x + 1"), sanitize_exception::undefined_symbols);
+		BOOST_CHECK_THROW(details::try_codegen("define x x + 1\n.main: cls"), sanitize_exception::undefined_symbols);
+
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, 1 < 2"), lexer_exception::undefined_character_token);
+		BOOST_CHECK_THROW(details::try_codegen(".main: mov r0, (1 + 2"), chasm_exception);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,234 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/include_cache.hpp>
+#include <chasm/diagnostics.hpp>
+#include <chasm/depfile.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "options_fixture.hpp"
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(include_directive)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "chasm_includes";
+
+		std::filesystem::path write_source(const std::string& name, std::string_view content)
+		{
+			const auto path = directory / name;
+
+			std::filesystem::create_directories(path.parent_path());
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return std::filesystem::weakly_canonical(path);
+		}
+
+		std::vector<uint8_t> try_codegen(const std::filesystem::path& file, std::string&& program, include_cache& cache)
+		{
+			auto lex = lexer(std::move(program));
+			auto par = parser(lex);
+			par.resolve_includes({ file }, &cache);
+
+			const auto ast = par.make_tree();
+
+			return ast.generate(test_env::zero_relocate);
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(included_statements_spliced)
+	{
+		include_cache cache;
+
+		const auto sprites = details::write_source("lib/sprites.c8",
+				"sprite ship [0xFF, 0x81]       \n"
+				"define SPEED 3                 \n"
+		);
+
+		const auto move = details::write_source("lib/move.c8",
+				"include \"sprites.c8\"           \n"
+				"proc step                      \n"
+				"    add r0, SPEED              \n"
+				"    ret                        \n"
+				"endp step                      \n"
+		);
+
+		const auto program = details::directory / "main.c8";
+
+		auto lex = lexer(
+				"include \"lib/move.c8\"          \n"
+				".main:                         \n"
+				"    mov ar, #ship              \n"
+				"    call $step                 \n"
+				"    draw r0, r1, #ship         \n"
+		);
+
+		auto par = parser(lex);
+		par.resolve_includes({ program }, &cache);
+
+		const auto ast = par.make_tree();
+		const auto code = ast.generate(test_env::zero_relocate);
+
+		const std::vector<uint8_t> expected_code = {
+			0xA0, 0x0A,
+			0x20, 0x06,
+			0xD0, 0x12,
+			0x70, 0x03,
+			0x00, 0xEE,
+			0xFF, 0x81
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(code, expected_code);
+
+		const std::vector<std::filesystem::path> expected_dependencies = { move, sprites };
+		BOOST_CHECK(par.dependencies() == expected_dependencies);
+
+		BOOST_CHECK_EQUAL(cache.size(), 2);
+	}
+
+	BOOST_AUTO_TEST_CASE(parsed_once_per_content)
+	{
+		include_cache cache;
+
+		const auto path = details::write_source("constants.c8", "define A 1\n");
+
+		const auto first = cache.parse(path, {});
+		BOOST_CHECK(cache.parse(path, {}) == first);
+
+		// same path, another content
+		details::write_source("constants.c8", "define A 2\n");
+
+		const auto second = cache.parse(path, {});
+
+		BOOST_CHECK(second != first);
+		BOOST_CHECK_EQUAL(second->nodes.token_at(0, 1).to_integer(), 2);
+		BOOST_CHECK_EQUAL(cache.size(), 1);
+	}
+
+	BOOST_AUTO_TEST_CASE(parsed_again_when_nested_include_changes)
+	{
+		include_cache cache;
+
+		details::write_source("nested/speed.c8", "define SPEED 1\n");
+		details::write_source("nested/step.c8", "include \"speed.c8\"\n");
+
+		const auto program = details::directory / "main.c8";
+
+		BOOST_CHECK_EQUAL(details::try_codegen(program, "include \"nested/step.c8\"\n.main: add r0, SPEED\n", cache)[1], 0x01);
+
+		// step.c8 is the same, the file it includes is not
+		details::write_source("nested/speed.c8", "define SPEED 2\n");
+
+		BOOST_CHECK_EQUAL(details::try_codegen(program, "include \"nested/step.c8\"\n.main: add r0, SPEED\n", cache)[1], 0x02);
+		BOOST_CHECK_EQUAL(cache.size(), 2);
+	}
+
+	BOOST_AUTO_TEST_CASE(least_recently_used_evicted)
+	{
+		include_cache cache({ .max_entries = 2 });
+
+		const auto a = details::write_source("lru/a.c8", "define A 1\n");
+		const auto b = details::write_source("lru/b.c8", "define B 2\n");
+		const auto c = details::write_source("lru/c.c8", "define C 3\n");
+
+		const auto parsed_a = cache.parse(a, {});
+		const auto parsed_b = cache.parse(b, {});
+
+		// a is used again, b is the least recently used entry once c comes
+		BOOST_CHECK(cache.parse(a, {}) == parsed_a);
+		static_cast<void>(cache.parse(c, {}));
+
+		BOOST_CHECK_EQUAL(cache.size(), 2);
+		BOOST_CHECK_EQUAL(cache.evictions(), 1);
+		BOOST_CHECK(cache.parse(a, {}) == parsed_a);
+		BOOST_CHECK(cache.parse(b, {}) != parsed_b);
+		BOOST_CHECK_EQUAL(cache.evictions(), 2);
+
+		// an entry larger than the byte limit is returned but not kept
+		include_cache small({ .max_bytes = 4 });
+
+		BOOST_CHECK(small.parse(a, {}) != nullptr);
+		BOOST_CHECK_EQUAL(small.size(), 0);
+		BOOST_CHECK_EQUAL(small.bytes(), 0);
+		BOOST_CHECK_EQUAL(small.evictions(), 1);
+	}
+
+	BOOST_AUTO_TEST_CASE(errors_located_in_included_file)
+	{
+		include_cache cache;
+
+		const auto library = details::write_source("undefined.c8",
+				"proc f                         \n"
+				"    mov r0, x                  \n"
+				"    ret                        \n"
+				"endp f                         \n"
+		);
+
+		diagnostics sink;
+
+		auto lex = lexer(
+				"include \"undefined.c8\"         \n"
+				".main:                         \n"
+				"    call $f                    \n"
+		);
+
+		auto par = parser(lex, sink);
+		par.resolve_includes({ details::directory / "main.c8" }, &cache);
+
+		const auto ast = par.make_tree();
+
+		BOOST_CHECK(!ast.generate(sink, test_env::zero_relocate));
+		BOOST_REQUIRE_EQUAL(sink.error_count(), 1);
+
+		const auto& location = sink.entries().front().location;
+
+		BOOST_REQUIRE(location);
+		BOOST_CHECK_EQUAL(location->file, library.string());
+		BOOST_CHECK_EQUAL(location->line, 2);
+	}
+
+	BOOST_AUTO_TEST_CASE(invalid_includes)
+	{
+		include_cache cache;
+
+		const auto program = details::directory / "main.c8";
+
+		details::write_source("bad_syntax.c8", "define 0 A\n");
+		details::write_source("cycle_a.c8", "include \"cycle_b.c8\"\n");
+		details::write_source("cycle_b.c8", "include \"cycle_a.c8\"\n");
+
+		const auto self = details::write_source("self.c8", "include \"self.c8\"\n");
+
+		BOOST_CHECK_THROW(details::try_codegen(program, "include \"missing.c8\"", cache), include_exception::file_not_found);
+		BOOST_CHECK_THROW(details::try_codegen(program, "include \"bad_syntax.c8\"", cache), include_exception::error_in_file);
+		BOOST_CHECK_THROW(details::try_codegen(program, "include \"cycle_a.c8\"", cache), include_exception::error_in_file);
+		BOOST_CHECK_THROW(details::try_codegen(self, "include \"self.c8\"", cache), include_exception::circular_include);
+
+		BOOST_CHECK_THROW(details::try_codegen(program, ".main:\n include \"x.c8\"", cache), parser_exception::unexpected_error);
+		BOOST_CHECK_THROW(details::try_codegen(program, "include \"x.c8", cache), lexer_exception::unterminated_string_literal);
+	}
+
+	BOOST_AUTO_TEST_CASE(depfile_lists_every_input)
+	{
+		const std::vector<std::filesystem::path> inputs = { "main.c8", "lib/my sprites.c8" };
+
+		BOOST_CHECK_EQUAL(make_depfile("out.c8c", inputs),
+						  "out.c8c: \\\n"
+						  "  main.c8 \\\n"
+						  "  lib/my\\ sprites.c8\n"
+						  "\n"
+						  "lib/my\\ sprites.c8:\n");
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
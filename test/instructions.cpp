@@ -3,10 +3,8 @@
 #include <chasm/parser.hpp>
 #include <chasm/generator.hpp>
 
-#include "options_fixture.hpp"
 
-
-BOOST_FIXTURE_TEST_SUITE(instruction_operands, test_env::default_options)
+BOOST_AUTO_TEST_SUITE(instruction_operands)
 
 	using namespace chasm;
 
@@ -15,7 +13,7 @@ BOOST_FIXTURE_TEST_SUITE(instruction_operands, test_env::default_options)
 		void try_codegen(std::string&& program)
 		{
 			auto lex = lexer(std::move(program));
-			auto par = parser(lex.enumerate_tokens());
+			auto par = parser(lex);
 			auto ast = par.make_tree();
 
 			ast.generate();
@@ -0,0 +1,98 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/lexer.hpp>
+
+#include <string>
+
+
+BOOST_AUTO_TEST_SUITE(lexer_incremental)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		const std::string source = "proc f          ;; comment\n"
+								   "    mov r1, 0x10\n"
+								   "    add r1, r2\n"
+								   "    ret\n"
+								   "endp f\n"
+								   ".main:\n"
+								   "    call $f\n";
+
+		//
+		// Applies the edit to both the text and the tokens, then checks the updated tokens
+		// against a full lexing of the edited text
+		//
+		relexed_range check_edit(const text_edit& edit)
+		{
+			auto old_lexer  = lexer(std::span(source));
+			auto tokens = old_lexer.enumerate_tokens();
+
+			const auto edited = std::string(source).replace(edit.offset, edit.erased, edit.inserted);
+			const auto range  = relex(tokens, std::span(edited), edit);
+
+			auto new_lexer = lexer(std::span(edited));
+			const auto expected = new_lexer.enumerate_tokens();
+
+			BOOST_REQUIRE_EQUAL(tokens.size(), expected.size());
+
+			for (size_t i = 0; i < expected.size(); ++i)
+			{
+				BOOST_CHECK(tokens[i].type == expected[i].type);
+				BOOST_CHECK_EQUAL(tokens[i].value, expected[i].value);
+				BOOST_CHECK_EQUAL(tokens[i].offset, expected[i].offset);
+				BOOST_CHECK(tokens[i].lexeme.data() == expected[i].lexeme.data());
+				BOOST_CHECK_EQUAL(tokens[i].lexeme.size(), expected[i].lexeme.size());
+			}
+
+			return range;
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(check_edit_within_a_line)
+	{
+		BOOST_TEST_MESSAGE("Checking an edit only re-lexes the edited line");
+
+		const auto range = details::check_edit({ details::source.find("0x10") + 2, 2, "FF'FF" });
+
+		BOOST_CHECK_EQUAL(range.first, 2);
+		BOOST_CHECK_EQUAL(range.count, 4);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_edits_changing_tokens_count)
+	{
+		BOOST_TEST_MESSAGE("Checking insertions and deletions spanning over lines");
+
+		details::check_edit({ 0, 0, ".start:\n" });
+		details::check_edit({ details::source.find("add"), 0, "inc r3\n    " });
+		details::check_edit({ details::source.find("add"), details::source.find("endp") - details::source.find("add"), "" });
+		details::check_edit({ details::source.find(";;"), 0, "r1" });
+		details::check_edit({ details::source.size(), 0, "    jmp @main" });
+		details::check_edit({ 0, details::source.size(), "" });
+	}
+
+	BOOST_AUTO_TEST_CASE(check_edit_commenting_out)
+	{
+		BOOST_TEST_MESSAGE("Checking edits turning code into comments");
+
+		const auto range = details::check_edit({ details::source.find("mov"), 0, ";;" });
+
+		BOOST_CHECK_EQUAL(range.first, 2);
+		BOOST_CHECK_EQUAL(range.count, 0);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_failed_relex_keeps_tokens)
+	{
+		BOOST_TEST_MESSAGE("Checking tokens are left untouched when the edit cannot be lexed");
+
+		auto old_lexer  = lexer(std::span(details::source));
+		auto tokens = old_lexer.enumerate_tokens();
+		const auto tokens_count = tokens.size();
+
+		const text_edit edit { details::source.find("ret"), 0, "?" };
+		const auto edited = std::string(details::source).replace(edit.offset, edit.erased, edit.inserted);
+
+		BOOST_CHECK_THROW(relex(tokens, std::span(edited), edit), lexer_exception::undefined_character_token);
+		BOOST_CHECK_EQUAL(tokens.size(), tokens_count);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
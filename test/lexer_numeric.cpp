@@ -13,7 +13,7 @@ BOOST_AUTO_TEST_SUITE(lexer_numeric_constants)
 			auto lex = chasm::lexer(std::move(program));
 			auto token = lex.enumerate_tokens()[0];
 
-			return std::get<uint16_t>(token.data);
+			return token.value;
 		}
 	}
 
@@ -0,0 +1,95 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/lexer.hpp>
+
+#include <algorithm>
+#include <string>
+
+
+BOOST_AUTO_TEST_SUITE(lexer_parallel)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		//
+		// Large enough to be split in several chunks, mixes comments, blank lines and every token kind
+		//
+		std::string make_large_source(size_t procedures_count)
+		{
+			std::string source;
+
+			for (size_t i = 0; i < procedures_count; ++i)
+			{
+				const auto name = "procedure_" + std::to_string(i);
+
+				source += "proc " + name + "   ;; comment with ;; inside\n"
+						  "    define C 0xFF'FF\n"
+						  "\n"
+						  ".loop:\n"
+						  "    mov r1, 0b1010'1010\n"
+						  "    draw r0, r1, #sprite\n"
+						  "    jmp @loop ;; trailing\n"
+						  "    config RAW_ALIGNED = default\n"
+						  "    raw(0o777)\n"
+						  "endp " + name + "\n";
+			}
+
+			return source;
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(check_same_tokens_as_sequential)
+	{
+		BOOST_TEST_MESSAGE("Checking parallel lexing produces the sequential token stream");
+
+		const auto source = details::make_large_source(5000);
+
+		auto sequential_lexer = lexer(std::span(source));
+		auto parallel_lexer   = lexer(std::span(source));
+
+		const auto sequential = sequential_lexer.enumerate_tokens();
+		const auto parallel   = parallel_lexer.enumerate_tokens(8);
+
+		BOOST_REQUIRE_EQUAL(sequential.size(), parallel.size());
+
+		for (size_t i = 0; i < sequential.size(); ++i)
+		{
+			BOOST_REQUIRE(sequential[i].type == parallel[i].type);
+			BOOST_REQUIRE_EQUAL(sequential[i].value, parallel[i].value);
+			BOOST_REQUIRE_EQUAL(sequential[i].offset, parallel[i].offset);
+			BOOST_REQUIRE(sequential[i].lexeme.data() == parallel[i].lexeme.data());
+			BOOST_REQUIRE_EQUAL(sequential[i].lexeme.size(), parallel[i].lexeme.size());
+		}
+
+		BOOST_CHECK(parallel_lexer.next_token().type == token_type::eof);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_first_error_reported)
+	{
+		BOOST_TEST_MESSAGE("Checking the earliest error is reported with its location in the whole source");
+
+		auto source = details::make_large_source(5000);
+
+		const auto first_error  = source.size() / 3;
+		const auto second_error = source.size() / 3 * 2;
+
+		source[source.find("mov", first_error)]  = '?';
+		source[source.find("mov", second_error)] = '?';
+
+		const auto line = static_cast<size_t>(std::count(source.begin(), source.begin() + source.find('?'), '\n')) + 1;
+
+		auto parallel_lexer = lexer(std::span(source));
+
+		try
+		{
+			const auto tokens = parallel_lexer.enumerate_tokens(8);
+			BOOST_FAIL("Invalid characters were not reported");
+		}
+		catch (const lexer_exception::undefined_character_token& error)
+		{
+			const std::string message = error.what();
+			BOOST_CHECK_NE(message.find(std::format("line {}, column 5", line)), std::string::npos);
+		}
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/scan.hpp>
+#include <chasm/lexer.hpp>
+
+#include <algorithm>
+#include <string>
+
+
+BOOST_AUTO_TEST_SUITE(lexer_scan)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		//
+		// Builds `prefix` repeated to reach each length around the block sizes, followed by `stop`
+		//
+		template<typename Check>
+		void for_each_length(char fill, char stop, Check check)
+		{
+			for (size_t length = 0; length <= 70; ++length)
+			{
+				std::string text(length, fill);
+				text += stop;
+				text += std::string(40, fill);
+
+				check(text, length);
+			}
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(check_kernel_runs)
+	{
+		BOOST_TEST_MESSAGE("Checking scanning kernels (" << scan::kernel_name() << ") across block boundaries");
+
+		details::for_each_length(' ', 'x', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::whitespace_run(text), length);
+		});
+
+		details::for_each_length('\t', '!', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::whitespace_run(text), length);
+		});
+
+		details::for_each_length('_', ' ', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::identifier_run(text), length);
+		});
+
+		details::for_each_length('z', '[', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::identifier_run(text), length);
+		});
+
+		details::for_each_length(';', '\n', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::line_end(text), length);
+		});
+
+		details::for_each_length('\n', 'a', [](const std::string& text, size_t length)
+		{
+			BOOST_CHECK_EQUAL(scan::count_newlines(text), static_cast<size_t>(std::ranges::count(text, '\n')));
+		});
+
+		BOOST_CHECK_EQUAL(scan::line_end("no newline"), 10);
+		BOOST_CHECK_EQUAL(scan::whitespace_run(""), 0);
+		BOOST_CHECK_EQUAL(scan::identifier_run("\x80\xFF"), 0);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_locations_after_long_runs)
+	{
+		BOOST_TEST_MESSAGE("Checking line/column accounting over comments and whitespace runs");
+
+		const std::string padding(45, ' ');
+
+		auto lex = lexer(
+				";; " + std::string(100, '-') + "\n" +
+				padding + "\n"
+				"\n" +
+				padding + "cls ;; trailing comment\n" +
+				"    " + std::string(50, 'a') + " ret"
+		);
+
+		const auto tokens = lex.enumerate_tokens();
+
+		BOOST_REQUIRE_EQUAL(tokens.size(), 3);
+
+		BOOST_CHECK_EQUAL(lex.locate(tokens[0]).line, 4);
+		BOOST_CHECK_EQUAL(lex.locate(tokens[0]).col, padding.size() + 1);
+		BOOST_CHECK_EQUAL(lex.locate(tokens[1]).line, 5);
+		BOOST_CHECK_EQUAL(lex.locate(tokens[1]).col, 5);
+		BOOST_CHECK_EQUAL(tokens[1].lexeme.size(), 50);
+		BOOST_CHECK_EQUAL(lex.locate(tokens[2]).col, 56);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_offsets_resolved_to_lines)
+	{
+		BOOST_TEST_MESSAGE("Checking byte offsets are resolved through the line-start index");
+
+		const auto source = stream(std::string("ab\n\ncd\n"));
+
+		BOOST_CHECK_EQUAL(source.locate(0).line, 1);
+		BOOST_CHECK_EQUAL(source.locate(0).col, 1);
+		BOOST_CHECK_EQUAL(source.locate(2).line, 1);
+		BOOST_CHECK_EQUAL(source.locate(2).col, 3);
+		BOOST_CHECK_EQUAL(source.locate(3).line, 2);
+		BOOST_CHECK_EQUAL(source.locate(3).col, 1);
+		BOOST_CHECK_EQUAL(source.locate(5).line, 3);
+		BOOST_CHECK_EQUAL(source.locate(5).col, 2);
+		BOOST_CHECK_EQUAL(source.locate(7).line, 4);
+		BOOST_CHECK_EQUAL(source.locate(7).col, 1);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -115,4 +115,55 @@ BOOST_AUTO_TEST_SUITE(lexer_tokens)
 			BOOST_CHECK(tokens[i].type == expected[i]);
 	}
 
+	BOOST_AUTO_TEST_CASE(check_token_lexemes)
+	{
+		BOOST_TEST_MESSAGE("Checking tokens lexemes are views of the source text");
+
+		auto lex = lexer("proc my_function\n"
+						 "    mov r1, 0xFF'FF\n"
+						 "endp my_function\n");
+
+		const auto tokens = lex.enumerate_tokens();
+		const std::vector<std::string_view> expected = {
+				"proc", "my_function",
+				"mov", "r1", ",", "0xFF'FF",
+				"endp", "my_function"
+		};
+
+		BOOST_REQUIRE_EQUAL(std::size(tokens), std::size(expected));
+
+		for (size_t i = 0; i < std::size(expected); ++i)
+			BOOST_CHECK(tokens[i].lexeme == expected[i]);
+
+		BOOST_CHECK_EQUAL(tokens[5].value, 0xFFFF);
+		BOOST_CHECK(tokens[1].lexeme.data() != tokens[7].lexeme.data());
+	}
+
+	BOOST_AUTO_TEST_CASE(check_reserved_word_values)
+	{
+		BOOST_TEST_MESSAGE("Checking mnemonics and registers are resolved by the lexer");
+
+		auto lex = lexer("xor rf, r0\n"
+						 "mov dt, ar\n"
+						 "xord rg, st\n");
+
+		const auto tokens = lex.enumerate_tokens();
+
+		BOOST_REQUIRE_EQUAL(std::size(tokens), 12);
+
+		BOOST_CHECK(tokens[0].type == token_type::instruction);
+		BOOST_CHECK_EQUAL(tokens[0].value, arch::instruction_id::XOR);
+		BOOST_CHECK_EQUAL(tokens[1].value, 0xF);
+		BOOST_CHECK_EQUAL(tokens[3].value, 0x0);
+
+		BOOST_CHECK_EQUAL(tokens[4].value, arch::instruction_id::MOV);
+		BOOST_CHECK_EQUAL(tokens[5].value, arch::register_id::REG_DT);
+		BOOST_CHECK_EQUAL(tokens[7].value, arch::register_id::REG_AR);
+
+		BOOST_CHECK(tokens[8].type == token_type::identifier);
+		BOOST_CHECK(tokens[9].type == token_type::identifier);
+		BOOST_CHECK(tokens[11].type == token_type::register_name);
+		BOOST_CHECK_EQUAL(tokens[11].value, arch::register_id::REG_ST);
+	}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/mapped_file.hpp>
+#include <chasm/lexer.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+
+BOOST_AUTO_TEST_SUITE(mapped_input)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		std::filesystem::path write_temporary(const std::string& name, std::string_view content)
+		{
+			const auto path = std::filesystem::temp_directory_path() / name;
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return path;
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(check_mapped_source_is_lexed_in_place)
+	{
+		const auto path = details::write_temporary("chasm_mapped_source.c8", ".main:\n    mov r1, 0x10\n");
+
+		{
+			const auto source = mapped_file(path);
+
+			BOOST_CHECK(source.is_mapped());
+			BOOST_REQUIRE_EQUAL(source.text().size(), std::filesystem::file_size(path));
+
+			auto lex = lexer(source.text());
+			const auto tokens = lex.enumerate_tokens();
+
+			BOOST_REQUIRE_EQUAL(std::size(tokens), 7);
+			BOOST_CHECK(tokens[3].lexeme.data() == source.text().data() + 11);
+			BOOST_CHECK_EQUAL(tokens[6].value, 0x10);
+		}
+
+		std::filesystem::remove(path);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_empty_file_is_read)
+	{
+		const auto path = details::write_temporary("chasm_empty_rom.ch8", "");
+
+		{
+			const auto rom = mapped_file(path);
+
+			BOOST_CHECK(!rom.is_mapped());
+			BOOST_CHECK(rom.empty());
+		}
+
+		std::filesystem::remove(path);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_missing_file_throws)
+	{
+		BOOST_CHECK_THROW(mapped_file("chasm_file_that_does_not_exist.ch8"), std::runtime_error);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
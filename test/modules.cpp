@@ -0,0 +1,215 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/precompiled_module.hpp>
+#include <chasm/symbol_sanitizer.hpp>
+#include <chasm/include_cache.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+#include <filesystem>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "options_fixture.hpp"
+
+
+#define BOOST_CHECK_EQUAL_RANGES(Rng1, Rng2) BOOST_CHECK_EQUAL_COLLECTIONS(Rng1.begin(), Rng1.end(), Rng2.begin(), Rng2.end())
+
+
+BOOST_AUTO_TEST_SUITE(precompiled_modules)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "chasm_modules";
+
+		std::filesystem::path write_file(const std::string& name, std::string_view content)
+		{
+			const auto path = directory / name;
+
+			std::filesystem::create_directories(path.parent_path());
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return std::filesystem::weakly_canonical(path);
+		}
+
+		std::vector<uint8_t> compile_module(std::string&& library)
+		{
+			auto lex = lexer(std::move(library));
+			auto par = parser(lex);
+			const auto ast = par.make_tree();
+
+			return ast.compile_module();
+		}
+
+		std::filesystem::path write_module(const std::string& name, std::string&& library)
+		{
+			const auto bytes = compile_module(std::move(library));
+
+			return write_file(name, std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+		}
+
+		std::vector<uint8_t> try_codegen(std::string&& program, include_cache& cache)
+		{
+			auto lex = lexer(std::move(program));
+			auto par = parser(lex);
+			par.resolve_includes({ directory / "main.c8" }, &cache);
+
+			const auto ast = par.make_tree();
+
+			return ast.generate(test_env::zero_relocate);
+		}
+
+		const std::string library =
+				"sprite ship [0xFF, 0x81, 0xFF] \n"
+				"define SPEED 3                 \n"
+				"define ROWS  sizeof(#ship)     \n"
+				"proc step                      \n"
+				"    add r0, SPEED              \n"
+				"    se r0, 9                   \n"
+				"    jmp @done                  \n"
+				"    call $draw_ship            \n"
+				".done:                         \n"
+				"    ret                        \n"
+				"endp step                      \n"
+				"proc draw_ship                 \n"
+				"    mov ar, #ship              \n"
+				"    draw r0, r1, ROWS          \n"
+				"    ret                        \n"
+				"endp draw_ship                 \n";
+	}
+
+	BOOST_AUTO_TEST_CASE(symbols_exported)
+	{
+		using symbol_kind = precompiled_module::symbol_kind;
+
+		const auto path = details::write_module("exports.c8m", std::string(details::library));
+		const auto module = precompiled_module(path);
+
+		BOOST_REQUIRE_EQUAL(module.symbols_count(), 5);
+		BOOST_CHECK_EQUAL(module.sections_count(), 2);
+		BOOST_CHECK_EQUAL(module.sprites_count(), 1);
+		BOOST_CHECK_EQUAL(module.relocations_count(), 3);
+
+		BOOST_CHECK(module.symbol_at(0).kind == symbol_kind::procedure);
+		BOOST_CHECK_EQUAL(module.symbol_at(0).name, "step");
+		BOOST_CHECK_EQUAL(module.symbol_at(1).name, "draw_ship");
+		BOOST_CHECK_EQUAL(module.symbol_at(1).value, 1);
+
+		BOOST_CHECK(module.symbol_at(2).kind == symbol_kind::sprite);
+		BOOST_CHECK_EQUAL(module.sprite(module.symbol_at(2).value).row_count, 3);
+
+		BOOST_CHECK(module.symbol_at(4).kind == symbol_kind::constant);
+		BOOST_CHECK_EQUAL(module.symbol_at(4).name, "ROWS");
+		BOOST_CHECK_EQUAL(module.symbol_at(4).value, 3);
+	}
+
+	BOOST_AUTO_TEST_CASE(same_code_as_included_source)
+	{
+		include_cache cache;
+
+		details::write_module("lib.c8m", std::string(details::library));
+		details::write_file("lib.c8", details::library);
+
+		const std::string program =
+				"proc tail                      \n"
+				"    call $draw_ship            \n"
+				"    ret                        \n"
+				"endp tail                      \n"
+				".main:                         \n"
+				"    mov r0, SPEED + ROWS       \n"
+				"    call $step                 \n"
+				"    mov ar, #ship + 1          \n";
+
+		const auto from_module = details::try_codegen("include \"lib.c8m\"\n" + program, cache);
+		const auto from_source = details::try_codegen("include \"lib.c8\"\n" + program, cache);
+
+		const std::vector<uint8_t> expected_code = {
+			0x60, 0x06,
+			0x20, 0x06,
+			0xA0, 0x1B,
+			0x70, 0x03,
+			0x30, 0x09,
+			0x10, 0x0E,
+			0x20, 0x10,
+			0x00, 0xEE,
+			0xA0, 0x1A,
+			0xD0, 0x13,
+			0x00, 0xEE,
+			0x20, 0x10,
+			0x00, 0xEE,
+			0xFF, 0x81, 0xFF
+		};
+
+		BOOST_CHECK_EQUAL_RANGES(from_module, expected_code);
+		BOOST_CHECK_EQUAL_RANGES(from_source, from_module);
+	}
+
+	BOOST_AUTO_TEST_CASE(loaded_once_per_content)
+	{
+		include_cache cache;
+
+		const auto path = details::write_module("shared.c8m", "define A 1\n");
+
+		const auto first = cache.load_module(path).module;
+		BOOST_CHECK(cache.load_module(path).module == first);
+
+		details::write_module("shared.c8m", "define A 2\n");
+
+		const auto second = cache.load_module(path).module;
+
+		BOOST_CHECK(second != first);
+		BOOST_CHECK_EQUAL(second->symbol_at(0).value, 2);
+		BOOST_CHECK_EQUAL(cache.size(), 1);
+	}
+
+	BOOST_AUTO_TEST_CASE(cached_while_stamp_unchanged)
+	{
+		include_cache cache;
+
+		const auto path = details::write_module("stamped.c8m", "define A 1\n");
+		const auto long_ago = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+
+		std::filesystem::last_write_time(path, long_ago);
+
+		const auto first = cache.load_module(path);
+
+		// same size and modification time, the file is not read again
+		details::write_module("stamped.c8m", "define A 2\n");
+		std::filesystem::last_write_time(path, long_ago);
+
+		BOOST_CHECK(cache.load_module(path).module == first.module);
+		BOOST_CHECK_EQUAL(cache.load_module(path).content_hash, first.content_hash);
+
+		std::filesystem::last_write_time(path, long_ago + std::chrono::minutes(1));
+
+		const auto second = cache.load_module(path);
+
+		BOOST_CHECK(second.module != first.module);
+		BOOST_CHECK(second.content_hash != first.content_hash);
+		BOOST_CHECK_EQUAL(second.module->symbol_at(0).value, 2);
+	}
+
+	BOOST_AUTO_TEST_CASE(invalid_modules)
+	{
+		using module_exception::invalid_module_content;
+
+		include_cache cache;
+
+		BOOST_CHECK_THROW(details::compile_module(".main: cls"), invalid_module_content);
+		BOOST_CHECK_THROW(details::compile_module("proc f\n mov ar, @outside\n ret\nendp f"), sanitize_exception::undefined_symbols);
+
+		details::write_module("conflict.c8m", "define A 1\n");
+		details::write_file("garbage.c8m", "C8M garbage");
+		details::write_file("empty.c8m", "");
+
+		BOOST_CHECK_THROW(details::try_codegen("define A 2\ninclude \"conflict.c8m\"\n.main: cls", cache), sanitize_exception::already_defined_symbol);
+		BOOST_CHECK_THROW(details::try_codegen("include \"garbage.c8m\"\n.main: cls", cache), module_exception::invalid_module);
+		BOOST_CHECK_THROW(details::try_codegen("include \"empty.c8m\"\n.main: cls", cache), module_exception::invalid_module);
+		BOOST_CHECK_THROW(details::try_codegen("include \"missing.c8m\"\n.main: cls", cache), include_exception::file_not_found);
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -32,10 +32,135 @@ BOOST_AUTO_TEST_SUITE(parser_nodes)
 				"   cls                                                \n"
 		);
 
-		auto parser = chasm::parser(lex.enumerate_tokens());
+		auto parser = chasm::parser(lex);
 		auto tree = parser.make_tree();
 
 		BOOST_CHECK_EQUAL(tree.branches().size(), 6);
 	}
 
+	BOOST_AUTO_TEST_CASE(tokens_pulled_on_demand)
+	{
+		//
+		// The parser error on the first line must be raised before the lexer
+		// reaches the invalid character on the last line
+		//
+		auto lex = chasm::lexer(
+				"define 0 val     \n"
+				".main:           \n"
+				"    cls          \n"
+				"    ?            \n"
+		);
+
+		auto parser = chasm::parser(lex);
+
+		BOOST_CHECK_THROW(parser.make_tree(), chasm::parser_exception::expected_others_error);
+	}
+
+	BOOST_AUTO_TEST_CASE(statements_allowed_per_context)
+	{
+		// returns the count of top level statements, the tree cannot outlive its lexer
+		auto parse = [](const char* source)
+		{
+			auto lex = chasm::lexer(source);
+			auto parser = chasm::parser(lex);
+
+			return parser.make_tree().branches().size();
+		};
+
+		// a label ends at the next label or at the end of its procedure
+		BOOST_CHECK_EQUAL(parse("proc a        \n"
+								".loop:        \n"
+								"    cls       \n"
+								".done:        \n"
+								"    ret       \n"
+								"endp a        \n"
+								".main:        \n"
+								"    cls       \n"), 2);
+
+		BOOST_CHECK_THROW(parse("proc a\n proc b\n endp b\n endp a"), chasm::chasm_exception);
+		BOOST_CHECK_THROW(parse("proc a\n sprite s [1]\n endp a"), chasm::parser_exception::unexpected_error);
+		BOOST_CHECK_THROW(parse(".main:\n sprite s [1]"), chasm::parser_exception::unexpected_error);
+		BOOST_CHECK_THROW(parse("proc a\n cls\n"), chasm::chasm_exception);
+	}
+
+	BOOST_AUTO_TEST_CASE(bodies_stored_after_their_owner)
+	{
+		using chasm::ast::node_kind;
+
+		auto lex = chasm::lexer(
+				"proc a             \n"  // 0
+				".loop:             \n"  // 1
+				"    add r0, 1      \n"  // 2
+				"    jmp @loop      \n"  // 3
+				"endp a             \n"
+				"sprite s [1, 2]    \n"  // 4
+				".main:             \n"  // 5
+				"    define c 2     \n"  // 6
+				"    call $a        \n"  // 7
+		);
+
+		auto parser = chasm::parser(lex);
+		const auto tree = parser.make_tree();
+		const auto& nodes = tree.nodes();
+
+		const std::vector<node_kind> expected_kinds = {
+			node_kind::procedure,
+			node_kind::label,
+			node_kind::instruction,
+			node_kind::instruction,
+			node_kind::sprite,
+			node_kind::label,
+			node_kind::define,
+			node_kind::instruction
+		};
+
+		BOOST_CHECK(nodes.kinds == expected_kinds);
+
+		// subtrees are contiguous, nested bodies included
+		BOOST_CHECK_EQUAL(nodes.end_of(0), 4);
+		BOOST_CHECK_EQUAL(nodes.end_of(1), 4);
+		BOOST_CHECK_EQUAL(nodes.end_of(4), 5);
+		BOOST_CHECK_EQUAL(nodes.end_of(5), 8);
+
+		BOOST_CHECK_EQUAL(nodes.instruction(2).operands.size(), 2);
+		BOOST_CHECK_EQUAL(nodes.token_of(nodes.instruction(7).operands[0]).lexeme, "a");
+		BOOST_CHECK_EQUAL(nodes.token_at(6, 1).to_integer(), 2);
+		BOOST_CHECK_EQUAL(nodes.sprite(4).row_count, 2);
+
+		BOOST_CHECK_EQUAL(tree.branches().size(), 3);
+	}
+
+	BOOST_AUTO_TEST_CASE(operands_resolved_once)
+	{
+		using chasm::arch::operand_type;
+
+		auto lex = chasm::lexer(
+				"define c 2               \n"
+				".main:                   \n"
+				"    mov ar, [c]          \n"  // 2
+				"    draw rb, r2, 0xA     \n"  // 3
+				"    mov dt, r1           \n"  // 4
+		);
+
+		auto parser = chasm::parser(lex);
+		const auto tree = parser.make_tree();
+		const auto& nodes = tree.nodes();
+
+		const auto mov_ar = nodes.instruction(2);
+
+		BOOST_CHECK(mov_ar.operands[0].type == operand_type::reg_ar);
+		BOOST_CHECK(mov_ar.operands[1].type == operand_type::address_indirect);
+		BOOST_CHECK(mov_ar.operands[1].has_indirection());
+		BOOST_CHECK_EQUAL(tree.symbols().name(mov_ar.operands[1].symbol), "c");
+
+		const auto draw = nodes.instruction(3);
+
+		BOOST_CHECK_EQUAL(draw.operands_mask, chasm::arch::operands_mask::MASK_R8_R8_IMM);
+		BOOST_CHECK_EQUAL(draw.operands[0].value, 0xB);
+		BOOST_CHECK_EQUAL(draw.operands[2].value, 0xA);
+		BOOST_CHECK_EQUAL(draw.operands[2].symbol, chasm::NO_SYMBOL);
+
+		BOOST_CHECK_EQUAL(nodes.instruction(4).operands_mask, chasm::arch::operands_mask::MASK_DT_R8);
+	}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/spsc_ring.hpp>
+#include <chasm/pipeline.hpp>
+#include <chasm/parser.hpp>
+#include <chasm/lexer.hpp>
+
+#include <thread>
+#include <string>
+
+
+BOOST_AUTO_TEST_SUITE(pipeline)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		//
+		// Enough statements to be handed over in several fragments, with references across them
+		//
+		std::string make_large_program(size_t procedures_count)
+		{
+			std::string source = "sprite digit [0x20, 0x60, 0x20]\n"
+								 "define SPEED 3\n";
+
+			for (size_t i = 0; i < procedures_count; ++i)
+			{
+				source += "proc procedure_" + std::to_string(i) + "\n"
+						  "    define C 0xF0\n"
+						  ".loop:\n"
+						  "    add r1, SPEED\n"
+						  "    mov ar, #digit\n"
+						  "    draw r0, r1, digit\n"
+						  "    se r1, C\n"
+						  "    jmp @loop\n"
+						  "    call $procedure_" + std::to_string(i + 1) + "\n"
+						  ".done:\n"
+						  "    ret\n"
+						  "endp procedure_" + std::to_string(i) + "\n";
+			}
+
+			source += "proc procedure_" + std::to_string(procedures_count) + "\n"
+					  "    ret\n"
+					  "endp procedure_" + std::to_string(procedures_count) + "\n"
+					  ".main:\n"
+					  "    call $procedure_0\n"
+					  "    jmp @main\n";
+
+			return source;
+		}
+
+		std::vector<uint8_t> assemble_sequential(const std::string& source)
+		{
+			auto lex = lexer(std::span(source));
+			auto par = parser(lex);
+
+			return par.make_tree().generate();
+		}
+	}
+
+	BOOST_AUTO_TEST_CASE(ring_hands_over_in_order)
+	{
+		spsc_ring<size_t, 4> ring;
+		constexpr size_t count = 10'000;
+
+		std::jthread producer([&]
+		{
+			for (size_t i = 0; i < count; ++i)
+				ring.push(size_t(i));
+
+			ring.close();
+		});
+
+		size_t value = 0;
+		size_t expected = 0;
+
+		while (ring.pop(value))
+		{
+			BOOST_REQUIRE_EQUAL(value, expected);
+			++expected;
+		}
+
+		BOOST_CHECK_EQUAL(expected, count);
+		BOOST_CHECK(!ring.push(0));
+	}
+
+	BOOST_AUTO_TEST_CASE(same_binary_as_sequential)
+	{
+		const auto source = details::make_large_program(2000);
+
+		const auto pipelined = assemble_pipelined(std::span(source));
+
+		BOOST_REQUIRE(pipelined.has_value());
+		BOOST_CHECK(*pipelined == details::assemble_sequential(source));
+	}
+
+	BOOST_AUTO_TEST_CASE(errors_raised_from_every_stage)
+	{
+		auto assemble = [](const std::string& source)
+		{
+			return assemble_pipelined(std::span(source));
+		};
+
+		const auto program = details::make_large_program(500);
+
+		BOOST_CHECK_THROW(assemble(program + "?"), lexer_exception::undefined_character_token);
+		BOOST_CHECK_THROW(assemble(program + "proc"), parser_exception::unexpected_error);
+		BOOST_CHECK_THROW(assemble(program + "jmp @nowhere"), chasm_exception);
+		BOOST_CHECK_THROW(assemble("proc a\n ret\nendp a"), chasm_exception);
+
+		BOOST_CHECK(!assemble(";; only a comment\n").has_value());
+	}
+
+BOOST_AUTO_TEST_SUITE_END()
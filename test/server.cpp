@@ -0,0 +1,289 @@
+#include <boost/test/unit_test.hpp>
+#include <chasm/server.hpp>
+#include <chasm/json.hpp>
+
+#include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#if !defined(_WIN32)
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+
+BOOST_AUTO_TEST_SUITE(assembler_server)
+
+	using namespace chasm;
+
+	namespace details
+	{
+		json::value ask(server& server, std::string_view request)
+		{
+			return json::parse(server.handle(request));
+		}
+
+#if !defined(_WIN32)
+		// -1 if the server did not listen in time
+		int connect_to(const std::filesystem::path& socket_path)
+		{
+			sockaddr_un address {};
+			address.sun_family = AF_UNIX;
+			std::ranges::copy(socket_path.string(), address.sun_path);
+
+			for (int attempt = 0; attempt < 200; ++attempt)
+			{
+				const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+				if (client >= 0 && ::connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+					return client;
+
+				::close(client);
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+
+			return -1;
+		}
+
+		// next response line, empty once the server closed the connection
+		std::string read_line(int client)
+		{
+			std::string line;
+			char byte;
+
+			while (::read(client, &byte, 1) == 1 && byte != '\n')
+				line += byte;
+
+			return line;
+		}
+
+		// false if the server closed the connection
+		bool send_line(int client, std::string_view line)
+		{
+			const auto data = std::string(line) + '\n';
+
+			return ::send(client, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+		}
+#endif
+	}
+
+	BOOST_AUTO_TEST_CASE(json_documents)
+	{
+		const auto document = json::parse(R"( {"a": [1, -2.5e1, true, null], "b": {"c": "x\"\n\u00e9\ud83d\ude00"}} )");
+
+		const auto& a = document.find("a")->as_array();
+
+		BOOST_REQUIRE_EQUAL(a.size(), 4);
+		BOOST_CHECK_EQUAL(a[0].as_number(), 1);
+		BOOST_CHECK_EQUAL(a[1].as_number(), -25);
+		BOOST_CHECK(a[2].as_bool());
+		BOOST_CHECK(a[3].is_null());
+		BOOST_CHECK_EQUAL(document.find("b")->find("c")->as_string(), "x\"\n\xC3\xA9\xF0\x9F\x98\x80");
+		BOOST_CHECK(document.find("missing") == nullptr);
+
+		BOOST_CHECK_THROW(static_cast<void>(json::parse("{\"a\": 1,}")), json::json_exception::invalid_json);
+		BOOST_CHECK_THROW(static_cast<void>(json::parse("[1] 2")), json::json_exception::invalid_json);
+		BOOST_CHECK_THROW(static_cast<void>(json::parse("01")), json::json_exception::invalid_json);
+		BOOST_CHECK_THROW(static_cast<void>(json::parse("\"\\ud800\"")), json::json_exception::invalid_json);
+		BOOST_CHECK_THROW(static_cast<void>(json::parse(std::string(100, '['))), json::json_exception::invalid_json);
+		BOOST_CHECK_THROW(static_cast<void>(a[0].as_string()), json::json_exception::type_mismatch);
+	}
+
+	BOOST_AUTO_TEST_CASE(requests_answered)
+	{
+		server server;
+
+		const auto assembled = details::ask(server, R"({"id": 1, "method": "assemble", "source": ".main: mov r0, 5\n jmp @main", "options": {"relocate": 0}})");
+
+		BOOST_CHECK_EQUAL(assembled.find("id")->as_number(), 1);
+		BOOST_CHECK(assembled.find("ok")->as_bool());
+		BOOST_CHECK(assembled.find("assembled")->as_bool());
+		BOOST_CHECK_EQUAL(assembled.find("binary")->as_string(), "60051000");
+
+		const auto failed = details::ask(server, R"({"id": "two", "method": "assemble", "source": ".main: jmp @nowhere"})");
+
+		BOOST_CHECK_EQUAL(failed.find("id")->as_string(), "two");
+		BOOST_CHECK(failed.find("ok")->as_bool());
+		BOOST_CHECK(!failed.find("assembled")->as_bool());
+		BOOST_CHECK(failed.find("binary")->is_null());
+		BOOST_CHECK_EQUAL(failed.find("report")->find("errors")->as_number(), 1);
+
+		// the SuperCHIP-8 warning is reported in the response, not printed
+		const auto warned = details::ask(server, R"({"method": "assemble", "source": ".main: scrr"})");
+
+		BOOST_CHECK(warned.find("id")->is_null());
+		BOOST_CHECK_EQUAL(warned.find("report")->find("warnings")->as_number(), 1);
+
+		const auto listing = details::ask(server, R"({"id": 3, "method": "disassemble", "bytes": "600512001234", "load_address": 512})");
+		const auto& instructions = listing.find("instructions")->as_array();
+
+		BOOST_REQUIRE_EQUAL(instructions.size(), 2);
+		BOOST_CHECK_EQUAL(instructions[0].find("address")->as_number(), 0x200);
+		BOOST_CHECK_EQUAL(instructions[0].find("opcode")->as_number(), 0x6005);
+		BOOST_CHECK_EQUAL(instructions[1].find("opcode")->as_number(), 0x1200);
+
+		for (const auto* request : { "not json", R"({"method": "format the disk"})", R"({"method": "disassemble", "bytes": "6"})", R"({"method": "assemble"})" })
+		{
+			const auto refused = details::ask(server, request);
+
+			BOOST_CHECK(!refused.find("ok")->as_bool());
+			BOOST_CHECK(refused.find("error")->is_string());
+		}
+
+		const auto stats = details::ask(server, R"({"method": "stats"})");
+
+		BOOST_CHECK_EQUAL(stats.find("requests")->as_number(), 9);
+		BOOST_CHECK_EQUAL(stats.find("cached_files")->as_number(), 0);
+		BOOST_CHECK_EQUAL(stats.find("evicted_files")->as_number(), 0);
+		BOOST_CHECK(!server.stopped());
+	}
+
+	BOOST_AUTO_TEST_CASE(serve_until_shutdown)
+	{
+		server server;
+
+		std::istringstream input(
+				"{\"id\": 1, \"method\": \"stats\"}\n"
+				"\n"
+				"{\"id\": 2, \"method\": \"shutdown\"}\n"
+				"{\"id\": 3, \"method\": \"stats\"}\n");
+
+		std::ostringstream output;
+		server.serve(input, output);
+
+		std::istringstream responses(output.str());
+		std::string line;
+		size_t count = 0;
+
+		while (std::getline(responses, line))
+			BOOST_CHECK_EQUAL(json::parse(line).find("id")->as_number(), ++count);
+
+		BOOST_CHECK_EQUAL(count, 2);
+		BOOST_CHECK(server.stopped());
+	}
+
+#if !defined(_WIN32)
+
+	BOOST_AUTO_TEST_CASE(unix_socket_round_trip)
+	{
+		const auto socket_path = std::filesystem::temp_directory_path() / "chasm_server_test.sock";
+
+		server server;
+		std::thread serving([&] { server.serve_socket(socket_path); });
+
+		const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		BOOST_REQUIRE(client >= 0);
+
+		sockaddr_un address {};
+		address.sun_family = AF_UNIX;
+		std::ranges::copy(socket_path.string(), address.sun_path);
+
+		// the server may not be listening yet
+		bool connected = false;
+
+		for (int attempt = 0; attempt < 200 && !connected; ++attempt)
+		{
+			connected = ::connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+			if (!connected)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		BOOST_REQUIRE(connected);
+
+		const std::string requests =
+				"{\"id\": 1, \"method\": \"assemble\", \"source\": \".main: cls\"}\n"
+				"{\"id\": 2, \"method\": \"shutdown\"}\n";
+
+		BOOST_REQUIRE_EQUAL(::write(client, requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+
+		std::string received;
+		char buffer[256];
+
+		while (std::ranges::count(received, '\n') < 2)
+		{
+			const auto count = ::read(client, buffer, sizeof(buffer));
+
+			if (count <= 0)
+				break;
+
+			received.append(buffer, static_cast<size_t>(count));
+		}
+
+		::close(client);
+		serving.join();
+
+		std::istringstream responses(received);
+		std::string line;
+
+		BOOST_REQUIRE(std::getline(responses, line));
+		BOOST_CHECK_EQUAL(json::parse(line).find("binary")->as_string(), "00E0");
+
+		BOOST_REQUIRE(std::getline(responses, line));
+		BOOST_CHECK(json::parse(line).find("ok")->as_bool());
+
+		BOOST_CHECK(!std::filesystem::exists(socket_path));
+	}
+
+	BOOST_AUTO_TEST_CASE(unix_socket_limits)
+	{
+		const auto socket_path = std::filesystem::temp_directory_path() / "chasm_server_limits_test.sock";
+
+		server server({ .max_request_size = 64, .max_connections = 1 });
+		std::thread serving([&] { server.serve_socket(socket_path); });
+
+		const int served = details::connect_to(socket_path);
+		BOOST_REQUIRE(served >= 0);
+
+		BOOST_REQUIRE(details::send_line(served, R"({"id": 1, "method": "stats"})"));
+		BOOST_CHECK(json::parse(details::read_line(served)).find("ok")->as_bool());
+
+		// a second connection is answered then closed while the first one is served
+		const int refused = details::connect_to(socket_path);
+		BOOST_REQUIRE(refused >= 0);
+
+		const auto busy = json::parse(details::read_line(refused));
+		BOOST_CHECK(!busy.find("ok")->as_bool());
+		BOOST_CHECK(details::read_line(refused).empty());
+		::close(refused);
+
+		// a line that never ends is refused once it is over the limit, not buffered
+		const auto endless = std::string(200, ' ');
+		BOOST_REQUIRE_EQUAL(::write(served, endless.data(), endless.size()), static_cast<ssize_t>(endless.size()));
+
+		const auto too_large = json::parse(details::read_line(served));
+		BOOST_CHECK(!too_large.find("ok")->as_bool());
+		BOOST_CHECK(too_large.find("error")->as_string().find("64 bytes") != std::string::npos);
+		BOOST_CHECK(details::read_line(served).empty());
+		::close(served);
+
+		// the slot of the closed connection is free again once its thread is done
+		bool stopped = false;
+
+		for (int attempt = 0; attempt < 200 && !stopped; ++attempt)
+		{
+			const int client = details::connect_to(socket_path);
+			BOOST_REQUIRE(client >= 0);
+
+			// refused connections may be closed before the request is sent
+			if (details::send_line(client, R"({"id": 2, "method": "shutdown"})"))
+			{
+				const auto response = details::read_line(client);
+				stopped = !response.empty() && json::parse(response).find("ok")->as_bool();
+			}
+
+			::close(client);
+		}
+
+		serving.join();
+
+		BOOST_CHECK(stopped);
+	}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
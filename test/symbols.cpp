@@ -2,11 +2,13 @@
 #include <chasm/lexer.hpp>
 #include <chasm/parser.hpp>
 #include <chasm/symbol_sanitizer.hpp>
+#include <chasm/generator.hpp>
 
-#include "options_fixture.hpp"
+#include <filesystem>
+#include <fstream>
 
 
-BOOST_FIXTURE_TEST_SUITE(symbol_sanitizer, test_env::default_options)
+BOOST_AUTO_TEST_SUITE(symbol_sanitizer)
 
 	using namespace chasm;
 
@@ -15,10 +17,23 @@ BOOST_FIXTURE_TEST_SUITE(symbol_sanitizer, test_env::default_options)
 		void try_assemble(std::string&& program)
 		{
 			auto lex = lexer(std::move(program));
-			auto par = parser(lex.enumerate_tokens());
+			auto par = parser(lex);
 			auto ast = par.make_tree();
 			ast.generate();
 		}
+
+		// included files end the body of their last label, so statements may follow top level labels
+		std::string include_of(const std::string& name, std::string_view content)
+		{
+			const auto path = std::filesystem::temp_directory_path() / "chasm_symbols" / name;
+
+			std::filesystem::create_directories(path.parent_path());
+
+			std::ofstream os(path, std::ios::binary);
+			os.write(content.data(), static_cast<std::streamsize>(content.size()));
+
+			return "include \"" + path.generic_string() + "\"\n";
+		}
 	}
 
 	BOOST_AUTO_TEST_CASE(check_undefined_jump_label_throws)
@@ -125,6 +140,45 @@ BOOST_FIXTURE_TEST_SUITE(symbol_sanitizer, test_env::default_options)
 		);
 	}
 
+	BOOST_AUTO_TEST_CASE(check_procedure_reference_to_previous_top_level_label_throws)
+	{
+		BOOST_CHECK_THROW(
+			details::try_assemble(details::include_of("main.c8", ".main:\n call $tmp\n") +
+						          "proc tmp       \n"
+						          "    jmp @main  \n"
+						          "endp tmp       \n"),
+			sanitize_exception::undefined_symbols
+		);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_procedure_reference_to_next_top_level_label_throws)
+	{
+		BOOST_CHECK_THROW(
+			details::try_assemble("proc tmp       \n"
+						          "    jmp @main  \n"
+						          "endp tmp       \n"
+						          "               \n"
+						          ".main:         \n"
+						          "    call $tmp  \n"),
+			sanitize_exception::undefined_symbols
+		);
+	}
+
+	BOOST_AUTO_TEST_CASE(check_top_level_reference_to_procedure_label_throws)
+	{
+		BOOST_CHECK_THROW(
+			details::try_assemble("    jmp @foo   \n"
+						          "proc tmp       \n"
+						          ".foo:          \n"
+						          "    ret        \n"
+						          "endp tmp       \n"
+						          "               \n"
+						          ".main:         \n"
+						          "    cls        \n"),
+			sanitize_exception::undefined_symbols
+		);
+	}
+
 	BOOST_AUTO_TEST_CASE(check_scope_separation_proc_and_proc)
 	{
 		BOOST_CHECK_NO_THROW(
@@ -283,4 +337,22 @@ BOOST_FIXTURE_TEST_SUITE(symbol_sanitizer, test_env::default_options)
 		);
 	}
 
+	BOOST_AUTO_TEST_CASE(check_errors_raised_in_source_order)
+	{
+		// symbols are checked while generating, the first error in the source wins
+		BOOST_CHECK_THROW(
+			details::try_assemble(".main:                \n"
+			                      "    mov r0, dt, r1    \n"
+			                      "    add r0, undefined \n"),
+			generator_exception::invalid_operands_count
+		);
+
+		BOOST_CHECK_THROW(
+			details::try_assemble(".main:                \n"
+			                      "    add r0, undefined \n"
+			                      "    mov r0, dt, r1    \n"),
+			sanitize_exception::undefined_symbols
+		);
+	}
+
 BOOST_AUTO_TEST_SUITE_END()